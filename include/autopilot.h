@@ -0,0 +1,38 @@
+// autopilot.h
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include <stdint.h>
+
+/*
+* Messages sent by the blackboard to the autopilot (./DroneGame -A), which takes the pipe slot of the keyboard
+* manager and answers with the same keys.
+* - AUTOPILOT_MAP: a new map is played (first map, new round), or the changes of a frame could not be recorded:
+*   the whole map follows (occupancy_write).
+* - AUTOPILOT_FRAME: a frame was played: `count` changed cells follow, in the order in which they changed.
+* Both carry the drone position, at the start of the map or at the end of the frame, and the force set by the keys
+* (the autopilot takes it from AUTOPILOT_MAP, the keys it sends afterwards update it).
+*/
+#define AUTOPILOT_MAGIC 0x41504C54u // * "APLT"
+#define AUTOPILOT_MAP 1
+#define AUTOPILOT_FRAME 2
+
+// * New state of a changed cell
+#define AUTOPILOT_FREE 0
+#define AUTOPILOT_OBSTACLE 1
+#define AUTOPILOT_TARGET 2
+
+typedef struct {
+    uint32_t magic;
+    int32_t type;
+    int32_t x, y; // * Drone position
+    int32_t force_x, force_y; // * Force of the drone
+    int32_t count; // * Changes that follow (AUTOPILOT_FRAME)
+} autopilot_header;
+
+typedef struct {
+    int32_t cell; // * y * width + x
+    int32_t state;
+} autopilot_change;
+
+#endif // AUTOPILOT_H
@@ -0,0 +1,28 @@
+// blue_noise.h
+#ifndef BLUE_NOISE_H
+#define BLUE_NOISE_H
+
+#include "occupancy.h"
+#include "rng.h"
+
+/*
+* Blue-noise (Poisson-disk like) placement of points in a rectangle of a layer.
+* - The rectangle is split into strata of about 1/sqrt(density) cells per side, one point per stratum:
+*   the number of points follows the density and no region is left empty or crowded.
+* - The strata are also the background acceleration grid: a candidate only has to be checked against
+*   the points of the 8 neighbouring strata to keep the minimum spacing.
+* - Every stratum gets at most BLUE_NOISE_ATTEMPTS candidates, so the time is O(number of points)
+*   whatever the density, and a stratum whose candidates all fail is simply left empty.
+*/
+#define BLUE_NOISE_ATTEMPTS 8
+
+typedef struct {
+    int x0, y0; // * Top-left cell of the rectangle, in map coordinates
+    int height, width; // * Size of the rectangle
+    double density; // * Fraction of the cells to fill, in (0, 1]
+    int spacing; // * Minimum distance between two points, clamped to the side of a stratum
+} blue_noise_params;
+
+long blue_noise_place(const occupancy_map *map, uint64_t *layer, const blue_noise_params *params, rng_state *rng);
+
+#endif // BLUE_NOISE_H
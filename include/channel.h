@@ -0,0 +1,40 @@
+// channel.h
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "pipe_io.h"
+
+/*
+* One end of a one-way byte stream between two components, with the semantics of an end of a pipe whatever carries
+* it:
+* - an end of a pipe (channel_from_fd), between the processes of ./DroneGame;
+* - an end of an in-memory queue (channel_queue), between the threads of ./DroneGameThreads (threads.h): a ring of
+*   CHANNEL_CAPACITY bytes under a mutex, where a transfer is two copies and no system call, and a wait is a
+*   condition variable.
+* channel_read and channel_write move the whole buffer, blocking like read_full and write_full. When the other end is
+*   closed both fail with EPIPE (a queue never raises SIGPIPE); a reader gets the bytes written before the close.
+* channel_fd gives a descriptor for poll() and select(), readable when the end has something to report: data or the
+*   end of the stream for a reading end, the reader gone for a writing end. A queue creates it (an eventfd) on the
+*   first call, and from then on pays a system call when the queue turns empty or non-empty.
+* Every end counts its bytes and complete transfers (channel_stats, metrics.h).
+* channel_replace swaps the pipe behind an end for a new one (a generator restarted alone by the supervisor).
+*/
+#define CHANNEL_CAPACITY (1 << 20) // * Bytes buffered by a queue: a whole map fits, its writer does not wait for it
+
+typedef struct channel channel;
+
+channel *channel_from_fd(int fd);
+int channel_queue(channel *ends[2]);
+void channel_close(channel *ch);
+ssize_t channel_read(channel *ch, void *buf, size_t size);
+ssize_t channel_write(channel *ch, const void *buf, size_t size);
+int channel_wait(channel *ch, int timeout_ms);
+long channel_pending(channel *ch);
+void channel_drain(channel *ch);
+int channel_replace(channel *ch, int fd);
+int channel_fd(channel *ch);
+const pipe_io_stats *channel_stats(const channel *ch);
+
+#endif // CHANNEL_H
@@ -0,0 +1,53 @@
+// checkpoint.h
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "occupancy.h"
+
+/*
+* Snapshot of the world of the blackboard, from which a blackboard restarted by the supervisor (./DroneGame -R)
+* resumes the round it was playing instead of going back to the menu.
+* - main creates the directory and gives it to the blackboard in its environment (CHECKPOINT_ENV).
+* - Every CHECKPOINT_PERIOD of play the blackboard forks a saver, which writes the map of the fork into one of two
+*   map files (map_file.h, renamed into place), then the drone, the score and the time played into the matching slot
+*   of a small state file mapped by both. The slot is published last: a crash at any point leaves the previous
+*   snapshot whole. The frame goes on while the map is written; a period is skipped while the last saver runs.
+* - Every frame the blackboard also writes the drone, the score and the time played into the state file (a frame
+*   record, double-slotted the same way). A resumed round takes them from the last frame when it is of the same round
+*   and the drone is not on an obstacle of the snapshot map, so that it does not go back to the last snapshot.
+* - Only a whole map is saved: the chunked world is rebuilt from its seed, it is not checkpointed.
+*/
+#define CHECKPOINT_ENV "DRONE_CHECKPOINT"
+#define CHECKPOINT_MAGIC 0x54504B43u // * "CKPT"
+#define CHECKPOINT_FRAME_MAGIC 0x4D524646u // * "FFRM"
+#define CHECKPOINT_PERIOD 1.0 // * Seconds of play between two snapshots
+#define CHECKPOINT_GENERATOR_MAP "generator.dgm" // * Map of the directory handed to a generator restarted alone
+
+typedef struct {
+    int32_t drone_pos[4], drone_force[2];
+    int32_t score, distance_traveled;
+    int32_t wave, round;
+    int32_t elapsed; // * Seconds played in the round, without the pauses
+} checkpoint_state;
+
+typedef struct {
+    uint32_t magic; // * Written once the first snapshot is published
+    _Atomic int32_t slot; // * Slot of the last whole snapshot
+    checkpoint_state states[2];
+    uint32_t frame_magic; // * Written once the first frame record is published
+    _Atomic int32_t frame_slot; // * Slot of the last whole frame record
+    checkpoint_state frames[2];
+} checkpoint_page;
+
+int checkpoint_open(void);
+void checkpoint_close(void);
+int checkpoint_save(const occupancy_map *world, const checkpoint_state *state);
+void checkpoint_track(const checkpoint_state *state);
+int checkpoint_restore(checkpoint_state *state, char *map_path, size_t size);
+int checkpoint_last_frame(checkpoint_state *state);
+void checkpoint_remove(const char *dir);
+
+#endif // CHECKPOINT_H
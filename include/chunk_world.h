@@ -0,0 +1,33 @@
+// chunk_world.h
+#ifndef CHUNK_WORLD_H
+#define CHUNK_WORLD_H
+
+#include "occupancy.h"
+
+/*
+* Cache of the resident tiles of a chunked world.
+* - Every tile is a CHUNK_SIZE x CHUNK_SIZE occupancy map whose origin is its position in the world.
+* - The cache holds at most `capacity` tiles: memory is bounded by the number of resident tiles,
+*   not by the size of the world. When it is full, the tile farthest from the drone is evicted.
+*/
+typedef struct {
+    int used;
+    int tile_x, tile_y;
+    occupancy_map tile;
+} chunk_slot;
+
+typedef struct {
+    chunk_slot *slots;
+    int capacity;
+    int resident;
+} chunk_world;
+
+int chunk_world_init(chunk_world *world, int capacity);
+void chunk_world_free(chunk_world *world);
+occupancy_map *chunk_world_find(chunk_world *world, int tile_x, int tile_y);
+occupancy_map *chunk_world_reserve(chunk_world *world, int tile_x, int tile_y, int center_x, int center_y);
+int chunk_world_window(const chunk_world *world, int x0, int y0, int height, int width, occupancy_map *window);
+int chunk_world_remove_target(chunk_world *world, int x, int y);
+int chunk_tile_of(int position);
+
+#endif // CHUNK_WORLD_H
@@ -0,0 +1,67 @@
+// collision.h
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "occupancy.h"
+
+/*
+* Swept-segment collision queries against a bucketed spatial index.
+* - Entities (obstacles and targets) are stored once in the bucket that contains their cell.
+* - A query walks only the buckets crossed by the drone's movement segment (DDA over buckets),
+*   so its cost depends on the entities near the path and not on the number of cells covered.
+* - The id of a removed entity is reused by the next insertion (free list), so the entities of a long game stay as
+*   many as the live ones. Every reuse bumps the generation of the id: a reference kept past a removal (a timer
+*   event) stores the generation with the id and is stale when they no longer match (collision_index_live).
+*/
+#define COLLISION_BUCKET 8 // * Side of a bucket in cells
+#define COLLISION_MAX_PICKUPS 32 // * Maximum number of targets reported by a single query
+
+typedef struct {
+    int x, y; // * Cell of the entity
+    char kind; // * 'o' for obstacles, '0'..'9' for targets
+    int bucket; // * Bucket holding the entity, -1 if removed
+    int slot; // * Position inside the bucket list, next free id if removed
+    int generation; // * Times the id was removed
+    int tag; // * Free for the owner of the index (e.g. timer of the entity), -1 by default
+} collision_entity;
+
+typedef struct {
+    int *items; // * Entity ids
+    int count;
+    int capacity;
+} collision_bucket;
+
+typedef struct {
+    int height, width; // * Size of the indexed map in cells
+    int buckets_x, buckets_y; // * Number of buckets per axis
+    collision_bucket *buckets;
+    collision_entity *entities;
+    int num_entities; // * Ids in use or free, the removed ones have bucket -1
+    int capacity_entities;
+    int free_list; // * Last removed id, -1 if none
+} collision_index;
+
+typedef struct {
+    int x0, y0; // * Start cell of the movement
+    int x1, y1; // * End cell of the movement
+} collision_segment;
+
+typedef struct {
+    int obstacle; // * Id of the first obstacle hit, -1 if none
+    double t_obstacle; // * Parameter in [0, 1] along the segment where the obstacle is hit
+    int num_targets; // * Targets crossed before the obstacle, sorted by parameter
+    int targets[COLLISION_MAX_PICKUPS];
+    double t_targets[COLLISION_MAX_PICKUPS];
+    int truncated; // * 1 if more than COLLISION_MAX_PICKUPS targets were crossed
+} collision_result;
+
+int collision_index_init(collision_index *index, int height, int width);
+void collision_index_free(collision_index *index);
+int collision_index_build(collision_index *index, const occupancy_map *map);
+int collision_index_insert(collision_index *index, int x, int y, char kind);
+void collision_index_remove(collision_index *index, int id);
+int collision_index_live(const collision_index *index, int id, int generation);
+int collision_index_move(collision_index *index, int id, int x, int y);
+void collision_query(const collision_index *index, const collision_segment *segment, collision_result *result);
+
+#endif // COLLISION_H
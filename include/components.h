@@ -0,0 +1,32 @@
+// components.h
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "macros.h"
+#include "channel.h"
+
+/*
+* Entry functions of the components: the loop of each one, on channels instead of file descriptors (channel.h).
+* - In ./DroneGame each component is a process: its main() parses the command line, installs the signal handlers
+*   (closure, heartbeat, latency report), wraps its pipes in channels and calls its entry.
+* - In ./DroneGameThreads (threads.h) the components are threads of one process, started on in-memory queues. The
+*   sources are compiled with DRONE_THREADS, which leaves out their main() and signal handlers.
+* An entry opens the rings, heartbeat and metrics of its component and closes them before returning; the caller
+* owns the channels and closes them after it. An entry returns when its peer closes its channel, or when it is
+* stopped (SIGTERM in a process, watchdog_stop for the watchdog thread).
+*/
+int blackboard_run(channel *const in[NUM_CHILD_PIPES], channel *const out[NUM_CHILD_PIPES - 1],
+    channel *autopilot_out, int map_height, int map_width, uint64_t seed, int chunked, const char *map_path,
+    int logfile_fd);
+int keyboard_run(channel *out, int logfile_fd);
+int autopilot_run(channel *in, channel *out, int logfile_fd);
+int obstacles_run(channel *in, channel *out, int map_height, int map_width, double density, int spacing,
+    int logfile_fd);
+int targets_run(channel *in, channel *out, int map_height, int map_width, int logfile_fd);
+int dynamics_run(channel *in, channel *out, int map_height, int map_width, int logfile_fd);
+int watchdog_run(const pid_t ids[NUM_CHILD_PROCESSES - 1], int threads, int logfile_fd);
+void watchdog_stop(void);
+
+#endif // COMPONENTS_H
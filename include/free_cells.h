@@ -0,0 +1,32 @@
+// free_cells.h
+#ifndef FREE_CELLS_H
+#define FREE_CELLS_H
+
+#include "occupancy.h"
+#include "rng.h"
+
+/*
+* Uniform sampling of the free cells (no obstacle and no target) of a rectangle of a map, optionally restricted to
+* the cells of another layer (e.g. the cells the drone can reach).
+* - When most of the rectangle is occupied the free cells are collected once in a compact list and every draw
+*   is one step of a partial Fisher-Yates shuffle (pick, swap with the last, shrink): O(1), no retries.
+* - When at least half of the rectangle is free the list would only waste memory: a draw retries random cells
+*   of the map, with less than 2 attempts on average, and switches to the list when a quarter is left.
+*   In this mode the drawn cell must be occupied (e.g. a target added) before the next draw.
+* Either way, k draws cost O(k) after an O(cells/64 + free cells) build.
+*/
+typedef struct {
+    const occupancy_map *map;
+    int x0, y0, height, width; // * Sampled rectangle
+    int32_t exclude; // * Cell never drawn (e.g. the drone start), -1 if none
+    const uint64_t *allowed; // * Layer of the cells that can be drawn (stride of the map), NULL for all
+    int32_t *cells; // * Free cells (y * map width + x), NULL when sampling by retries
+    long count; // * Free cells left
+} free_cells;
+
+int free_cells_build(free_cells *pool, const occupancy_map *map, int x0, int y0, int height, int width,
+    int32_t exclude, const uint64_t *allowed);
+void free_cells_free(free_cells *pool);
+int32_t free_cells_draw(free_cells *pool, rng_state *rng);
+
+#endif // FREE_CELLS_H
@@ -0,0 +1,61 @@
+// generator.h
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+#include <limits.h>
+#include "rng.h"
+
+/*
+* Requests sent by the blackboard to the obstacles and targets generators.
+* - GEN_MAP: generate the whole map of round `count`, of the size given at launch. The obstacles generator keeps
+*   the maps of the next MAP_QUEUE_DEPTH rounds ready, so a new round is a queue pop.
+* - GEN_TILE: generate the tile (tile_x, tile_y) of a chunked world for round `count`. The tile only depends on
+*   (seed, count, tile_x, tile_y).
+* - GEN_RESPAWN: targets only, put `count` new targets on the free cells of the last map generated.
+* - GEN_STREAM: obstacles only, start (count = 1) or stop (count = 0) moving the obstacles of the last map
+*   generated. While the stream is on, the obstacles generator sends a batch of move events every OBSTACLE_TICK;
+*   a stop is acknowledged by a batch with count = -1, after which the pipe carries replies again.
+* - GEN_LOAD: use the map file (map_file.h) whose path follows the request (`count` bytes, no terminator) as the
+*   map of round 0, mapped in place. Both generators answer with an int32 status, 0 or -1.
+* The obstacles generator answers with an occupancy map. For GEN_MAP and GEN_TILE the targets generator also
+* receives the obstacle map (sent with occupancy_write right after the request) and answers with the same map plus
+* the targets. For GEN_RESPAWN it answers with an int32 count followed by that many occupancy_target entries.
+*/
+#define GEN_MAP 1
+#define GEN_TILE 2
+#define GEN_RESPAWN 3
+#define GEN_STREAM 4
+#define GEN_LOAD 5
+#define GEN_PATH_MAX 4096 // * Longest path accepted by GEN_LOAD
+
+typedef struct {
+    int32_t type;
+    int32_t tile_x, tile_y;
+    int32_t count; // * Round (GEN_MAP, GEN_TILE), targets to respawn (GEN_RESPAWN), on/off (GEN_STREAM),
+                   // * path length (GEN_LOAD)
+    uint64_t seed;
+} generator_request;
+
+// * Seed of a round: the first one is the game seed, the next ones are derived from it
+#define GEN_ROUND_SEED(seed, round) ((round) ? rng_hash((seed), (round), -4) : (seed))
+
+/*
+* Move events of the obstacles: an obstacle is named by its rank in the row-major order of the obstacle layer
+* of the map sent with GEN_MAP. A batch fits in PIPE_BUF so that it is written atomically.
+*/
+#define OBSTACLE_MOVES_MAGIC 0x4F4D4F56u // * "OMOV"
+
+typedef struct {
+    uint32_t magic;
+    int32_t count; // * Number of moves that follow, -1 for the end of the stream
+} obstacle_moves_header;
+
+typedef struct {
+    int32_t id; // * Rank of the obstacle
+    int32_t from, to; // * Old and new cell (y * width + x)
+} obstacle_move;
+
+#define OBSTACLE_MOVES_MAX ((int)((PIPE_BUF - sizeof(obstacle_moves_header)) / sizeof(obstacle_move)))
+
+#endif // GENERATOR_H
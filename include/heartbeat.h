@@ -0,0 +1,36 @@
+// heartbeat.h
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+/*
+* Liveness of the main loop of a process, checked by the watchdog every HEARTBEAT_CHECK_MS.
+* - Every process counts the iterations of its main loop in a page of shared memory named after its PID (its
+*   TID for a thread of the threaded build, threads.h): one relaxed increment per iteration, no system call.
+* - Before blocking on its input (a key, a request, a frame) the process marks itself waiting: a process that waits
+*   for its peers is idle, not hung. Once its input arrives it is busy again until the next wait.
+* - A busy process whose count does not move for HEARTBEAT_STALL_MS is stalled (deadlock, endless loop, page
+*   faults...): the watchdog notices it within HEARTBEAT_STALL_MS + HEARTBEAT_CHECK_MS.
+*/
+#define HEARTBEAT_MAGIC 0x48525442u // * "HRTB"
+#define HEARTBEAT_CHECK_MS 50
+#define HEARTBEAT_STALL_MS 150
+
+typedef struct {
+    uint32_t magic;
+    _Atomic uint32_t waiting; // * 1 while the process blocks on its input
+    _Atomic uint64_t beats; // * Iterations of the main loop
+} heartbeat_page;
+
+int heartbeat_open(void);
+void heartbeat_close(void);
+void heartbeat_beat(void);
+void heartbeat_wait(void);
+heartbeat_page *heartbeat_attach(pid_t pid);
+void heartbeat_detach(heartbeat_page *page);
+void heartbeat_remove(pid_t pid);
+
+#endif // HEARTBEAT_H
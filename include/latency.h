@@ -0,0 +1,31 @@
+// latency.h
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+* Fixed-memory latency histograms (HDR-style, log-linear buckets) fed by monotonic-clock stage timers.
+* - Values are nanoseconds. Below 2^LATENCY_SUB_BITS every value has its own bucket, above it every power of two
+*   is split into 2^LATENCY_SUB_BITS linear buckets: the relative error of a bucket is at most 2^-LATENCY_SUB_BITS.
+* - Values from 2^LATENCY_MAX_BITS ns (about 68 s) up fall in the last bucket, the exact maximum is kept aside.
+* - Recording is a clock read, a count of leading zeros and an increment: cheap enough to stay enabled.
+*/
+#define LATENCY_SUB_BITS 5 // * 32 buckets per power of two, about 3% resolution
+#define LATENCY_MAX_BITS 36
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+typedef struct {
+    const char *name; // * Stage measured
+    uint64_t count, sum, max; // * Samples, their total and the largest one (ns)
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_histogram;
+
+uint64_t latency_now(void);
+void latency_record(latency_histogram *histogram, uint64_t ns);
+uint64_t latency_lap(latency_histogram *histogram, uint64_t since);
+uint64_t latency_percentile(const latency_histogram *histogram, double percentile);
+void latency_report(const char *process, const latency_histogram *histograms, int count);
+
+#endif // LATENCY_H
@@ -0,0 +1,56 @@
+// log_ring.h
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+* Logging of every process into logfile.txt through rings, so that a log line costs no system call and no lock:
+* - Every process writes fixed-size records into its own ring, a file of LOG_ENV mapped shared. A writer reserves a
+*   record with one atomic increment, fills it and commits it with a release store of its sequence: no wait, and
+*   safe in a signal handler (log_write), where the reservation keeps a handler from overwriting the record it
+*   interrupted.
+* - A single collector (the watchdog, every LOG_DRAIN_MS, then main at the end of the game) drains the committed
+*   records of every ring, sorts the batch by time and writes it to the logfile at once. The drained position is
+*   kept in the ring, so another collector continues from it.
+* - The rings are files: they survive the process that writes them. The ring of a process that ends normally is
+*   removed once drained, the ring of a process that crashed is kept with its last LOG_CAPACITY records
+*   (./DroneGame -D <dir> prints them). Once drained, a crashed ring is renamed with LOG_DEAD_SUFFIX and no longer
+*   followed, so the restarts of the supervisor never fill the LOG_MAX_RINGS followed by the collector.
+* - Without a ring (LOG_ENV not set, or the ring cannot be created) a line is written to the logfile directly, in
+*   the same format and still async-signal-safe: the offset of the local time is taken when the ring is opened.
+*/
+#define LOG_ENV "DRONE_LOG" // * Directory of the rings, set by main for every process
+#define LOG_MAGIC 0x474F4C52u // * "RLOG"
+#define LOG_CAPACITY 2048 // * Records per process, the oldest are overwritten when the collector falls behind
+#define LOG_TEXT_MAX 240
+#define LOG_DRAIN_MS 100
+#define LOG_MAX_RINGS 64 // * Rings followed by the collector, of the processes alive
+#define LOG_DEAD_SUFFIX ".dead" // * Appended to the name of a crashed ring once drained
+
+typedef struct {
+    _Atomic uint64_t sequence; // * 2 * index + 1 while the record is written, 2 * (index + 1) once committed
+    uint64_t time; // * ns on CLOCK_REALTIME
+    char text[LOG_TEXT_MAX];
+} log_record;
+
+typedef struct {
+    uint32_t magic, capacity;
+    int32_t pid;
+    char process[20];
+    _Atomic uint32_t closed; // * The process ended normally: the ring is removed once drained
+    _Atomic uint64_t head; // * Records reserved by the writers
+    _Atomic uint64_t tail; // * Records drained by the collector
+    log_record records[];
+} log_ring;
+
+int log_open(const char *process, int fallback_fd);
+void log_close(void);
+void log_write(const char *text);
+void log_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+int log_collect(const char *dir, int fd);
+int log_dump(const char *dir, int fd);
+int log_remove(const char *dir);
+
+#endif // LOG_RING_H
@@ -16,12 +16,45 @@
 #define INSPECTOR_FIFO "/tmp/inspector_fifo"
 
 // * Game parameters
-#define GAME_HEIGHT 100
-#define GAME_WIDTH 100
+#define GAME_HEIGHT 100 // * Default map height, see ./DroneGame -H
+#define GAME_WIDTH 100 // * Default map width, see ./DroneGame -W
+#define MIN_GAME_SIDE 16
+#define MAX_GAME_SIDE 20000
 #define FRAME_RATE 60.0 // * Hz
 
 #define INSPECT_WIDTH 20
 
+// * Targets: the map is refilled with a new wave when all the targets are collected
+#define TARGETS_PER_WAVE 9 // * Labels '9' down to '1'
+#define TARGET_WAVES 3
+
+// * Timed world events (seconds, converted to frames): targets expire and respawn elsewhere,
+// * temporary obstacles appear periodically and vanish
+#define TARGET_LIFETIME 30.0
+#define TEMP_OBSTACLE_PERIOD 5.0
+#define TEMP_OBSTACLE_LIFETIME 10.0
+
+// * Obstacles placement (blue noise)
+#define OBSTACLE_DENSITY 0.001 // * Default fraction of the cells holding an obstacle, see ./DroneGame -O
+#define OBSTACLE_SPACING 4 // * Default minimum distance between two obstacles in cells, see ./DroneGame -G
+#define MAX_OBSTACLE_DENSITY 0.25 // * Denser maps leave the drone almost no way through
+#define MAX_OBSTACLE_SPACING 64
+// * Generated maps where the drone reaches a smaller fraction of the free cells are drawn again
+#define REACH_MIN_FRACTION 0.5
+#define MAP_ATTEMPTS 8
+// * Moving obstacles: every tick a fraction of them moves by one cell
+#define OBSTACLE_TICK 0.2 // * Seconds
+#define OBSTACLE_MOVE_FRACTION 0.1
+// * Maps of the next rounds generated ahead of time by the obstacles generator
+#define MAP_QUEUE_DEPTH 2
+
+// * Chunked world (./DroneGame -C): tiles generated on demand around the drone
+#define CHUNK_SIZE 64 // * Side of a tile in cells
+#define CHUNKED_WORLD_SIDE (1 << 20) // * Side of the chunked world in cells
+#define CHUNK_VIEW_RADIUS 1 // * Tiles kept around the drone's tile (3x3 view)
+#define CHUNK_CACHE_CAPACITY 25 // * Maximum number of resident tiles
+#define CHUNK_TARGETS 1 // * Targets per tile
+
 // * Physic parameters
 #define DRONE_MASS 1.0
 #define DAMPING 1.0
@@ -34,5 +67,7 @@
 #define EPSILON 0.2 // * Attractive scaling factor
 #define RHO_TRG 8.0 // * Influence distance for attraction
 #define MIN_RHO_TRG 4.0 // * Minimum distance of attraction
+// * Cells around the drone sent to the dynamics (covers both RHO_OBST and RHO_TRG)
+#define FIELD_RADIUS 8
 
 #endif // MACROS_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+// map_file.h
+#ifndef MAP_FILE_H
+#define MAP_FILE_H
+
+#include <stdint.h>
+#include "occupancy.h"
+
+/*
+* Binary map file, laid out so that it can be mapped and used in place without parsing.
+* - A 64-byte header, then the obstacle layer, the target layer and the target table, each starting on an
+*   OCCUPANCY_ALIGN boundary and zero-padded to it. The layers have the row stride of occupancy_map.
+* - The checksum covers everything after the header, so a truncated or corrupted file is refused.
+* - Integers are stored in the byte order of the machine (little-endian on the supported targets); any change of
+*   the layout bumps MAP_FILE_VERSION.
+*/
+#define MAP_FILE_MAGIC 0x464D4744u // * "DGMF"
+#define MAP_FILE_VERSION 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t height, width;
+    int32_t origin_x, origin_y;
+    int32_t words_per_row;
+    int32_t num_targets;
+    uint64_t obstacles_offset; // * Offsets in bytes from the start of the file
+    uint64_t targets_offset;
+    uint64_t table_offset;
+    uint64_t checksum;
+} map_file_header;
+
+int map_file_probe(const char *path, int *height, int *width);
+int map_file_load(const char *path, occupancy_map *map);
+int map_file_save(const char *path, const occupancy_map *map);
+
+#endif // MAP_FILE_H
@@ -0,0 +1,53 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+/*
+* Runtime counters of the processes, served by the watchdog in Prometheus text format on a UNIX socket:
+*     curl --unix-socket /tmp/dronegame_metrics.sock http://localhost/metrics    (or: nc -U <socket>)
+* - Every source process publishes its counters in a page of shared memory named after its PID (its TID
+*   for a thread of the threaded build, threads.h). It is the only writer of its page: an update is a relaxed
+*   store, no system call and no lock, so it can be done every frame.
+* - The watchdog knows the PID of every process, maps their pages read-only and renders them on each scrape: the
+*   processes never block on a scraper.
+*/
+#define METRICS_SOCKET "/tmp/dronegame_metrics.sock"
+#define METRICS_MAGIC 0x4D545243u // * "MTRC"
+#define METRICS_SLOTS 96 // * Counters per process
+#define METRICS_COUNTER 0
+#define METRICS_GAUGE 1
+
+typedef struct {
+    char family[48]; // * Metric name
+    char labels[64]; // * Labels of the sample without braces, "" for none
+    char help[96];
+    int32_t type; // * METRICS_COUNTER or METRICS_GAUGE
+    double scale; // * Unit of the value (1e-9 for nanoseconds published as seconds)
+    _Atomic int64_t value;
+} metrics_slot;
+
+typedef struct {
+    uint32_t magic;
+    int32_t pid;
+    char process[16];
+    _Atomic int32_t count; // * Registered slots, published once their description is written
+    metrics_slot slots[METRICS_SLOTS];
+} metrics_page;
+
+metrics_page *metrics_open(const char *process);
+void metrics_close(metrics_page *page);
+int metrics_register(metrics_page *page, const char *family, const char *labels, const char *help, int type,
+    double scale);
+void metrics_set(metrics_page *page, int slot, int64_t value);
+void metrics_add(metrics_page *page, int slot, int64_t delta);
+metrics_page *metrics_attach(pid_t pid);
+void metrics_detach(metrics_page *page);
+void metrics_remove(pid_t pid);
+void metrics_render(FILE *out, metrics_page *const *pages, int count);
+
+#endif // METRICS_H
@@ -0,0 +1,68 @@
+// occupancy.h
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "channel.h"
+
+/*
+* Bit-packed map representation, shared by every process and used as wire format.
+* - obstacles: one bit per cell, rows padded to a whole number of 64-bit words
+* - targets: one bit per cell, same layout
+* - target table: sparse (cell, id) pairs sorted by cell, only for the cells with a target
+* A map can also be a window of a bigger map: origin_x/origin_y give its position in the world.
+* The padding bits past `width` of every row are zero: a map received or loaded is refused otherwise, as is a target
+* table with a cell outside the map, out of order or not set in the target layer, or a bad label (occupancy_validate).
+* The layers of a map loaded from a file (map_file.h) live in a private mapping of the file, released with the map.
+*/
+#define OCCUPANCY_MAGIC 0x4F43504Du // * "OCPM"
+#define OCCUPANCY_ALIGN 64 // * Layers are cache-line aligned
+
+typedef struct {
+    int32_t cell; // * y * width + x
+    char id; // * Target label '0'..'9'
+} occupancy_target;
+
+typedef struct {
+    int height, width; // * Size in cells
+    int origin_x, origin_y; // * Position of the (0, 0) cell in the world
+    int words_per_row; // * Row stride of the layers in 64-bit words
+    uint64_t *obstacles;
+    uint64_t *targets;
+    occupancy_target *target_table;
+    int num_targets;
+    int capacity_targets;
+    void *mapping; // * File mapping holding the layers, NULL when they are allocated
+    size_t mapping_size;
+} occupancy_map;
+
+typedef struct {
+    uint32_t magic;
+    int32_t height, width;
+    int32_t origin_x, origin_y;
+    int32_t num_targets;
+} occupancy_header;
+
+int occupancy_parse_size(const char *height_arg, const char *width_arg, int *height, int *width);
+int occupancy_init(occupancy_map *map, int height, int width);
+void occupancy_free(occupancy_map *map);
+void occupancy_clear(occupancy_map *map);
+int occupancy_test(const occupancy_map *map, const uint64_t *layer, int x, int y);
+void occupancy_set(const occupancy_map *map, uint64_t *layer, int x, int y);
+void occupancy_reset(const occupancy_map *map, uint64_t *layer, int x, int y);
+int occupancy_add_target(occupancy_map *map, int x, int y, char id);
+int occupancy_add_targets(occupancy_map *map, occupancy_target *targets, int count);
+int occupancy_remove_target(occupancy_map *map, int x, int y);
+char occupancy_target_id(const occupancy_map *map, int x, int y);
+void occupancy_union(uint64_t *dst, const uint64_t *a, const uint64_t *b, long words);
+void occupancy_intersection(uint64_t *dst, const uint64_t *a, const uint64_t *b, long words);
+long occupancy_popcount(const uint64_t *layer, long words);
+long occupancy_sanitize(occupancy_map *map);
+int occupancy_validate(const occupancy_map *map);
+long occupancy_words(const occupancy_map *map);
+int occupancy_window(const occupancy_map *map, int x0, int y0, int height, int width, occupancy_map *window);
+int occupancy_write(channel *ch, const occupancy_map *map);
+int occupancy_read(channel *ch, occupancy_map *map);
+
+#endif // OCCUPANCY_H
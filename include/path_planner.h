@@ -0,0 +1,50 @@
+// path_planner.h
+#ifndef PATH_PLANNER_H
+#define PATH_PLANNER_H
+
+#include <stdint.h>
+#include "occupancy.h"
+#include "macros.h"
+
+/*
+* Incremental shortest paths from the drone to the nearest target (D* Lite) on the obstacle grid of a whole map.
+* - The search runs backwards from all the targets at once towards the drone, so the plan leads to the cheapest
+*   target. When the drone moves only the offset of the queue keys (k_m) grows, the search is not restarted.
+* - A step costs its length (1 or sqrt 2) times 1 + PLANNER_FIELD_WEIGHT * the repulsive potential of the
+*   obstacles at the cell entered (the field of the dynamics, 1 at MIN_RHO_OBST), so that paths keep away from the
+*   obstacles where there is room. The drone stays in the band where the dynamics clamps it, 8-connected.
+* - When a cell changes (obstacle moved, target collected or spawned) only the cells whose costs depend on it are
+*   updated, and the next query repairs the plan from them: the work is proportional to the changed cells.
+* Memory: 16 bytes per cell besides the map.
+*/
+#define PLANNER_FIELD_WEIGHT 1.0
+#define PLANNER_LOOKAHEAD 4 // * Steps of the path ahead of the drone it is steered to
+#define PLANNER_KEY_SLACK 1e-4 // * Relative rounding of the costs, kept in single precision
+#define PLANNER_FIELD_ONE 1024 // * Fixed point of the potential (exact incremental updates)
+#define PLANNER_FIELD_RADIUS ((int)RHO_OBST)
+#define PLANNER_KERNEL_SIDE (2 * PLANNER_FIELD_RADIUS + 1)
+
+typedef struct {
+    double k1, k2;
+    int32_t cell;
+} planner_entry;
+
+typedef struct {
+    occupancy_map *map; // * Obstacles and targets, kept up to date by planner_set_cell
+    float *g, *rhs; // * Cost to the nearest target, and its one-step lookahead
+    int32_t *field; // * Repulsive potential of the obstacles, PLANNER_FIELD_ONE at MIN_RHO_OBST
+    int32_t *slot; // * Position of each cell in the queue, -1 if not queued
+    planner_entry *queue; // * Binary heap of the inconsistent cells
+    long queue_count, queue_capacity;
+    int32_t kernel[PLANNER_KERNEL_SIDE * PLANNER_KERNEL_SIDE]; // * Potential of one obstacle around it
+    int start, last; // * Cell of the drone, and where it was when k_m was last updated
+    double km;
+} path_planner;
+
+int planner_init(path_planner *planner, occupancy_map *map, int start_x, int start_y);
+void planner_free(path_planner *planner);
+int planner_set_cell(path_planner *planner, int x, int y, int obstacle, int target);
+void planner_move_start(path_planner *planner, int x, int y);
+int planner_next_step(path_planner *planner, int *dx, int *dy);
+
+#endif // PATH_PLANNER_H
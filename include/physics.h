@@ -0,0 +1,14 @@
+// physics.h
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+/*
+* Equation of motion of the drone, shared by the dynamics (authoritative step)
+* and by the blackboard (local prediction of the next position).
+*/
+#define DRONE_BORDER 3 // * Minimum distance of the drone from the map border
+
+int drone_integrate(double force, int previous, int current);
+int drone_clamp(int position, int size);
+
+#endif // PHYSICS_H
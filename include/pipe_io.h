@@ -0,0 +1,22 @@
+// pipe_io.h
+#ifndef PIPE_IO_H
+#define PIPE_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+* Blocking helpers that transfer a whole buffer through a pipe.
+* A single read()/write() may move fewer bytes than requested (pipe capacity, signals),
+* so both helpers loop until the transfer is complete.
+* The components talk through channels (channel.h), which count the traffic of every end in a pipe_io_stats.
+*/
+typedef struct {
+    uint64_t bytes_in, bytes_out; // * Bytes moved by complete transfers
+    uint64_t reads, writes; // * Complete transfers
+} pipe_io_stats;
+ssize_t read_full(int fd, void *buf, size_t size);
+ssize_t write_full(int fd, const void *buf, size_t size);
+
+#endif // PIPE_IO_H
@@ -0,0 +1,28 @@
+// proc_stats.h
+#ifndef PROC_STATS_H
+#define PROC_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+* Resource accounting of a process read from procfs, sampled by the watchdog every period:
+* - /proc/<pid>/stat: CPU time of the whole process (all its threads), in clock ticks;
+* - /proc/<pid>/status: resident set and context switches (of the main thread);
+* - /proc/<pid>/schedstat: time on a CPU and time runnable but waiting on a run queue (of the main thread), absent
+*   on kernels without scheduler statistics.
+* The values are cumulative: the rates are the difference of two samples.
+* A component of the threaded build (threads.h) is a thread of the calling process, read from
+* /proc/self/task/<tid>/: the same files, for the thread alone (but the resident set, of the whole process).
+*/
+typedef struct {
+    uint64_t cpu_ticks; // * utime + stime, in sysconf(_SC_CLK_TCK) units
+    uint64_t rss_bytes;
+    uint64_t voluntary, involuntary; // * Context switches
+    uint64_t run_ns, wait_ns; // * On the CPU, waiting on the run queue (0 without schedstat)
+    int has_schedstat;
+} proc_sample;
+
+int proc_sample_read(pid_t pid, int thread, proc_sample *sample);
+
+#endif // PROC_STATS_H
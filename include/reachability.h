@@ -0,0 +1,24 @@
+// reachability.h
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include <stdint.h>
+#include "occupancy.h"
+
+/*
+* Cells that the drone can reach from its start, computed on the bit layers.
+* - The drone moves in 8-connectivity (a diagonal step passes between two obstacles touching at a corner) and
+*   stays inside the band where the dynamics clamps it, [DRONE_BORDER, size - DRONE_BORDER] on both axes.
+* - Breadth-first search over tiles of REACH_TILE_ROWS rows by one 64-bit word, 64 cells per operation: a word
+*   is grown from the words around it (vertical and diagonal neighbours, with shifts) and filled along its runs of
+*   free cells (shift-and-mask prefix fill); a tile is swept until it converges, then its neighbours are queued.
+* - Large maps are split in bands of rows, one per thread: each band converges with the border rows of its
+*   neighbours frozen, then the borders are exchanged, until no border changes.
+*/
+#define REACH_PARALLEL_CELLS (1L << 24) // * Maps with fewer cells are filled by a single thread
+#define REACH_MAX_THREADS 8
+#define REACH_TILE_ROWS 64
+
+long reachability_fill(const occupancy_map *map, int start_x, int start_y, uint64_t *reach, long *free_count);
+
+#endif // REACHABILITY_H
@@ -0,0 +1,24 @@
+// realtime.h
+#ifndef REALTIME_H
+#define REALTIME_H
+
+/*
+* Low-jitter mode (./DroneGame -L <cpus> [-F]): on a busy host the frame is late more because of the scheduler and
+* the page faults than because of its own cost.
+* - main gives every process the core of each frame-critical process in its environment (REALTIME_ENV): the
+*   blackboard, the dynamics and the input (keyboard manager or autopilot), in the order of the list of -L.
+* - A frame-critical process pins itself to its core, pre-faults a stack and a heap reserve that glibc keeps instead
+*   of returning them to the kernel, locks its memory (mlockall) and waits with the finest timer slack. With -F it
+*   also runs under SCHED_FIFO when the user may. Every step that is not permitted is logged and skipped.
+* - The other processes leave the chosen cores to the frame-critical ones.
+* - The blackboard records how late every timed wait of the frame wakes up (the "jitter" stage of its latency
+*   report): the deviation of the start of the next frame, to compare configurations.
+*/
+#define REALTIME_ENV "DRONE_REALTIME" // * "blackboard=<cpu>,dynamics=<cpu>,input=<cpu>[,fifo]", cpu -1 not pinned
+#define REALTIME_PRIORITY 10 // * SCHED_FIFO priority of the frame-critical processes
+#define REALTIME_STACK_PREFAULT (256 << 10)
+#define REALTIME_HEAP_PREFAULT (8 << 20)
+
+void realtime_enter(const char *process);
+
+#endif // REALTIME_H
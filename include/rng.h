@@ -0,0 +1,23 @@
+// rng.h
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+* 64-bit pseudo random generator (xoshiro256**, seeded with splitmix64).
+* Unlike rand() it has a full 64-bit state per stream, so every generator can own an independent stream
+* and the same seed always reproduces the same map or tile.
+*/
+typedef struct {
+    uint64_t s[4];
+} rng_state;
+
+void rng_seed(rng_state *rng, uint64_t seed);
+uint64_t rng_next(rng_state *rng);
+uint64_t rng_range(rng_state *rng, uint64_t n);
+double rng_uniform(rng_state *rng);
+uint64_t rng_hash(uint64_t seed, int64_t a, int64_t b);
+uint64_t rng_entropy(void);
+
+#endif // RNG_H
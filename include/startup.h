@@ -0,0 +1,17 @@
+// startup.h
+#ifndef STARTUP_H
+#define STARTUP_H
+
+/*
+* Startup profile: every process logs the phases of its bring-up on the clock of main, so that the logfile shows
+* the critical path from the launch to the first frame (the "Startup:" lines, sorted by time by the collector).
+* - main gives its launch time (ns on CLOCK_MONOTONIC, the same clock in every process) in the environment of every
+*   process (STARTUP_ENV).
+* - A phase is logged with the time since the launch, and recorded in the trace (./DroneGame -T) as a span from the
+*   previous phase of the process.
+*/
+#define STARTUP_ENV "DRONE_STARTUP"
+
+void startup_phase(const char *process, const char *phase);
+
+#endif // STARTUP_H
@@ -0,0 +1,41 @@
+// supervisor.h
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+
+/*
+* Supervisor mode (./DroneGame -R): main restarts the component that failed instead of ending the game.
+* - The dynamics and the keyboard manager have no state of the round: each is restarted alone, on the ends of its
+*   pipes that main keeps open for it, with SUPERVISOR_RESTART_ENV in its environment. A dynamics restarted alone
+*   drops what is left of the lost frame and replies DYNAMICS_RESTARTED: the blackboard then sends the frame again
+*   (it never resends on a timeout, a slow dynamics is only waited for).
+* - A generator is restarted alone on new pipes: main hands the ends of the blackboard over to it through a socket
+*   (SUPERVISOR_GENERATORS_ENV, SCM_RIGHTS). The blackboard waits for them when it finds the generator gone (the end
+*   of its stream, or EPIPE), swaps them into its channels and sends the generator the current map (GEN_LOAD, with
+*   the seed of the round for the targets), then sends the request that failed again.
+* - The blackboard and the autopilot share the state of the round through their pipes: they are restarted together
+*   with the generators on new pipes, and the blackboard resumes from its last snapshot (checkpoint.h), up to
+*   CHECKPOINT_PERIOD of play behind. Its first frame comes 12 to 22 ms after the failure on a 100x100 map (the
+*   startup of a blackboard: ncurses, the inspector, the snapshot map), against 0.2 ms to spawn a generator alone.
+* - main tells the watchdog the new PID of every restarted component through a pipe, whose read end is given in the
+*   environment of the watchdog (SUPERVISOR_ENV). The watchdog then kills a dynamics or a blackboard busy without a
+*   beat for SUPERVISOR_HANG_MS, so that it is restarted, and no longer ends the game for an inactive component.
+* - A component that fails SUPERVISOR_MAX_RESTARTS times within SUPERVISOR_WINDOW ends the game.
+*/
+#define SUPERVISOR_ENV "DRONE_SUPERVISOR"
+#define SUPERVISOR_RESTART_ENV "DRONE_RESTARTED" // * Set for a component restarted alone
+#define SUPERVISOR_GENERATORS_ENV "DRONE_GENERATORS" // * Socket of the blackboard for the ends of the generators
+#define SUPERVISOR_RECONNECT_MS 3000 // * Longest wait of the blackboard for the ends of a generator restarted
+#define DYNAMICS_RESTARTED "restarted" // * First reply of a dynamics restarted alone
+#define SUPERVISOR_HANG_MS 3000
+#define SUPERVISOR_MAX_RESTARTS 5
+#define SUPERVISOR_WINDOW 60 // * Seconds
+
+// * Message of main to the watchdog, and to the blackboard with the ends of a generator (read end, then write end)
+typedef struct {
+    int32_t component; // * 0..3 the children of main in their order, 4 the blackboard
+    int32_t pid; // * PID of the restarted component
+} supervisor_restart;
+
+#endif // SUPERVISOR_H
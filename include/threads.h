@@ -0,0 +1,24 @@
+// threads.h
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stdint.h>
+
+/*
+* Threaded build (./DroneGameThreads, the same options as ./DroneGame but -R): main runs the components as threads
+* of its own process instead of spawning them, on in-memory queues instead of pipes (channel.h).
+* - The threads run the entry functions of the components (components.h) on the channels a process would get: a
+*   key, a frame or a map moves between two threads with two copies and no system call, and nothing is spawned.
+* - The watchdog is a thread too. It signals the components with tgkill, watches them with thread pidfds (Linux
+*   6.9, the heartbeat signals otherwise) and samples each one from /proc/self/task/<tid>
+*   (the CPU time and context switches are the thread's, the memory is the process's).
+* - The rings, heartbeat pages and metrics pages are per thread and named after its TID, the logfile and the
+*   metrics endpoint are the same as with processes.
+* - The components share a fate: a crash, or a fatal error that exits, ends the whole game. There is no
+*   supervisor, and the latency reports are written at the end of the game only (SIGUSR2 is ignored).
+*/
+
+int threads_run(int map_height, int map_width, double obstacle_density, int obstacle_spacing, uint64_t seed,
+    int chunked, const char *map_path, int autopilot, int logfile_fd);
+
+#endif // THREADS_H
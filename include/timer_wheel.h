@@ -0,0 +1,47 @@
+// timer_wheel.h
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/*
+* Hierarchical timer wheel (ticks are game frames).
+* - TIMER_LEVELS wheels of TIMER_SLOTS slots: the level L slot of a timer covers TIMER_SLOTS^L ticks, so the
+*   wheels reach TIMER_SLOTS^TIMER_LEVELS ticks ahead (farther timers are clamped to the horizon).
+* - Every slot is an intrusive doubly linked list of timers stored in a pool: scheduling and cancelling are O(1).
+* - When the lowest wheel wraps, the next slot of the upper wheel is cascaded down: each timer moves down at
+*   most TIMER_LEVELS-1 times before firing.
+*/
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 4
+
+typedef struct {
+    int kind; // * What happens, defined by the owner of the wheel
+    int32_t a, b; // * Payload (e.g. entity id and cell)
+} timer_event;
+
+typedef struct {
+    uint64_t expires; // * Tick at which the timer fires
+    timer_event event;
+    int prev, next; // * Links in the slot list, or next free timer
+    int slot; // * Slot holding the timer, -1 if the timer is not scheduled
+} timer_entry;
+
+typedef struct {
+    uint64_t current; // * Last tick processed
+    int heads[TIMER_LEVELS * TIMER_SLOTS]; // * First timer of each slot, -1 if empty
+    timer_entry *timers;
+    int capacity;
+    int free_list; // * First unused timer of the pool, -1 if none
+    int active; // * Scheduled timers
+} timer_wheel;
+
+int timer_wheel_init(timer_wheel *wheel, uint64_t now);
+void timer_wheel_free(timer_wheel *wheel);
+int timer_wheel_schedule(timer_wheel *wheel, uint64_t expires, timer_event event);
+void timer_wheel_cancel(timer_wheel *wheel, int id);
+int timer_wheel_advance(timer_wheel *wheel, uint64_t now, timer_event *fired, int max_fired);
+uint64_t timer_wheel_next(const timer_wheel *wheel);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,43 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+* End-to-end tracing of the keys (./DroneGame -T <file>), merged into a Chrome/Perfetto JSON trace on exit.
+* - A key is identified by its sequence number on the keyboard pipe: the keyboard manager (or the autopilot) counts
+*   the keys it writes and the blackboard the keys it reads, so both ends agree without changing the pipe. The
+*   blackboard passes the number on to the dynamics and to the inspector with the frame.
+* - Every process records its spans in its own ring, a file of TRACE_ENV mapped shared: one writer, which publishes
+*   a span by a release store of the head, and no lock. The spans survive the process (even when it is killed)
+*   and main merges the rings once every process has exited.
+* - When the ring is full the oldest spans are overwritten.
+*/
+#define TRACE_ENV "DRONE_TRACE" // * Directory of the rings, set by main for every process
+#define TRACE_MAGIC 0x54524345u // * "TRCE"
+#define TRACE_CAPACITY 16384 // * Spans kept per process
+#define TRACE_NAME_MAX 11
+
+typedef struct {
+    uint64_t start, duration; // * ns on CLOCK_MONOTONIC, the same clock in every process
+    uint32_t id; // * Sequence number of the key, 0 for none
+    char flow; // * Hop of the key: 's' first, 't' next, 'f' last, 0 if the span is not a hop
+    char name[TRACE_NAME_MAX];
+} trace_span;
+
+typedef struct {
+    uint32_t magic, capacity;
+    int32_t pid;
+    char process[20];
+    _Atomic uint64_t head; // * Spans written so far
+    trace_span spans[];
+} trace_ring;
+
+int trace_open(const char *process);
+void trace_close(void);
+void trace_record(const char *name, uint32_t id, uint64_t start, uint64_t end, char flow);
+int trace_merge(const char *dir, const char *output);
+
+#endif // TRACE_H
@@ -2,6 +2,7 @@
 // Created by Gian Marco Balia
 //
 // main.c
+#define _GNU_SOURCE // * pipe2
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -9,27 +10,228 @@
 #include <string.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <getopt.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
 #include "macros.h"
+#include "rng.h"
+#include "generator.h"
+#include "map_file.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "supervisor.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
+#ifdef DRONE_THREADS
+#include "threads.h"
+#endif
 
-FILE *logfile;
+// * Map size passed to every component (./DroneGame -H <height> -W <width>)
+int map_height = GAME_HEIGHT;
+int map_width = GAME_WIDTH;
+// * Density and minimum spacing of the obstacles (./DroneGame -O <density> -G <spacing>)
+double obstacle_density = OBSTACLE_DENSITY;
+int obstacle_spacing = OBSTACLE_SPACING;
+// * Chunked world (-C) and seed of the generators (-S), the same seed always gives the same world
+int chunked = 0;
+uint64_t seed = 0;
+// * Map file loaded instead of generating the first map (-M), its size overrides -H and -W
+const char *map_path = NULL;
+// * Autopilot in place of the keyboard manager (-A), for unattended runs
+int autopilot = 0;
+// * Chrome/Perfetto trace of the keys written on exit (-T), NULL for none
+const char *trace_path = NULL;
+// * Supervisor mode (-R): the components that fail are restarted (supervisor.h), and the socket on which main hands
+// * the blackboard the ends of a generator restarted alone ([0] main, [1] the blackboard)
+int supervise = 0;
+int generator_link[2] = {-1, -1};
+// * Directory of log rings printed instead of playing (-D), for the rings kept after a crash (log_ring.h)
+const char *dump_dir = NULL;
+// * Low-jitter mode (realtime.h): cores of the blackboard, the dynamics and the input (-L), -1 not pinned, and
+// * SCHED_FIFO (-F)
+int realtime_cpus[3] = {-1, -1, -1};
+int low_jitter = 0, realtime_fifo = 0;
 
-void write_log(FILE *logfile, pid_t pid, const char *message);
+extern char **environ;
+
+#ifndef DRONE_THREADS
 int create_pipes(int pipes[NUM_CHILD_PIPES][2]);
 int create_processes(int pipes_out[NUM_CHILD_PIPES][2], int pipes_in[NUM_CHILD_PIPES][2],
-    pid_t pids[NUM_CHILD_PROCESSES-2], int logfile_fd);
+    pid_t pids[NUM_CHILD_PROCESSES-2], pid_t *blackboard_pid, int logfile_fd);
+pid_t spawn_process(char *const args[], const int *fds, int count);
+pid_t create_child_process(int i, int pipes_out[NUM_CHILD_PIPES][2], int pipes_in[NUM_CHILD_PIPES][2],
+    int logfile_fd);
 pid_t create_blackboard_process(int pipes_in[NUM_CHILD_PIPES][2], int pipes_out[NUM_CHILD_PIPES][2], int logfile_fd);
-pid_t create_watchdog_process(pid_t pids[NUM_CHILD_PROCESSES-2], pid_t blackboard_pid, int logfile_fd);
+pid_t create_watchdog_process(pid_t pids[NUM_CHILD_PROCESSES-2], pid_t blackboard_pid, int logfile_fd,
+    int supervisor_fd);
+void close_pipes(int pipes_to[NUM_CHILD_PIPES][2], int pipes_from[NUM_CHILD_PIPES][2], int keep);
+int restart_component(int component, pid_t pids[NUM_CHILD_PROCESSES-2], pid_t *blackboard_pid,
+    int pipes_to[NUM_CHILD_PIPES][2], int pipes_from[NUM_CHILD_PIPES][2], int logfile_fd, int supervisor_fd);
+int send_generator_ends(int component, pid_t pid, int read_fd, int write_fd);
+#endif
 
-int main(void) {
-    // * Create the logfile
-    logfile = fopen("./logfile.txt", "w+");
-    if (!logfile) {
+int main(int argc, char *argv[]) {
+    // * Origin of the startup profile (startup.h)
+    struct timespec launch;
+    clock_gettime(CLOCK_MONOTONIC, &launch);
+    // * Parse the launch options
+    int opt, seed_given = 0;
+    while ((opt = getopt(argc, argv, "H:W:O:G:CS:M:AT:RD:L:F")) != -1) {
+        switch (opt) {
+            case 'H': map_height = atoi(optarg); break;
+            case 'W': map_width = atoi(optarg); break;
+            case 'O': {
+                char *end;
+                obstacle_density = strtod(optarg, &end);
+                if (end == optarg || *end != '\0') {
+                    obstacle_density = -1.0; // * Rejected below
+                }
+                break;
+            }
+            case 'G': obstacle_spacing = atoi(optarg); break;
+            case 'C': chunked = 1; break;
+            case 'S': seed = strtoull(optarg, NULL, 10); seed_given = 1; break;
+            case 'M': map_path = optarg; break;
+            case 'A': autopilot = 1; break;
+            case 'T': trace_path = optarg; break;
+            case 'R': supervise = 1; break;
+            case 'D': dump_dir = optarg; break;
+            case 'L': {
+                // * A shorter list leaves the next processes on the last core given
+                char *cpu = optarg, *end;
+                for (int i = 0; i < 3; i++) {
+                    if (i > 0 && *cpu == '\0') {
+                        realtime_cpus[i] = realtime_cpus[i - 1];
+                        continue;
+                    }
+                    realtime_cpus[i] = (int)strtol(cpu, &end, 10);
+                    if (end == cpu || (*end != ',' && *end != '\0')) {
+                        realtime_cpus[i] = -2; // * Rejected below
+                    }
+                    cpu = *end == ',' ? end + 1 : end;
+                }
+                low_jitter = 1;
+                break;
+            }
+            case 'F': realtime_fifo = low_jitter = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-H height] [-W width] [-O density] [-G spacing] [-C] [-S seed] "
+                    "[-M map_file] [-A] [-T trace_file] [-R] [-D log_dir] [-L cpu,cpu,cpu] [-F]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+#ifdef DRONE_THREADS
+    if (supervise) {
+        fprintf(stderr, "The supervisor restarts processes: -R is not available in the threaded build.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (dump_dir) {
+        if (log_dump(dump_dir, STDOUT_FILENO) == -1) {
+            perror(dump_dir);
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+    }
+    if (map_path) {
+        if (chunked || strlen(map_path) > GEN_PATH_MAX || map_file_probe(map_path, &map_height, &map_width) == -1) {
+            fprintf(stderr, "Cannot load the map file %s (not a map file of this version, or chunked mode).\n",
+                map_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (autopilot && chunked) {
+        fprintf(stderr, "The autopilot plans on a whole map, it cannot fly a chunked world.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (map_height < MIN_GAME_SIDE || map_height > MAX_GAME_SIDE || map_width < MIN_GAME_SIDE ||
+        map_width > MAX_GAME_SIDE) {
+        fprintf(stderr, "Map size must be between %d and %d.\n", MIN_GAME_SIDE, MAX_GAME_SIDE);
+        exit(EXIT_FAILURE);
+    }
+    if (!(obstacle_density >= 0.0 && obstacle_density <= MAX_OBSTACLE_DENSITY)) {
+        fprintf(stderr, "The obstacle density must be between 0 and %g.\n", MAX_OBSTACLE_DENSITY);
+        exit(EXIT_FAILURE);
+    }
+    if (obstacle_spacing < 1 || obstacle_spacing > MAX_OBSTACLE_SPACING) {
+        fprintf(stderr, "The obstacle spacing must be between 1 and %d cells.\n", MAX_OBSTACLE_SPACING);
+        exit(EXIT_FAILURE);
+    }
+    const long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (int i = 0; i < 3; i++) {
+        if (realtime_cpus[i] < -1 || realtime_cpus[i] >= num_cpus) {
+            fprintf(stderr, "The cores of -L must be between 0 and %ld.\n", num_cpus - 1);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!seed_given) {
+        seed = rng_entropy();
+    }
+    // * A chunked world has a fixed size, only the tiles around the drone are generated
+    if (chunked) {
+        map_height = CHUNKED_WORLD_SIDE;
+        map_width = CHUNKED_WORLD_SIDE;
+    }
+    // * Create the logfile: appended to by the collector of the rings, and by the processes that have no ring
+    int logfile_fd = open("./logfile.txt", O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (logfile_fd == -1) {
         perror("Errore apertura logfile");
         exit(EXIT_FAILURE);
     }
-    int logfile_fd = fileno(logfile);
-    write_log(logfile, getpid(), "Main process started.");
+    // * Logging: every process finds the directory of the rings in its environment (without it, every process
+    // * writes to the logfile directly)
+    char log_dir[] = "/tmp/dronegame_log_XXXXXX";
+    const int log_rings = mkdtemp(log_dir) && setenv(LOG_ENV, log_dir, 1) == 0;
+    if (!log_rings) {
+        perror("log directory");
+    }
+    if (log_open("main", logfile_fd) == -1) {
+        perror("log");
+    }
+    log_write("Main process started.");
+    // * Startup profile: every process times its phases from the launch of main
+    char launch_str[24];
+    snprintf(launch_str, sizeof(launch_str), "%lld", (long long)launch.tv_sec * 1000000000LL + launch.tv_nsec);
+    if (setenv(STARTUP_ENV, launch_str, 1) == -1) {
+        perror("startup profile");
+    }
+    log_printf("World seed: %llu%s, obstacle density %g, spacing %d", (unsigned long long)seed,
+        chunked ? " (chunked)" : "", obstacle_density, obstacle_spacing);
+    // * Tracing: every process finds the directory of the rings in its environment
+    char trace_dir[] = "/tmp/dronegame_trace_XXXXXX";
+    if (trace_path && (!mkdtemp(trace_dir) || setenv(TRACE_ENV, trace_dir, 1) == -1)) {
+        perror("trace directory");
+        exit(EXIT_FAILURE);
+    }
+    // * Low-jitter mode: every process finds the cores of the frame-critical processes in its environment
+    char realtime_spec[96];
+    snprintf(realtime_spec, sizeof(realtime_spec), "blackboard=%d,dynamics=%d,input=%d%s", realtime_cpus[0],
+        realtime_cpus[1], realtime_cpus[2], realtime_fifo ? ",fifo" : "");
+    if (low_jitter && setenv(REALTIME_ENV, realtime_spec, 1) == -1) {
+        perror("low-jitter mode");
+        exit(EXIT_FAILURE);
+    }
+    // * Supervisor: the snapshots of the blackboard, and the link that tells the watchdog the restarted components
+    char checkpoint_dir[] = "/tmp/dronegame_checkpoint_XXXXXX";
+    int supervisor_link[2] = {-1, -1};
+    if (supervise && (!mkdtemp(checkpoint_dir) || setenv(CHECKPOINT_ENV, checkpoint_dir, 1) == -1 ||
+        socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, supervisor_link) == -1 ||
+        socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, generator_link) == -1)) {
+        perror("supervisor");
+        exit(EXIT_FAILURE);
+    }
 
+#ifdef DRONE_THREADS
+    // * Steps 1 to 5 at once: the components run as threads of main, on in-memory channels (threads.h)
+    if (threads_run(map_height, map_width, obstacle_density, obstacle_spacing, seed, chunked, map_path,
+        autopilot, logfile_fd) != EXIT_SUCCESS) {
+        fprintf(stderr, "The game ended on a failure.\n");
+    }
+#else
     // * Declaration of pipes and process IDs
     int pipes_to_balckboard[NUM_CHILD_PIPES][2]; // * Array to hold pipe file descriptors
     int pipes_from_balckboard[NUM_CHILD_PIPES][2]; // * Array to hold pipe file descriptors
@@ -43,8 +245,9 @@ int main(void) {
         fprintf(stderr, "Failed to create pipes.\n");
         exit(EXIT_FAILURE);
     }
-    // * Step 2: Create processes that use pipes
-    if (create_processes(pipes_to_balckboard, pipes_from_balckboard, pids, logfile_fd) == -1) {
+    // * Step 2: Spawn the children and the blackboard, which initialize concurrently
+    pid_t blackboard_pid;
+    if (create_processes(pipes_to_balckboard, pipes_from_balckboard, pids, &blackboard_pid, logfile_fd) == -1) {
         fprintf(stderr, "Failed to create processes.\n");
         // * Close all pipes before exiting
         for (int i = 0; i < NUM_CHILD_PIPES; i++) {
@@ -55,55 +258,78 @@ int main(void) {
         }
         exit(EXIT_FAILURE);
     }
-    // * Step 3: Create the Blackboard Process
-    const pid_t blackboard_pid = create_blackboard_process(pipes_to_balckboard, pipes_from_balckboard,
-        logfile_fd);
-    if (blackboard_pid == -1) {
-        fprintf(stderr, "Failed to create blackboard process.\n");
-        // * Terminate child processes and watchdog
-        for (int i = 0; i < NUM_CHILD_PROCESSES-1; i++) {
-            kill(pids[i], SIGTERM);
-        }
-        // * Close all pipes before exiting
-        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-            close(pipes_to_balckboard[i][0]);
-            close(pipes_to_balckboard[i][1]);
-            close(pipes_from_balckboard[i][0]);
-            close(pipes_from_balckboard[i][1]);
-        }
-        exit(EXIT_FAILURE);
-    }
-    // * Step 4: Create the Watchdog process
-    const pid_t watchdog_pid = create_watchdog_process(pids, blackboard_pid, logfile_fd);
+    // * Step 3: Close All Pipes in the Parent Process: the generators serve requests until the blackboard closes
+    // * its ends, so no other process may keep them open (the supervisor keeps the ends of the components it
+    // * restarts alone; every end is close-on-exec, a process inherits only the ends it is spawned with)
+    close_pipes(pipes_to_balckboard, pipes_from_balckboard, supervise);
+    // * Step 4: Create the Watchdog process, once it knows every PID
+    pid_t watchdog_pid = create_watchdog_process(pids, blackboard_pid, logfile_fd, supervisor_link[1]);
     if (watchdog_pid == -1) {
         fprintf(stderr, "Failed to create watchdog process.\n");
         // * Terminate already created child processes
-        for (int i = 0; i < NUM_CHILD_PROCESSES-1; i++) {
+        for (int i = 0; i < NUM_CHILD_PROCESSES-2; i++) {
             kill(pids[i], SIGTERM);
         }
-        kill(watchdog_pid, SIGTERM);
-        // * Close all pipes before exiting
-        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-            close(pipes_to_balckboard[i][0]);
-            close(pipes_to_balckboard[i][1]);
-            close(pipes_from_balckboard[i][0]);
-            close(pipes_from_balckboard[i][1]);
-        }
+        kill(blackboard_pid, SIGTERM);
         exit(EXIT_FAILURE);
     }
-    // * Step 5: Close All Pipes in the Parent Process
-    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-        close(pipes_to_balckboard[i][0]);
-        close(pipes_to_balckboard[i][1]);
-        close(pipes_from_balckboard[i][0]);
-        close(pipes_from_balckboard[i][1]);
+    if (supervise) {
+        close(supervisor_link[1]);
     }
-    // * Step 6: Wait for All Child Processes to finish
-    if (waitpid(blackboard_pid, NULL, 0) == -1) {
+    startup_phase("main", "spawned");
+    // * Step 5: Wait for All Child Processes to finish
+    if (!supervise && waitpid(blackboard_pid, NULL, 0) == -1) {
         perror("waitpid blackboard");
     }
-    for (int i = 0; i < NUM_CHILD_PROCESSES; i++) {
-        // * Send a signal to close the child proces when all is closed
+    // * Supervisor: until the blackboard ends the game, restart every component that fails
+    while (supervise) {
+        int status;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1) {
+            if (errno == EINTR) continue;
+            perror("waitpid");
+            break;
+        }
+        if (pid == watchdog_pid) {
+            log_write("Supervisor: the watchdog exited.");
+            watchdog_pid = -1;
+            continue;
+        }
+        int component = pid == blackboard_pid ? NUM_CHILD_PROCESSES - 2 : -1;
+        for (int i = 0; i < NUM_CHILD_PROCESSES - 2; i++) {
+            if (pids[i] == pid) {
+                component = i;
+            }
+        }
+        if (component == -1) {
+            continue;
+        }
+        // * A normal exit is the end of the game (the children end when the blackboard closes their pipes)
+        if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+            if (pid == blackboard_pid) {
+                break;
+            }
+            pids[component] = -1;
+            continue;
+        }
+        if (restart_component(component, pids, &blackboard_pid, pipes_to_balckboard, pipes_from_balckboard,
+            logfile_fd, supervisor_link[0]) == -1) {
+            break;
+        }
+    }
+    if (supervise) {
+        close_pipes(pipes_to_balckboard, pipes_from_balckboard, 0);
+        close(supervisor_link[0]);
+        close(generator_link[0]);
+        close(generator_link[1]);
+    }
+    for (int i = 0; i < NUM_CHILD_PROCESSES - 2; i++) {
+        // * Send a signal to close the child proces when all is closed (only the children forked by
+        // * create_processes: a stale entry would be pid 0, the whole process group, main included, and a
+        // * component the supervisor gave up on is -1, every process)
+        if (pids[i] <= 0) {
+            continue;
+        }
         if (kill(pids[i], SIGTERM) == -1) {
             perror("kill watchdog");
         }
@@ -112,24 +338,38 @@ int main(void) {
         }
     }
     // * Send a signal to close the watchdog when all is closed
-    if (kill(watchdog_pid, SIGTERM) == -1) {
+    if (watchdog_pid != -1 && kill(watchdog_pid, SIGTERM) == -1) {
         perror("kill watchdog");
     }
-    if (waitpid(watchdog_pid, NULL, 0) == -1) {
+    if (watchdog_pid != -1 && waitpid(watchdog_pid, NULL, 0) == -1) {
         perror("waitpid watchdog");
     }
+    if (supervise) {
+        checkpoint_remove(checkpoint_dir);
+    }
+#endif
+    // * Every process has exited: merge their rings into the trace
+    if (trace_path) {
+        char trace_msg[PATH_MAX + 64];
+        snprintf(trace_msg, sizeof(trace_msg), trace_merge(getenv(TRACE_ENV), trace_path) == -1 ?
+            "Failed to write the trace %s." : "Trace written to %s.", trace_path);
+        log_write(trace_msg);
+    }
+    // * Drain what the watchdog left in the rings; the rings of the processes that crashed are kept for a post-mortem
+    log_close();
+    if (log_rings) {
+        log_collect(log_dir, logfile_fd);
+        if (log_remove(log_dir) > 0) {
+            log_printf("Rings of the processes that did not end normally kept in %s (./DroneGame -D %s).", log_dir,
+                log_dir);
+        }
+    }
+    close(logfile_fd);
 
     return 0;
 }
 
-void write_log(FILE *logfile, pid_t pid, const char *message) {
-    const time_t now = time(NULL);
-    const struct tm *t = localtime(&now);
-    fprintf(logfile, "[%02d:%02d:%02d] PID: %d - %s\n",
-            t->tm_hour, t->tm_min, t->tm_sec, pid, message);
-    fflush(logfile);
-}
-
+#ifndef DRONE_THREADS
 int create_pipes(int pipes[NUM_CHILD_PIPES][2]) {
     /*
     * Function to create NUM_PIPES pipes.
@@ -137,7 +377,7 @@ int create_pipes(int pipes[NUM_CHILD_PIPES][2]) {
     * @return 0 on success, -1 on failure.
     */
     for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-        if (pipe(pipes[i]) == -1) {
+        if (pipe2(pipes[i], O_CLOEXEC) == -1) {
             perror("pipe");
             // * Close any previously opened pipes before exiting
             for (int j = 0; j < i; j++) {
@@ -151,209 +391,414 @@ int create_pipes(int pipes[NUM_CHILD_PIPES][2]) {
 }
 
 int create_processes(int pipes_out[NUM_CHILD_PIPES][2], int pipes_in[NUM_CHILD_PIPES][2],
-    pid_t pids[NUM_CHILD_PROCESSES-2], const int logfile_fd) {
+    pid_t pids[NUM_CHILD_PROCESSES-2], pid_t *blackboard_pid, const int logfile_fd) {
     /*
-     * Function to create child and blackboard processes.
-     * @param pipes An array containing the file descriptors of the pipes.
+     * Function to spawn the child and blackboard processes, none waiting for another to initialize.
+     * @param pipes_out, pipes_in Pipes towards and from the blackboard.
      * @param pids An array to store the PIDs of the child processes.
+     * @param blackboard_pid Filled with the PID of the blackboard.
      * @return 0 on success, -1 on failure.
      */
-    // * Array of executable paths corresponding to each child process
-    const char *child_executables[NUM_CHILD_PROCESSES-2] = {
-        "./keyboard_manager",
-        "./obstacles",
-        "./targets_generator",
-        "./drone_dynamics",
-    };
     /*
      * Create 5 processes:
-     * - 0: Keyboard input manager (write to Blackboard -> 1 pipe)
+     * - 0: Keyboard input manager (write to Blackboard -> 1 pipe), or the autopilot (read & write -> 2 pipes)
      * - 1: Obstacle generator (read & write -> 2 pipes)
      * - 2: Target generators (read & write -> 2 pipes)
      * - 3: Drone dynamics process (read & write -> 2 pipes)
+     * - the blackboard
+     * The first map is on the critical path to the first frame: the obstacles generator is spawned first, then the
+     * blackboard, which asks for the map as soon as it starts and initializes while it is generated.
     */
+    static const int order[NUM_CHILD_PROCESSES-2] = {1, 2, 3, 0};
     for (int i = 0; i < NUM_CHILD_PROCESSES-2; i++) {
-        pids[i] = fork();
-        if (pids[i] < 0) {
-            perror("fork");
-            // * Cleanup: kill any previously created children
-            for (int k = 0; k < i; k++) {
-                kill(pids[k], SIGTERM);
-            }
-            return -1;
+        pids[i] = -1;
+    }
+    *blackboard_pid = -1;
+    for (int k = 0; k < NUM_CHILD_PROCESSES-2; k++) {
+        const int i = order[k];
+        pids[i] = create_child_process(i, pipes_out, pipes_in, logfile_fd);
+        if (pids[i] != -1 && k == 0) {
+            *blackboard_pid = create_blackboard_process(pipes_out, pipes_in, logfile_fd);
         }
-
-        if (pids[i] == 0) {
-            // * Prepare the logfile file descriptor to be passet with exec
-            char logfile_fd_str[10];
-            snprintf(logfile_fd_str, sizeof(logfile_fd_str), "%d", logfile_fd);
-            // * If this is child #0 (keyboard_manager), it's write-only. So we close the read end of pipe[i], keep the write end open.
-            if (i == 0) {
-                // * Close all not needed pipes
-                for (int j = 0; j < NUM_CHILD_PIPES; j++) {
-                    if (j != i) {
-                        close(pipes_out[j][0]);
-                        close(pipes_out[j][1]);
-                        close(pipes_in[j][0]);
-                        close(pipes_in[j][1]);
-                    }
-                }
-                close(pipes_out[i][0]);
-                close(pipes_in[i][0]);
-                close(pipes_in[i][1]);
-
-                char write_pipe_str[10];
-                snprintf(write_pipe_str, sizeof(write_pipe_str), "%d", pipes_out[i][1]);
-                execl(child_executables[i], child_executables[i], write_pipe_str, logfile_fd_str, NULL);
-            } else {
-                // * Close all not needed pipes
-                for (int j = 0; j < NUM_CHILD_PIPES; j++) {
-                    if (j != i) {
-                        close(pipes_in[j][0]);
-                        close(pipes_in[j][1]);
-                        close(pipes_out[j][0]);
-                        close(pipes_out[j][1]);
-                    }
+        if (pids[i] == -1 || *blackboard_pid == -1) {
+            // * Cleanup: kill any previously created process
+            for (int j = 0; j < NUM_CHILD_PROCESSES-2; j++) {
+                if (pids[j] > 0) {
+                    kill(pids[j], SIGTERM);
                 }
-                close(pipes_in[i][1]);
-                close(pipes_out[i][0]);
-
-                char read_pipe_str[10], write_pipe_str[10];
-                snprintf(read_pipe_str, sizeof(read_pipe_str), "%d", pipes_in[i][0]);
-                snprintf(write_pipe_str, sizeof(write_pipe_str), "%d", pipes_out[i][1]);
-                execl(child_executables[i], child_executables[i], read_pipe_str, write_pipe_str,
-                    logfile_fd_str, NULL);
             }
-
-            // * If execl returns, an error occurred
-            perror("execl");
-            exit(EXIT_FAILURE);
+            if (*blackboard_pid > 0) {
+                kill(*blackboard_pid, SIGTERM);
+            }
+            return -1;
         }
     }
 
     return 0;
 }
 
-pid_t create_blackboard_process(int pipes_in[NUM_CHILD_PIPES][2], int pipes_out[NUM_CHILD_PIPES][2], int logfile_fd) {
+pid_t spawn_process(char *const args[], const int *fds, const int count) {
     /*
-     * Function to create the blackboard process.
-     * @param pipes Array containing the file descriptors of the pipes.
-     * @param watchdog_pid PID of the watchdog process.
-     * @return PID of the blackboard in case of success, -1 in case of failure.
-    */
-    const pid_t blackboard_pid = fork();
-    if (blackboard_pid < 0) {
-        perror("fork blackboard");
+     * Spawn an executable with posix_spawn (no copy of main, unlike fork).
+     * @param args Arguments, args[0] the path of the executable, NULL-terminated.
+     * @param fds Ends of the pipes the process uses: every other end is close-on-exec and is not inherited.
+     * @return PID of the process, -1 on failure.
+     */
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        perror("posix_spawn_file_actions_init");
         return -1;
     }
-    if (blackboard_pid == 0) {
-        // * Close all not needed pipes
-        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-            close(pipes_in[i][1]);
-            close(pipes_out[i][0]);
-        }
-        // * For the keyboard is required a mono directiona communication
-        close(pipes_out[0][0]);
+    // * A dup2 of a descriptor onto itself clears its close-on-exec flag in the process
+    for (int i = 0; i < count; i++) {
+        posix_spawn_file_actions_adddup2(&actions, fds[i], fds[i]);
+    }
+    pid_t pid;
+    const int error = posix_spawn(&pid, args[0], &actions, NULL, args, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+        errno = error;
+        perror(args[0]);
+        return -1;
+    }
+    return pid;
+}
 
-        /*
-         * Prepare arguments for the blackboard executable
-         * Pass all read pipe descriptors and the watchdog PID
-         * args[0] = "./blackboard"
-         * args[1..NUM_CHILD_PIPES] = read_fds
-         * args[NUM_CHILD_PIPES + 1..2*NUM_CHILD_PIPES - 1] = write_fds (excluding keyboard_manager)
-         * args[2*NUM_CHILD_PIPES] = logfile file descriptor
-        */
-        char logfile_fd_str[10];
-        snprintf(logfile_fd_str, sizeof(logfile_fd_str), "%d", logfile_fd);
+pid_t create_child_process(const int i, int pipes_out[NUM_CHILD_PIPES][2], int pipes_in[NUM_CHILD_PIPES][2],
+    const int logfile_fd) {
+    /*
+     * Function to spawn one child process on the pipes of its slot (also used by the supervisor to restart it).
+     * @param i Slot of the child, see create_processes.
+     * @return PID of the child in case of success, -1 in case of failure.
+     */
+    // * Array of executable paths corresponding to each child process
+    char *child_executables[NUM_CHILD_PROCESSES-2] = {
+        autopilot ? "./autopilot" : "./keyboard_manager",
+        "./obstacles",
+        "./targets_generator",
+        "./drone_dynamics",
+    };
+    // * Prepare the logfile file descriptor and the map size to be passed to the executable
+    char logfile_fd_str[10];
+    snprintf(logfile_fd_str, sizeof(logfile_fd_str), "%d", logfile_fd);
+    char height_str[12], width_str[12];
+    snprintf(height_str, sizeof(height_str), "%d", map_height);
+    snprintf(width_str, sizeof(width_str), "%d", map_width);
+    char read_pipe_str[10], write_pipe_str[10];
+    snprintf(read_pipe_str, sizeof(read_pipe_str), "%d", pipes_in[i][0]);
+    snprintf(write_pipe_str, sizeof(write_pipe_str), "%d", pipes_out[i][1]);
+    // * If this is child #0 (keyboard_manager), it's write-only: it only gets the write end of its pipe.
+    // * The autopilot in its place reads the world like the other children.
+    if (i == 0 && !autopilot) {
+        char *args[] = {child_executables[i], write_pipe_str, logfile_fd_str, NULL};
+        const int fds[] = {pipes_out[i][1]};
+        return spawn_process(args, fds, 1);
+    }
+    const int fds[] = {pipes_in[i][0], pipes_out[i][1]};
+    // * The obstacles also get the density and the spacing of their placement
+    if (i == 1) {
+        char density_str[32], spacing_str[12];
+        snprintf(density_str, sizeof(density_str), "%.17g", obstacle_density);
+        snprintf(spacing_str, sizeof(spacing_str), "%d", obstacle_spacing);
+        char *args[] = {child_executables[i], read_pipe_str, write_pipe_str, height_str, width_str, density_str,
+            spacing_str, logfile_fd_str, NULL};
+        return spawn_process(args, fds, 2);
+    }
+    char *args[] = {child_executables[i], read_pipe_str, write_pipe_str, height_str, width_str, logfile_fd_str, NULL};
+    return spawn_process(args, fds, 2);
+}
 
-        // * Allocate memory for arguments
-        const int total_args = 2 * NUM_CHILD_PIPES;
-        char **args = malloc(total_args * sizeof(char *));
-        if (!args) {
-            perror("malloc");
-            exit(EXIT_FAILURE);
+pid_t create_blackboard_process(int pipes_in[NUM_CHILD_PIPES][2], int pipes_out[NUM_CHILD_PIPES][2], int logfile_fd) {
+    /*
+     * Function to spawn the blackboard process.
+     * @param pipes_in, pipes_out Pipes towards and from the blackboard.
+     * @return PID of the blackboard in case of success, -1 in case of failure.
+    */
+    /*
+     * Prepare arguments for the blackboard executable
+     * args[0] = "./blackboard"
+     * args[1..NUM_CHILD_PIPES] = read_fds
+     * args[NUM_CHILD_PIPES + 1..2*NUM_CHILD_PIPES - 1] = write_fds (excluding keyboard_manager)
+     * args[2*NUM_CHILD_PIPES], args[2*NUM_CHILD_PIPES + 1] = map height and width
+     * args[2*NUM_CHILD_PIPES + 2], args[2*NUM_CHILD_PIPES + 3] = seed and chunked flag
+     * args[2*NUM_CHILD_PIPES + 4] = map file to load, "-" for none
+     * args[2*NUM_CHILD_PIPES + 5] = write file descriptor towards the autopilot, -1 for none
+     * args[2*NUM_CHILD_PIPES + 6] = logfile file descriptor
+     * The socket of the generators restarted alone is given in its environment (supervisor mode only).
+    */
+    char *args[2 * NUM_CHILD_PIPES + 8];
+    char fd_str[2 * NUM_CHILD_PIPES - 1][12];
+    int fds[2 * NUM_CHILD_PIPES + 1];
+    int arg_index = 0, num_fds = 0;
+    args[arg_index++] = "./blackboard";
+    // * Add all read_fds
+    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+        fds[num_fds] = pipes_in[i][0];
+        snprintf(fd_str[num_fds], sizeof(fd_str[num_fds]), "%d", fds[num_fds]);
+        args[arg_index++] = fd_str[num_fds++];
+    }
+    // * Add all write_fds (excluding keyboard_manager)
+    for (int i = 1; i < NUM_CHILD_PIPES; i++) {
+        fds[num_fds] = pipes_out[i][1];
+        snprintf(fd_str[num_fds], sizeof(fd_str[num_fds]), "%d", fds[num_fds]);
+        args[arg_index++] = fd_str[num_fds++];
+    }
+    // * For the keyboard is required a mono directiona communication, the autopilot also reads the world
+    char autopilot_str[12];
+    snprintf(autopilot_str, sizeof(autopilot_str), "%d", autopilot ? pipes_out[0][1] : -1);
+    if (autopilot) {
+        fds[num_fds++] = pipes_out[0][1];
+    }
+    char logfile_fd_str[10];
+    snprintf(logfile_fd_str, sizeof(logfile_fd_str), "%d", logfile_fd);
+    char height_str[12], width_str[12];
+    snprintf(height_str, sizeof(height_str), "%d", map_height);
+    snprintf(width_str, sizeof(width_str), "%d", map_width);
+    char seed_str[24], chunked_str[4];
+    snprintf(seed_str, sizeof(seed_str), "%llu", (unsigned long long)seed);
+    snprintf(chunked_str, sizeof(chunked_str), "%d", chunked);
+    // * Add the map size, the world parameters and the logfile
+    args[arg_index++] = height_str;
+    args[arg_index++] = width_str;
+    args[arg_index++] = seed_str;
+    args[arg_index++] = chunked_str;
+    args[arg_index++] = (char *)(map_path ? map_path : "-");
+    args[arg_index++] = autopilot_str;
+    args[arg_index++] = logfile_fd_str;
+    args[arg_index] = NULL; // * NULL terminate the argument list
+    char generator_fd_str[12];
+    snprintf(generator_fd_str, sizeof(generator_fd_str), "%d", generator_link[1]);
+    if (generator_link[1] != -1) {
+        if (setenv(SUPERVISOR_GENERATORS_ENV, generator_fd_str, 1) == -1) {
+            perror("generator link");
+            return -1;
         }
+        fds[num_fds++] = generator_link[1];
+    }
+    const pid_t blackboard_pid = spawn_process(args, fds, num_fds);
+    unsetenv(SUPERVISOR_GENERATORS_ENV);
+    return blackboard_pid;
+}
 
-        args[0] = "./blackboard";
+pid_t create_watchdog_process(pid_t pids[NUM_CHILD_PROCESSES-2], pid_t blackboard_pid, const int logfile_fd,
+    const int supervisor_fd) {
+    /*
+     * Function to spawn the watchdog process.
+     * @param supervisor_fd End of the link on which the supervisor sends the restarted components, -1 for none.
+     * @return PID of the watchdog in case of success, -1 in case of failure.
+     */
+    char child_pid_str[NUM_CHILD_PROCESSES-2][12];
+    for (int i = 0; i < NUM_CHILD_PROCESSES-2; i++) {
+        snprintf(child_pid_str[i], sizeof(child_pid_str[i]), "%d", pids[i]);
+    }
+    char blackboard_pid_str[12];
+    snprintf(blackboard_pid_str, sizeof(blackboard_pid_str), "%d", blackboard_pid);
+    char logfile_fd_str[10];
+    snprintf(logfile_fd_str, sizeof(logfile_fd_str), "%d", logfile_fd);
+    // * The link is given in the environment of the watchdog only
+    char supervisor_fd_str[12];
+    snprintf(supervisor_fd_str, sizeof(supervisor_fd_str), "%d", supervisor_fd);
+    if (supervisor_fd != -1 && setenv(SUPERVISOR_ENV, supervisor_fd_str, 1) == -1) {
+        perror("supervisor link");
+        return -1;
+    }
+    // * Insert the values in the args
+    const int num_args = 1 + (NUM_CHILD_PROCESSES-2) + 1 + 1;
+    char *args[num_args + 1];
+    int arg_index = 0;
+    args[arg_index++] = "./watchdog";
+    for (int i = 0; i < NUM_CHILD_PROCESSES-2; i++) {
+        args[arg_index++] = child_pid_str[i];
+    }
+    args[arg_index++] = blackboard_pid_str;
+    args[arg_index++] = logfile_fd_str;
+    args[arg_index] = NULL;
+    const pid_t watchdog_pid = spawn_process(args, &supervisor_fd, supervisor_fd != -1);
+    unsetenv(SUPERVISOR_ENV);
+    return watchdog_pid;
+}
 
-        // * Add all read_fds
-        int arg_index = 1;
-        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-            char *read_pipe_str = malloc(10);
-            if (!read_pipe_str) {
-                perror("malloc");
-                exit(EXIT_FAILURE);
+void close_pipes(int pipes_to[NUM_CHILD_PIPES][2], int pipes_from[NUM_CHILD_PIPES][2], const int keep) {
+    /*
+     * Close the ends of the pipes held by main, and mark them closed (-1).
+     * @param keep Keep the ends of the components the supervisor restarts alone: both ends of the keyboard pipe
+     *     (without the autopilot) and the ends of the dynamics (close-on-exec, as every end).
+     */
+    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+        int *ends[4] = {&pipes_to[i][0], &pipes_to[i][1], &pipes_from[i][0], &pipes_from[i][1]};
+        for (int e = 0; e < 4; e++) {
+            const int kept = keep && ((i == 0 && !autopilot && e < 2) || (i == 3 && (e == 1 || e == 2)));
+            if (*ends[e] == -1) {
+                continue;
             }
-            snprintf(read_pipe_str, 10, "%d", pipes_in[i][0]);
-            args[arg_index++] = read_pipe_str;
-        }
-
-        // * Add all write_fds (excluding keyboard_manager)
-        for (int i = 1; i < NUM_CHILD_PIPES; i++) {
-            char *write_pipe_str = malloc(10);
-            if (!write_pipe_str) {
-                perror("malloc");
-                exit(EXIT_FAILURE);
+            if (kept) {
+                continue;
             }
-            snprintf(write_pipe_str, 10, "%d", pipes_out[i][1]);
-            args[arg_index++] = write_pipe_str;
-        }
-        // * Add watchdog_pid
-        args[arg_index++] = logfile_fd_str;
-        args[arg_index] = NULL; // * NULL terminate the argument list
-        // * Execute the blackboard executable with the necessary arguments
-        execvp(args[0], args);
-
-        // * If execvp returns, an error occurred
-        perror("execvp blackboard");
-
-        // * Free allocated memory
-        for (int i = 1; i < arg_index; i++) {
-            free(args[i]);
+            close(*ends[e]);
+            *ends[e] = -1;
         }
-        free(args);
-        exit(EXIT_FAILURE);
     }
-
-    return blackboard_pid;
 }
 
-pid_t create_watchdog_process(pid_t pids[NUM_CHILD_PROCESSES-2], pid_t blackboard_pid, const int logfile_fd) {
+int restart_component(const int component, pid_t pids[NUM_CHILD_PROCESSES-2], pid_t *blackboard_pid,
+    int pipes_to[NUM_CHILD_PIPES][2], int pipes_from[NUM_CHILD_PIPES][2], const int logfile_fd,
+    const int supervisor_fd) {
     /*
-     * Function to create the watchdog process.
-     * @return PID of the watchdog in case of success, -1 in case of failure.
+     * Restart a component that failed (supervisor mode), and tell the watchdog.
+     * - The keyboard manager and the dynamics are restarted alone, on the ends of their pipes kept by main.
+     * - A generator is restarted alone on new pipes, whose ends go to the blackboard (send_generator_ends).
+     * - The blackboard and the autopilot are restarted together, with the generators and the dynamics, on new
+     *   pipes: the blackboard resumes from its last snapshot.
+     * @param component Slot of the component that exited (already reaped), NUM_CHILD_PROCESSES-2 for the blackboard.
+     * @return 0 on success, -1 if the component fails too often or cannot be restarted: the game ends.
      */
-    const pid_t watchdog_pid = fork();
-    if (watchdog_pid < 0) {
-        perror("fork watchdog");
+    static const char *names[NUM_CHILD_PROCESSES-1] = {"input", "obstacles", "targets", "dynamics", "blackboard"};
+    static int restarts[NUM_CHILD_PROCESSES-1];
+    static time_t window_start[NUM_CHILD_PROCESSES-1];
+    const int blackboard = NUM_CHILD_PROCESSES-2;
+    const pid_t failed = component == blackboard ? *blackboard_pid : pids[component];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const time_t now = time(NULL);
+    if (now - window_start[component] > SUPERVISOR_WINDOW) {
+        window_start[component] = now;
+        restarts[component] = 0;
+    }
+    char message[160];
+    if (++restarts[component] > SUPERVISOR_MAX_RESTARTS) {
+        snprintf(message, sizeof(message), "Supervisor: %s (PID %d) failed %d times in %d s, ending the game.",
+            names[component], failed, SUPERVISOR_MAX_RESTARTS, SUPERVISOR_WINDOW);
+        log_write(message);
+        // * The other components are stopped by the closure of main
+        if (component == blackboard) {
+            *blackboard_pid = -1;
+        } else {
+            pids[component] = -1;
+            if (*blackboard_pid > 0) {
+                kill(*blackboard_pid, SIGTERM);
+                waitpid(*blackboard_pid, NULL, 0);
+            }
+        }
         return -1;
     }
-    if (watchdog_pid == 0) {
-        char child_pid_str[NUM_CHILD_PROCESSES-2][12];
+    supervisor_restart restarted[NUM_CHILD_PROCESSES-1];
+    int count = 0;
+    if (component == 3 || (component == 0 && !autopilot)) {
+        // * The component knows it was restarted alone (the dynamics asks for its frame again)
+        setenv(SUPERVISOR_RESTART_ENV, "1", 1);
+        pids[component] = create_child_process(component, pipes_to, pipes_from, logfile_fd);
+        unsetenv(SUPERVISOR_RESTART_ENV);
+        if (pids[component] == -1) {
+            return -1;
+        }
+        restarted[count++] = (supervisor_restart){component, pids[component]};
+    } else if (component == 1 || component == 2) {
+        // * New pipes for the generator: the old ones may hold half a message, and the blackboard sees their end
+        if (pipe2(pipes_to[component], O_CLOEXEC) == -1 || pipe2(pipes_from[component], O_CLOEXEC) == -1) {
+            perror("pipe");
+            return -1;
+        }
+        pids[component] = create_child_process(component, pipes_to, pipes_from, logfile_fd);
+        if (pids[component] == -1) {
+            return -1;
+        }
+        if (send_generator_ends(component, pids[component], pipes_to[component][0], pipes_from[component][1]) == -1) {
+            return -1;
+        }
+        close_pipes(pipes_to, pipes_from, 1);
+        restarted[count++] = (supervisor_restart){component, pids[component]};
+    } else {
+        // * Stop what is left of the world: its pipes may hold half a message
+        const int restarted_alone = autopilot ? -1 : 0;
         for (int i = 0; i < NUM_CHILD_PROCESSES-2; i++) {
-            snprintf(child_pid_str[i], sizeof(child_pid_str[i]), "%d", pids[i]);
-        }
-        char blackboard_pid_str[12];
-        snprintf(blackboard_pid_str, sizeof(blackboard_pid_str), "%d", blackboard_pid);
-        char logfile_fd_str[10];
-        snprintf(logfile_fd_str, sizeof(logfile_fd_str), "%d", logfile_fd);
-        // * Insert the values in the args
-        const int num_args = 1 + (NUM_CHILD_PROCESSES-2) + 1 + 1;
-        char *args[num_args + 1];
-        int arg_index = 0;
-        args[arg_index++] = "./watchdog";
+            if (i != component && i != restarted_alone && pids[i] > 0) {
+                kill(pids[i], SIGKILL);
+                waitpid(pids[i], NULL, 0);
+            }
+        }
+        if (component != blackboard) {
+            kill(*blackboard_pid, SIGKILL);
+            waitpid(*blackboard_pid, NULL, 0);
+        }
+        // * New pipes for the world: the keyboard pipe stays, with the keys typed meanwhile
+        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+            if (i == restarted_alone) {
+                continue;
+            }
+            for (int e = 0; e < 2; e++) {
+                if (pipes_to[i][e] != -1) {
+                    close(pipes_to[i][e]);
+                }
+                if (pipes_from[i][e] != -1) {
+                    close(pipes_from[i][e]);
+                }
+            }
+            if (pipe2(pipes_to[i], O_CLOEXEC) == -1 || pipe2(pipes_from[i], O_CLOEXEC) == -1) {
+                perror("pipe");
+                return -1;
+            }
+        }
         for (int i = 0; i < NUM_CHILD_PROCESSES-2; i++) {
-            args[arg_index++] = child_pid_str[i];
-        }
-        args[arg_index++] = blackboard_pid_str;
-        args[arg_index++] = logfile_fd_str;
-        args[arg_index] = NULL;
-        // * Execute the watchdog executable
-        execvp(args[0], args);
-        // * If execvp returns, an error occurred
-        perror("execvp");
-        exit(EXIT_FAILURE);
+            if (i == restarted_alone) {
+                continue;
+            }
+            pids[i] = create_child_process(i, pipes_to, pipes_from, logfile_fd);
+            if (pids[i] == -1) {
+                return -1;
+            }
+            restarted[count++] = (supervisor_restart){i, pids[i]};
+        }
+        // * A new socket for the new blackboard: the ends of a generator the old one did not take are stale
+        close(generator_link[0]);
+        close(generator_link[1]);
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, generator_link) == -1) {
+            perror("generator link");
+            return -1;
+        }
+        *blackboard_pid = create_blackboard_process(pipes_to, pipes_from, logfile_fd);
+        if (*blackboard_pid == -1) {
+            return -1;
+        }
+        restarted[count++] = (supervisor_restart){blackboard, *blackboard_pid};
+        close_pipes(pipes_to, pipes_from, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    snprintf(message, sizeof(message), "Supervisor: %s (PID %d) failed, %s restarted in %.1f ms.",
+        names[component], failed, count == 1 ? "it was" : "the world was",
+        (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6);
+    log_write(message);
+    // * The watchdog follows the new PIDs (a watchdog gone does not stop the game)
+    for (int i = 0; i < count; i++) {
+        send(supervisor_fd, &restarted[i], sizeof(restarted[i]), MSG_NOSIGNAL);
     }
+    return 0;
+}
 
-    return watchdog_pid;
-}
\ No newline at end of file
+int send_generator_ends(const int component, const pid_t pid, const int read_fd, const int write_fd) {
+    /*
+     * Hand the blackboard the ends of the new pipes of a generator restarted alone (SCM_RIGHTS on the generator
+     * socket): the reading end of its replies and the writing end of its requests, which main then closes.
+     * @return 0 on success, -1 on failure.
+     */
+    supervisor_restart restarted = {component, pid};
+    struct iovec payload = {&restarted, sizeof(restarted)};
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr message = {.msg_iov = &payload, .msg_iovlen = 1, .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf)};
+    struct cmsghdr *rights = CMSG_FIRSTHDR(&message);
+    rights->cmsg_level = SOL_SOCKET;
+    rights->cmsg_type = SCM_RIGHTS;
+    rights->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    const int ends[2] = {read_fd, write_fd};
+    memcpy(CMSG_DATA(rights), ends, sizeof(ends));
+    if (sendmsg(generator_link[0], &message, MSG_NOSIGNAL) == -1) {
+        perror("generator link");
+        return -1;
+    }
+    return 0;
+}
+#endif
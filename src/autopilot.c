@@ -0,0 +1,268 @@
+//
+// Created by Gian Marco Balia
+//
+// src/autopilot.c
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include "macros.h"
+#include "occupancy.h"
+#include "channel.h"
+#include "components.h"
+#include "autopilot.h"
+#include "path_planner.h"
+#include "latency.h"
+#include "trace.h"
+#include "heartbeat.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
+
+#define CHANGES_BATCH 256 // * Changes read from the channel at once
+
+static volatile sig_atomic_t keep_running = 1;
+// * Keys written so far: the sequence number of a key is its trace id (the blackboard counts the same)
+static uint32_t keys_written = 0;
+
+static int apply_changes(channel *in, int count, path_planner *planner);
+static char steer(int force[2], int dx, int dy);
+static void give_up(channel *in, channel *out, const char *reason);
+
+#ifndef DRONE_THREADS
+static void signal_close(int signum);
+static void signal_triggered(int signum);
+
+int main(int argc, char *argv[]) {
+    /*
+     * Autopilot process: replaces the keyboard manager (./DroneGame -A) and flies the drone to every target.
+     * @param argv[1]: Read file descriptors
+     * @param argv[2]: Write file descriptors
+     * @param argv[3], argv[4]: Map height and width
+     */
+    // * Signal handler closure
+    struct sigaction sa0;
+    memset(&sa0, 0, sizeof(sa0));
+    sa0.sa_handler = signal_close;
+    sa0.sa_flags = SA_RESTART;
+    if (sigaction(SIGTERM, &sa0, NULL) == -1) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
+    // * Signal handler watchdog
+    struct sigaction sa1;
+    memset(&sa1, 0, sizeof(sa1));
+    sa1.sa_handler = signal_triggered;
+    sa1.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &sa1, NULL) == -1) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
+
+    if (argc != 6) {
+        fprintf(stderr, "Usage: %s <read_fd> <write_fd> <height> <width> <logfile_fd>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int read_fd = atoi(argv[1]);
+    if (read_fd <= 0) {
+        fprintf(stderr, "Invalid read file descriptor: %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    int write_fd = atoi(argv[2]);
+    if (write_fd <= 0) {
+        fprintf(stderr, "Invalid write file descriptor: %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    // * Parse logfile file descriptors
+    int logfile_fd = atoi(argv[argc - 1]);
+    channel *in = channel_from_fd(read_fd), *out = channel_from_fd(write_fd);
+    if (!in || !out) {
+        perror("channel");
+        return EXIT_FAILURE;
+    }
+    const int status = autopilot_run(in, out, logfile_fd);
+    channel_close(in);
+    channel_close(out);
+    return status;
+}
+
+static void signal_close(int signum) {
+    keep_running = 0;
+}
+
+static void signal_triggered(int signum) {
+    log_write("Autopilot is active.");
+}
+#endif
+
+int autopilot_run(channel *in, channel *out, const int logfile_fd) {
+    /*
+     * Loop of the autopilot: plan on the map sent by the blackboard and answer every frame with the keys.
+     * @param in, out Channels from and to the blackboard, closed by the caller.
+     * @return EXIT_SUCCESS when it is stopped or the blackboard is gone, EXIT_FAILURE on failure.
+     */
+    if (log_open("autopilot", logfile_fd) == -1) {
+        perror("log");
+    }
+    if (trace_open("autopilot") == -1) {
+        perror("trace");
+    }
+    if (heartbeat_open() == -1) {
+        perror("heartbeat");
+    }
+    realtime_enter("input");
+    startup_phase("autopilot", "ready");
+
+    // * Start the game from the menu
+    char key = 's';
+    if (channel_write(out, &key, sizeof(key)) == -1) {
+        perror("write");
+        return EXIT_FAILURE;
+    }
+    keys_written++;
+    // * Copy of the map kept up to date by the changes of every frame, and the plan on it
+    occupancy_map world;
+    memset(&world, 0, sizeof(world));
+    path_planner planner;
+    memset(&planner, 0, sizeof(planner));
+    int planning = 0;
+    // * Force of the drone as set by the keys sent so far
+    int force[2] = {0, 0};
+    autopilot_header header;
+    while (keep_running) {
+        heartbeat_wait();
+        if (channel_read(in, &header, sizeof(header)) == -1) {
+            break;
+        }
+        heartbeat_beat();
+        if (header.magic != AUTOPILOT_MAGIC || header.count < 0 ||
+            (header.type != AUTOPILOT_MAP && header.type != AUTOPILOT_FRAME)) {
+            errno = EPROTO;
+            perror("autopilot read");
+            return EXIT_FAILURE;
+        }
+        const uint64_t received = latency_now();
+        if (header.type == AUTOPILOT_MAP) {
+            if (occupancy_read(in, &world) == -1) {
+                perror("autopilot read");
+                return EXIT_FAILURE;
+            }
+            planner_free(&planner);
+            planning = planner_init(&planner, &world, header.x, header.y) == 0;
+            force[0] = header.force_x;
+            force[1] = header.force_y;
+            if (!planning) {
+                give_up(in, out, "Autopilot: not enough memory to plan on this map.");
+                break;
+            }
+            continue;
+        }
+        if (!planning) {
+            continue;
+        }
+        planner_move_start(&planner, header.x, header.y);
+        if (apply_changes(in, header.count, &planner) == -1) {
+            give_up(in, out, "Autopilot: failed to update the plan.");
+            break;
+        }
+        // * Catch up with the frames already sent before planning, the keys answer the latest one
+        if (channel_pending(in) > 0) {
+            continue;
+        }
+        int dx = 0, dy = 0;
+        const int step = planner_next_step(&planner, &dx, &dy);
+        if (step == -1) {
+            give_up(in, out, "Autopilot: failed to update the plan.");
+            break;
+        }
+        // * No target reachable: brake and wait for the world to change
+        key = step ? steer(force, dx, dy) : steer(force, 0, 0);
+        if (key != '\0') {
+            if (channel_write(out, &key, sizeof(key)) == -1) {
+                // * EPIPE: the blackboard is gone (in the threaded build, where no SIGPIPE ends the autopilot)
+                if (errno != EPIPE) {
+                    perror("write");
+                }
+                break;
+            }
+            // * First hop of the key: from the frame received to the key sent
+            trace_record("autopilot", ++keys_written, received, latency_now(), 's');
+        }
+    }
+    planner_free(&planner);
+    occupancy_free(&world);
+    trace_close();
+    heartbeat_close();
+    log_close();
+    return EXIT_SUCCESS;
+}
+
+static int apply_changes(channel *in, int count, path_planner *planner) {
+    /*
+     * Read the changed cells of a frame and apply them to the map and to the plan.
+     * @return 0 on success, -1 on failure.
+     */
+    const int width = planner->map->width;
+    autopilot_change changes[CHANGES_BATCH];
+    while (count > 0) {
+        const int n = count < CHANGES_BATCH ? count : CHANGES_BATCH;
+        if (channel_read(in, changes, n * sizeof(autopilot_change)) == -1) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (planner_set_cell(planner, changes[i].cell % width, changes[i].cell / width,
+                changes[i].state == AUTOPILOT_OBSTACLE, changes[i].state == AUTOPILOT_TARGET) == -1) {
+                return -1;
+            }
+        }
+        count -= n;
+    }
+    return 0;
+}
+
+static char steer(int force[2], const int dx, const int dy) {
+    /*
+     * Choose the key that brings the force of the drone one unit closer to the direction of the next step (one
+     * force unit moves the drone by about one cell per frame), and apply it to the force as the blackboard does.
+     * @return The key, '\0' if the force is already right.
+     */
+    static const char keys[3][3] = {{'w', 'e', 'r'}, {'s', '\0', 'f'}, {'x', 'c', 'v'}};
+    if (force[0] == dx && force[1] == dy) {
+        return '\0';
+    }
+    if (dx == 0 && dy == 0) {
+        force[0] = force[1] = 0;
+        return 'd';
+    }
+    const int sx = (dx > force[0]) - (dx < force[0]), sy = (dy > force[1]) - (dy < force[1]);
+    force[0] += sx;
+    force[1] += sy;
+    return keys[sy + 1][sx + 1];
+}
+
+static void give_up(channel *in, channel *out, const char *reason) {
+    /*
+     * Quit the game, and read the messages until the blackboard closes the channel so that it never writes to a
+     * closed channel.
+     */
+    log_write(reason);
+    const char key = 'q';
+    if (channel_write(out, &key, sizeof(key)) == -1) {
+        perror("write");
+        return;
+    }
+    for (;;) {
+        // * Ready with nothing pending: the end of the stream
+        const int ready = channel_wait(in, -1);
+        if ((ready == -1 && !keep_running) || (ready == 1 && channel_pending(in) <= 0)) {
+            return;
+        }
+        channel_drain(in);
+    }
+}
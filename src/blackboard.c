@@ -11,19 +11,161 @@
 #include <ncurses.h>
 #include <fcntl.h>
 #include <math.h>
+#include <errno.h>
+#include <spawn.h>
+#include <poll.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include "macros.h"
+#include "occupancy.h"
+#include "collision.h"
+#include "pipe_io.h"
+#include "channel.h"
+#include "components.h"
+#include "physics.h"
+#include "generator.h"
+#include "chunk_world.h"
+#include "timer_wheel.h"
+#include "rng.h"
+#include "map_file.h"
+#include "autopilot.h"
+#include "latency.h"
+#include "trace.h"
+#include "metrics.h"
+#include "heartbeat.h"
+#include "checkpoint.h"
+#include "supervisor.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
 
-FILE *logfile;
 
-int parser(int argc, char *argv[], int *read_fds, int *write_fds);
-void signal_triggered(int signum);
-int initialize_ncurses();
-void command_drone(int *drone_force, char c);
-pid_t launch_inspection_window();
-void remove_target_on_path(char grid[GAME_HEIGHT][GAME_WIDTH], int x0, int y0, int x1, int y1);
+// * Channels towards the generators, and the socket on which the supervisor hands over the ends of a generator it
+// * restarted alone (-1 without supervisor)
+typedef struct {
+    channel *obstacle_read, *obstacle_write;
+    channel *target_read, *target_write;
+    int link;
+} generator_pipes;
+
+extern char **environ;
+
+// * Timed world events scheduled on the timer wheel (payload a: collision entity id, b: generation of the id)
+enum {
+    EVENT_TARGET_EXPIRE = 1, // * The target disappears and a new one is respawned elsewhere
+    EVENT_OBSTACLE_SPAWN, // * A temporary obstacle appears (the event schedules the next one)
+    EVENT_OBSTACLE_EXPIRE, // * The temporary obstacle disappears
+};
+
+// * Autopilot in the keyboard slot (./DroneGame -A): the cells changed since the last message sent to it
+typedef struct {
+    channel *out; // * NULL without autopilot
+    autopilot_change *changes;
+    int count, capacity;
+    int resync; // * A change could not be recorded: the whole map is sent again
+} autopilot_link;
+
+static autopilot_link autopilot = {NULL, NULL, 0, 0, 0};
+
+// * Stages of a running frame, timed on the monotonic clock (the report is written on exit and on SIGUSR2)
+enum {
+    STAGE_DRAW, // * Map drawn before the wait
+    STAGE_WAIT, // * select on the keyboard (and the obstacle stream)
+    STAGE_SEND, // * Window of the map and drone state serialized to the dynamics
+    STAGE_PREDICT, // * Local prediction drawn while the dynamics computes
+    STAGE_DYNAMICS, // * Wait for the reply of the dynamics
+    STAGE_COLLECT, // * Targets collected and obstacles hit along the path
+    STAGE_EVENTS, // * Timed world events
+    STAGE_WORLD, // * Obstacle moves and tiles of the chunked view
+    STAGE_INSPECTOR, // * Status sent to the inspector
+    STAGE_TARGETS, // * Target count, respawn and score
+    STAGE_AUTOPILOT, // * Changes of the frame sent to the autopilot
+    STAGE_REFRESH, // * ncurses refresh at the end of the frame
+    STAGE_FRAME, // * Whole frame
+    STAGE_JITTER, // * Lateness of a wait that timed out: deviation of the start of the next frame (realtime.h)
+    NUM_STAGES
+};
+
+static latency_histogram stages[NUM_STAGES] = {
+    [STAGE_DRAW] = {"draw"}, [STAGE_WAIT] = {"wait"}, [STAGE_SEND] = {"send"}, [STAGE_PREDICT] = {"predict"},
+    [STAGE_DYNAMICS] = {"dynamics"}, [STAGE_COLLECT] = {"collect"}, [STAGE_EVENTS] = {"events"},
+    [STAGE_WORLD] = {"world"}, [STAGE_INSPECTOR] = {"inspector"}, [STAGE_TARGETS] = {"targets"},
+    [STAGE_AUTOPILOT] = {"autopilot"}, [STAGE_REFRESH] = {"refresh"}, [STAGE_FRAME] = {"frame"},
+    [STAGE_JITTER] = {"jitter"},
+};
+static volatile sig_atomic_t latency_dump = 0;
+// * Keys read from the keyboard pipe: the sequence number of the last one is its trace id
+static uint32_t keys_read = 0;
+
+// * Counters of the game published on the metrics endpoint of the watchdog (metrics.h), in the order of their slots
+enum {
+    METRIC_FRAMES, // * Running frames rendered
+    METRIC_FRAMES_MISSED, // * Running frames whose work (without the wait for a key) took longer than a period
+    METRIC_KEYS, // * Keys read from the keyboard pipe
+    METRIC_KEYS_DROPPED, // * Keys read that had no effect (in the menu or in pause)
+    METRIC_KEYS_PENDING, // * Keys waiting in the keyboard pipe
+    METRIC_SCORE,
+    METRIC_TARGETS, // * Targets left on the map (in chunked mode, in view)
+    METRIC_DYNAMICS_RESENDS, // * Frames sent again to a dynamics restarted by the supervisor
+    NUM_METRICS
+};
+// * Pipes of the blackboard, each with the slots of its traffic {bytes in, bytes out, messages in, messages out}
+enum { PIPE_KEYBOARD, PIPE_OBSTACLES, PIPE_TARGETS, PIPE_DYNAMICS, PIPE_AUTOPILOT, PIPE_INSPECTOR, NUM_PIPES };
+
+static metrics_page *metrics = NULL;
+static int pipe_slots[NUM_PIPES][4];
+// * Traffic towards the inspector, counted here because its FIFO is not a channel
+static uint64_t inspector_bytes = 0, inspector_messages = 0;
+
+static int initialize_ncurses();
+static void command_drone(int *drone_force, char c);
+static char wait_key(channel *keyboard, channel *wake, long timeout_us);
+static pid_t launch_inspection_window();
+static int inspector_send(int *fd, const char *msg, size_t length);
+static void draw_world(WINDOW *win, const occupancy_map *world, int height, int width);
+static void draw_drone(WINDOW *win, const occupancy_map *world, int height, int width, int x, int y, const char *glyph);
+static int collect_on_path(occupancy_map *world, collision_index *index, chunk_world *chunks, timer_wheel *timers,
+    int drone_pos[4], int x0, int y0);
+static int map_stage(const generator_pipes *pipes, const generator_request *request, int stage, occupancy_map *map);
+static int complete_map(const generator_pipes *pipes, const generator_request *request, int stage, occupancy_map *map);
+static int generate_map(const generator_pipes *pipes, int type, int tile_x, int tile_y, uint64_t seed, int round,
+    occupancy_map *map);
+static int load_map(const generator_pipes *pipes, const char *path, uint64_t seed, occupancy_map *map);
+static int respawn_targets(const generator_pipes *pipes, int count, occupancy_map *world, collision_index *index,
+    timer_wheel *timers, uint64_t now);
+static double monotonic_seconds(void);
+static int schedule_target(timer_wheel *timers, collision_index *index, int id, uint64_t now);
+static int run_events(timer_wheel *timers, uint64_t now, occupancy_map *world, collision_index *index, rng_state *rng,
+    const int drone_pos[4], int *count_obstacles, int *expired);
+static int load_view(const generator_pipes *pipes, uint64_t seed, int round, chunk_world *chunks, int drone_x,
+    int drone_y, occupancy_map *world, collision_index *index);
+static int track_obstacles(const collision_index *index, int **entities, int *count);
+static int obstacle_stream(const generator_pipes *pipes, int on, occupancy_map *world, collision_index *index,
+    const int *entities, int count, const int drone_pos[4]);
+static int apply_obstacle_moves(channel *in, int until_end, occupancy_map *world, collision_index *index,
+    const int *entities, int count, const int drone_pos[4]);
+static int generator_lost(const generator_pipes *pipes, uint64_t seed, int round, const occupancy_map *world,
+    const collision_index *index, int *entities, int count, int streaming);
+static int reconnect_generator(const generator_pipes *pipes);
+static int resync_generator(const generator_pipes *pipes, int generator, uint64_t seed, int round,
+    const occupancy_map *world, const collision_index *index, int *entities, int count, int streaming);
+static int by_key(const void *a, const void *b);
+static void autopilot_record(const occupancy_map *world, int x, int y, int state);
+static uint64_t stage_end(int stage, uint32_t key, uint64_t start);
+static void register_metrics(channel *const ends[NUM_PIPES][2]);
+static void publish_metrics(channel *const ends[NUM_PIPES][2], int score, int targets);
+static int autopilot_send(const occupancy_map *world, int type, const int drone_pos[4], const int drone_force[2]);
+static int dynamics_request(channel *out, const occupancy_map *window, const char *msg);
+static int dynamics_reply(channel *in, channel *out, const occupancy_map *window, const char *msg, uint32_t sequence,
+    int *x, int *y);
+
+#ifndef DRONE_THREADS
+static int parser(int argc, char *argv[], int *read_fds, int *write_fds, int *map_height, int *map_width,
+    uint64_t *seed, int *chunked, const char **map_path, int *autopilot_fd);
+static void signal_triggered(int signum);
+static void signal_latency(int signum);
 
 int main(const int argc, char *argv[]) {
     // * Define the signal action
@@ -35,28 +177,143 @@ int main(const int argc, char *argv[]) {
         perror("sigaction");
         exit(EXIT_FAILURE);
     }
+    // * Latency report on demand
+    struct sigaction sa_latency;
+    memset(&sa_latency, 0, sizeof(sa_latency));
+    sa_latency.sa_handler = signal_latency;
+    sa_latency.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR2, &sa_latency, NULL) == -1) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
+    // * A generator gone (restarted alone by the supervisor) is an EPIPE on its channel, not the end of the blackboard
+    struct sigaction sa_pipe;
+    memset(&sa_pipe, 0, sizeof(sa_pipe));
+    sa_pipe.sa_handler = SIG_IGN;
+    if (sigaction(SIGPIPE, &sa_pipe, NULL) == -1) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
     // * Check if the of argument correspond
-    if (argc != 2 * NUM_CHILD_PIPES + 1) {
-        fprintf(stderr, "Usage: %s <read_fd1> <read_fd2> ... <read_fdN> <write_fd1> ... <write_fdN-1> <logfile_fd>\n",
-                argv[0]);
+    if (argc != 2 * NUM_CHILD_PIPES + 7) {
+        fprintf(stderr, "Usage: %s <read_fd1> <read_fd2> ... <read_fdN> <write_fd1> ... <write_fdN-1> <height> <width> "
+                "<seed> <chunked> <map_file> <autopilot_fd> <logfile_fd>\n", argv[0]);
         return EXIT_FAILURE;
     }
     // * Parse arguments
     int read_fds[NUM_CHILD_PIPES];
     int write_fds[NUM_CHILD_PIPES - 1];
-    if (parser(argc, argv, read_fds, write_fds) == EXIT_FAILURE) {
+    int map_height, map_width, chunked;
+    uint64_t seed;
+    const char *map_path;
+    int autopilot_fd;
+    if (parser(argc, argv, read_fds, write_fds, &map_height, &map_width, &seed, &chunked, &map_path,
+        &autopilot_fd) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    // * Wrap the pipes in channels
+    channel *in[NUM_CHILD_PIPES], *out[NUM_CHILD_PIPES - 1];
+    int wrapped = 1;
+    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+        in[i] = channel_from_fd(read_fds[i]);
+        wrapped &= in[i] != NULL;
+    }
+    for (int i = 0; i < NUM_CHILD_PIPES - 1; i++) {
+        out[i] = channel_from_fd(write_fds[i]);
+        wrapped &= out[i] != NULL;
+    }
+    channel *autopilot_out = autopilot_fd != -1 ? channel_from_fd(autopilot_fd) : NULL;
+    if (!wrapped || (autopilot_fd != -1 && !autopilot_out)) {
+        perror("channel");
         return EXIT_FAILURE;
     }
-    // * Map the child pipes to more meaningful names
-    const int keyboard = read_fds[0];
-    const int obstacle_read = read_fds[1];
-    const int target_read = read_fds[2];
-    const int dynamic_read = read_fds[3];
-    // const int obstacle_write = write_fds[0];
-    const int target_write = write_fds[1];
-    const int dynamic_write = write_fds[2];
-    // * Make the named pipe to communicate with the inspector window
+    const int status = blackboard_run(in, out, autopilot_out, map_height, map_width, seed, chunked, map_path,
+        atoi(argv[argc - 1]));
+    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+        channel_close(in[i]);
+    }
+    for (int i = 0; i < NUM_CHILD_PIPES - 1; i++) {
+        channel_close(out[i]);
+    }
+    channel_close(autopilot_out);
+    return status;
+}
+#endif
+
+int blackboard_run(channel *const in[NUM_CHILD_PIPES], channel *const out[NUM_CHILD_PIPES - 1],
+    channel *autopilot_out, const int map_height, const int map_width, const uint64_t seed, const int chunked,
+    const char *map_path, const int logfile_fd) {
+    /*
+     * Loop of the blackboard: the game, from the menu to the end of the last round.
+     * @param in Channels from the children in the order of main (keyboard or autopilot, obstacles, targets,
+     * dynamics), closed by the caller as every channel.
+     * @param out Channels towards the obstacles, the targets and the dynamics.
+     * @param autopilot_out Channel towards the autopilot, NULL if the keyboard manager is used.
+     * @param map_height, map_width Map size (size of the whole world in chunked mode).
+     * @param seed Seed of the generators.
+     * @param chunked 1 if the world is generated tile by tile around the drone.
+     * @param map_path Map file to load for the first round, NULL to generate it.
+     * @return EXIT_SUCCESS at the end of the game, EXIT_FAILURE on failure.
+     */
+    if (log_open("blackboard", logfile_fd) == -1) {
+        perror("log");
+    }
+    if (trace_open("blackboard") == -1) {
+        perror("trace");
+    }
+    // * The game runs without metrics if the page cannot be created
+    metrics = metrics_open("blackboard");
+    if (!metrics) {
+        perror("metrics");
+    }
+    if (heartbeat_open() == -1) {
+        perror("heartbeat");
+    }
+    realtime_enter("blackboard");
+    startup_phase("blackboard", "started");
+    autopilot.out = autopilot_out;
+    // * Map the child channels to more meaningful names
+    channel *const keyboard = in[0];
+    const char *generator_link = getenv(SUPERVISOR_GENERATORS_ENV);
+    const generator_pipes generators = {in[1], out[0], in[2], out[1], generator_link ? atoi(generator_link) : -1};
+    channel *const dynamic_read = in[3];
+    channel *const dynamic_write = out[2];
+    // * Ends of every channel for the metrics, NULL for a direction it does not have (the keyboard and the inspector
+    // * are counted by the blackboard itself)
+    channel *const ends[NUM_PIPES][2] = {
+        [PIPE_KEYBOARD] = {keyboard, NULL}, [PIPE_OBSTACLES] = {generators.obstacle_read, generators.obstacle_write},
+        [PIPE_TARGETS] = {generators.target_read, generators.target_write},
+        [PIPE_DYNAMICS] = {dynamic_read, dynamic_write}, [PIPE_AUTOPILOT] = {NULL, autopilot.out},
+        [PIPE_INSPECTOR] = {NULL, NULL},
+    };
+    register_metrics(ends);
+    // * Snapshots of the round for the supervisor (./DroneGame -R), none without its directory
+    if (checkpoint_open() == -1) {
+        perror("checkpoint");
+    }
+    // * Restarted by the supervisor: resume the round of the last snapshot instead of showing the menu
+    checkpoint_state resume;
+    char resume_path[GEN_PATH_MAX];
+    int resuming = !chunked && checkpoint_restore(&resume, resume_path, sizeof(resume_path));
+    // * Game map: obstacle and target layers, and the window of it sent to the dynamics.
+    // * In chunked mode the map is the view of the tiles around the drone and its origin moves with it.
+    occupancy_map world, field_window;
+    memset(&world, 0, sizeof(world));
+    memset(&field_window, 0, sizeof(field_window));
+    // * The first map is asked right away: the generators build it while the blackboard initializes and the menu
+    // * waits for the start key (the next step of map_stage, 0 when none is pending)
+    const generator_request first_map = {GEN_MAP, 0, 0, 0, seed};
+    int prefetch = 0;
+    if (!chunked && !map_path && !resuming) {
+        prefetch = map_stage(&generators, &first_map, 0, &world);
+    }
+    // * Make the named pipe to communicate with the inspector window, and launch the window, which opens while
+    // * ncurses starts
     mkfifo(INSPECTOR_FIFO, 0666);
+    pid_t insp_pid = launch_inspection_window();
+    // * End of the FIFO, opened without waiting once the inspector reads it (-1 until then)
+    int insp_fd = -1;
+    startup_phase("blackboard", "inspector");
     // * Initialise window's game
     if (initialize_ncurses() == EXIT_FAILURE) {
         fprintf(stderr, "Error initializing ncurses.\n");
@@ -76,9 +333,9 @@ int main(const int argc, char *argv[]) {
     // * Refresh the screen and window initially
     refresh();
     wrefresh(win);
-    // * Size of the grid game
-    char grid[GAME_HEIGHT][GAME_WIDTH];
-    memset(grid, ' ', sizeof(grid));
+    startup_phase("blackboard", "ncurses");
+    chunk_world chunks;
+    memset(&chunks, 0, sizeof(chunks));
     // * Game status: 0=menu, 1=initialization, 2=running, -2=pause, -1=quit
     int status = 0;
     int drone_pos[4] = {0, 0, 0, 0};
@@ -87,13 +344,54 @@ int main(const int argc, char *argv[]) {
     int score = 500000000;
     int distance_traveled = 0;
     int count_obstacles = 0;
+    // * Waves of targets played so far, and round (map) of the game: a new round swaps in the next map
+    int wave = 1;
+    int round = 0;
+    // * Spatial index of obstacles and targets for the swept collision queries
+    collision_index index;
+    memset(&index, 0, sizeof(index));
     time_t start_time = time(NULL);
-    // * Launches a new terminal window
-    pid_t insp_pid = launch_inspection_window();
+    // * Timed world events: the tick is the game frame, counted on the monotonic clock without the pauses
+    timer_wheel timers;
+    timer_wheel_init(&timers, 0);
+    double clock_origin = monotonic_seconds();
+    rng_state events_rng;
+    rng_seed(&events_rng, rng_hash(seed, -2, -2));
+    // * Idle bookkeeping: time at which the pause started and drone at rest with no user force
+    time_t pause_time = 0;
+    double pause_clock = 0.0;
+    int resting = 0;
+    // * Local prediction statistics: predicted frames and frames corrected by the dynamics
+    int predicted_frames = 0, corrected_frames = 0;
+    // * Moving obstacles (dense mode): collision entity of each obstacle id of the generator, and whether they move
+    int *moving_entities = NULL;
+    int num_moving = 0;
+    int streaming = 0;
+    // * Start of the running frame being timed, 0 outside the running state, and the key it consumed (0 if none)
+    // * with the time it was read; time the frame spent waiting for that key
+    uint64_t frame_start = 0, key_time = 0, frame_idle = 0;
+    uint32_t frame_key = 0;
+    // * Frames sent to the dynamics: the reply carries the number of its frame, a late reply to a frame sent again
+    // * is recognised and dropped
+    uint32_t dynamics_sequence = 0;
+    // * The autopilot is restarted with the blackboard and starts its game from the menu: its 's' has no place in
+    // * a resumed round
+    int skip_start = resuming && autopilot.out != NULL;
+    if (resuming) {
+        memcpy(drone_pos, resume.drone_pos, sizeof(drone_pos));
+        memcpy(drone_force, resume.drone_force, sizeof(drone_force));
+        score = resume.score;
+        distance_traveled = resume.distance_traveled;
+        wave = resume.wave;
+        round = resume.round;
+        start_time = time(NULL) - resume.elapsed;
+        status = 1;
+    }
+    double next_checkpoint = monotonic_seconds() + CHECKPOINT_PERIOD;
+    // * Bring-up phases still to log (startup.h): 2 until the menu is shown, 1 until the first frame, then 0
+    int starting = 2;
     // * Char read from keyboard
     char c;
-    fd_set read_keyboard;
-    struct timeval timeout;
     do {
         switch (status) {
             case 0: { // * Menu
@@ -101,75 +399,142 @@ int main(const int argc, char *argv[]) {
                 int msg_length = (int)strlen(message);
                 mvwprintw(win, height / 2, (width - msg_length) / 2, "%s", message);
 
-                // * Attempt to read a character from the keyboard pipe (non-blocking)
-                FD_ZERO(&read_keyboard);
-                FD_SET(keyboard, &read_keyboard);
-                timeout.tv_sec = 0;
-                timeout.tv_usec = 1e6/FRAME_RATE; // * Frame rate of ~60Hz
-                if (select(keyboard + 1, &read_keyboard, NULL, NULL, &timeout) > 0) {
-                    if (FD_ISSET(keyboard, &read_keyboard)) {
-                        const ssize_t bytesRead = read(keyboard, &c, 1);
-                        if (bytesRead == -1) {
-                            perror("read keyboard");
-                            break;
-                        }
-                    }
+                if (starting == 2) {
+                    startup_phase("blackboard", "menu");
+                    starting = 1;
                 }
-                else {
-                    c = '\0';
+                // * Nothing changes until a key arrives: sleep on the keyboard pipe, and on the obstacles of the
+                // * first map, handed to the targets generator as soon as they come
+                c = wait_key(keyboard, prefetch == 1 ? generators.obstacle_read : NULL, -1);
+                if (prefetch == 1 && c == '\0') {
+                    heartbeat_wait();
+                    prefetch = map_stage(&generators, &first_map, prefetch, &world);
+                    heartbeat_beat();
                 }
                 // * Change the game status
                 if (c == 'q') status = -1;  // * Then quit
                 if (c == 's') {
+                    if (starting) {
+                        startup_phase("blackboard", "start key");
+                    }
                     status = 1;  // * Run the game
                     werase(win);  // * Erase entire window
                 }
+                if (c != '\0' && c != 'q' && c != 's') {
+                    metrics_add(metrics, METRIC_KEYS_DROPPED, 1);
+                }
                 break;
             }
             case 1: { // * initialization
-                // * OBSTACLES
-                // * Take the obstacles position
-                if (read(obstacle_read, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char))  != GAME_HEIGHT * GAME_WIDTH * sizeof(char)) {
-                    perror("read obstacle");
-                    status = -1;
-                    c = 'q';
-                    break;
+                if (chunked) {
+                    // * Only the tiles around the drone are generated, the others are requested when it gets close
+                    if (chunk_world_init(&chunks, CHUNK_CACHE_CAPACITY) == -1 ||
+                        load_view(&generators, seed, round, &chunks, map_width / 2, map_height / 2, &world,
+                        &index) == -1) {
+                        fprintf(stderr, "Failed to load the tiles around the drone.\n");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                } else {
+                    // * OBSTACLES and TARGETS of the whole map, from the map file for the first round if one is given
+                    // * (from the snapshot when resuming), the first generated map is the one asked at startup
+                    const int pending = prefetch;
+                    prefetch = 0;
+                    const char *map_file = resuming ? resume_path : map_path && round == 0 ? map_path : NULL;
+                    int generated = map_file ? load_map(&generators, map_file, seed, &world) :
+                        pending ? complete_map(&generators, &first_map, pending, &world) :
+                        generate_map(&generators, GEN_MAP, 0, 0, seed, round, &world);
+                    // * A generator restarted meanwhile is asked for the map again from the start
+                    while (generated == -1 && generator_lost(&generators, seed, round, NULL, &index, NULL, 0, 0) == 0) {
+                        generated = map_file ? load_map(&generators, map_file, seed, &world) :
+                            generate_map(&generators, GEN_MAP, 0, 0, seed, round, &world);
+                    }
+                    if (generated == -1) {
+                        perror("generate map");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    if (world.height != map_height || world.width != map_width) {
+                        fprintf(stderr, "Generators sent a %dx%d map, expected %dx%d.\n", world.height, world.width,
+                            map_height, map_width);
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    // * Index obstacles and targets for the collision queries
+                    if (collision_index_build(&index, &world) == -1) {
+                        fprintf(stderr, "Failed to build the collision index.\n");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    // * Start the lifetime of every target and the temporary obstacles
+                    const uint64_t now = (uint64_t)((monotonic_seconds() - clock_origin) * FRAME_RATE);
+                    int scheduled = 0;
+                    for (int id = 0; id < index.num_entities && scheduled == 0; id++) {
+                        if (index.entities[id].bucket >= 0 && index.entities[id].kind != 'o') {
+                            scheduled = schedule_target(&timers, &index, id, now);
+                        }
+                    }
+                    const timer_event spawn = {EVENT_OBSTACLE_SPAWN, -1, 0};
+                    const uint64_t first_spawn = now + (uint64_t)(TEMP_OBSTACLE_PERIOD * FRAME_RATE);
+                    if (scheduled == -1 || timer_wheel_schedule(&timers, first_spawn, spawn) == -1) {
+                        fprintf(stderr, "Failed to schedule the world events.\n");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    // * Let the obstacles generator move the obstacles of the map (a generator restarted meanwhile
+                    // * is given the map and moves them)
+                    if (track_obstacles(&index, &moving_entities, &num_moving) == -1 ||
+                        (obstacle_stream(&generators, 1, &world, &index, moving_entities, num_moving,
+                        drone_pos) == -1 && generator_lost(&generators, seed, round, &world, &index, moving_entities,
+                        num_moving, 1) == -1)) {
+                        perror("obstacle stream");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    streaming = 1;
                 }
-                // * TARGETS
-                // * Send the map to the targets
-                if (write(target_write, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char)) == -1) {
-                    perror("write target");
-                    status = -1;
-                    c = 'q';
-                    break;
+                // * Count hte number of obstacles for the score
+                count_obstacles = (int)occupancy_popcount(world.obstacles, occupancy_words(&world));
+                // * Setting drone initial positions (kept from the snapshot when resuming)
+                if (!resuming) {
+                    drone_pos[0] = map_width / 2;
+                    drone_pos[1] = map_height / 2;
+                    drone_pos[2] = map_width / 2;
+                    drone_pos[3] = map_height / 2;
+                } else {
+                    // * The drone of the last frame, when it is of the snapshot's wave and not on one of its obstacles
+                    checkpoint_state last;
+                    if (checkpoint_last_frame(&last) && last.round == resume.round && last.wave == resume.wave &&
+                        last.elapsed >= resume.elapsed &&
+                        !occupancy_test(&world, world.obstacles, last.drone_pos[2], last.drone_pos[3])) {
+                        memcpy(drone_pos, last.drone_pos, sizeof(drone_pos));
+                        memcpy(drone_force, last.drone_force, sizeof(drone_force));
+                        score = last.score;
+                        distance_traveled = last.distance_traveled;
+                        start_time = time(NULL) - last.elapsed;
+                    }
+                    char resume_msg[128];
+                    snprintf(resume_msg, sizeof(resume_msg), "Blackboard resumed round %d from its checkpoint "
+                        "(%d s played, score %d).", round, (int)(time(NULL) - start_time), score);
+                    log_write(resume_msg);
+                    resuming = 0;
                 }
-                // * Take the targets position
-                if (read(target_read, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char))  != GAME_HEIGHT * GAME_WIDTH * sizeof(char)) {
-                    perror("read targets");
+                // * Give the autopilot the whole map to plan on
+                if (autopilot.out && autopilot_send(&world, AUTOPILOT_MAP, drone_pos, drone_force) == -1) {
+                    perror("write autopilot");
                     status = -1;
                     c = 'q';
                     break;
                 }
-                // * Clean possible dirties in grid due to pipes
-                for (int row = 0; row < GAME_HEIGHT; row++) {
-                    for (int col = 0; col < GAME_WIDTH; col++) {
-                        if (!strchr("o0123456789", grid[row][col])) {
-                            grid[row][col] = ' ';
-                        }
-                    }
+                if (starting) {
+                    startup_phase("blackboard", "map");
                 }
-                // * Count hte number of obstacles for the score
-                for (int r = 0; r < GAME_HEIGHT; r++) {
-                    for (int col = 0; col < GAME_WIDTH; col++) {
-                        if (grid[r][col] == 'o')
-                            count_obstacles++;
-                    }
-                }
-                // * Setting drone initial positions
-                drone_pos[0] = GAME_WIDTH / 2;
-                drone_pos[1] = GAME_HEIGHT / 2;
-                drone_pos[2] = GAME_WIDTH / 2;
-                drone_pos[3] = GAME_HEIGHT / 2;
                 // * Run the game
                 status = 2;
                 break;
@@ -177,116 +542,196 @@ int main(const int argc, char *argv[]) {
             case 2: { // * Running
                 // * Ssve the previous drone position to compute the velocity
                 int prev_x = drone_pos[0], prev_y = drone_pos[1];
-                // * Clean the previous position of the drone in the grid
-                grid[drone_pos[1]][drone_pos[0]] = ' ';
+                frame_start = latency_now();
+                frame_key = 0;
+                uint64_t lap = frame_start;
                 // * Draw the new map proportionally to the window dimension
-                for (int row = 1; row < GAME_HEIGHT-1; row++) {
-                    for (int col = 1; col < GAME_WIDTH-1; col++) {
-                        if (grid[row][col] == 'o') {
-                            wattron(win, COLOR_PAIR(3)); // * YELLOW for obstacles
-                            mvwprintw(win, row * height / GAME_HEIGHT, col * width / GAME_WIDTH, "o");
-                            wattroff(win, COLOR_PAIR(3));
-                            continue;
-                        }
-                        if (strchr("0123456789", grid[row][col])) {
-                            wattron(win, COLOR_PAIR(2)); // * GREEN for targets
-                            mvwprintw(win, row * height / GAME_HEIGHT, col * width / GAME_WIDTH, "%c", grid[row][col]);
-                            wattroff(win, COLOR_PAIR(2));
-                        }
-                    }
+                draw_world(win, &world, height, width);
+                // * Wait for a key for one frame (~60Hz), or if the drone is at rest until a key arrives, the next
+                // * world event is due or obstacles move
+                long timeout = (long)(1e6/FRAME_RATE);
+                if (resting) {
+                    const uint64_t tick = (uint64_t)((monotonic_seconds() - clock_origin) * FRAME_RATE);
+                    const uint64_t next = timer_wheel_next(&timers);
+                    timeout = next == UINT64_MAX ? -1 :
+                        next <= tick ? 0 : (long)((double)(next - tick) * 1e6/FRAME_RATE);
                 }
-                // * Attempt to read a character from the keyboard pipe (non-blocking)
-                FD_ZERO(&read_keyboard);
-                FD_SET(keyboard, &read_keyboard);
-                timeout.tv_sec = 0;
-                timeout.tv_usec = 1e6/FRAME_RATE; // * Frame rate of ~60Hz
-                if (select(keyboard + 1, &read_keyboard, NULL, NULL, &timeout) > 0) {
-                    if (FD_ISSET(keyboard, &read_keyboard)) {
-                        const ssize_t bytesRead = read(keyboard, &c, 1);
-                        if (bytesRead == -1) {
-                            perror("read keyboard");
-                            break;
-                        }
-                    }
+                lap = stage_end(STAGE_DRAW, 0, lap);
+                const uint64_t wait_start = lap;
+                c = wait_key(keyboard, streaming ? generators.obstacle_read : NULL, timeout);
+                lap = stage_end(STAGE_WAIT, 0, lap);
+                frame_idle = lap - wait_start;
+                if (c == '\0' && timeout >= 0 && frame_idle >= (uint64_t)timeout * 1000) {
+                    latency_record(&stages[STAGE_JITTER], frame_idle - (uint64_t)timeout * 1000);
                 }
-                else {
-                    c = '\0';
+                if (skip_start && c != '\0') {
+                    skip_start = 0;
+                    if (c == 's') {
+                        c = '\0';
+                        metrics_add(metrics, METRIC_KEYS_DROPPED, 1);
+                    }
                 }
+                // * A frame that consumes a key carries its sequence number to the dynamics and the inspector
+                frame_key = c != '\0' ? keys_read : 0;
+                key_time = lap;
                 // * Clean the previous position of the drone in the map and draw the current
-                mvwprintw(win, drone_pos[1]*height/GAME_HEIGHT, drone_pos[0]*width/GAME_WIDTH, " ");
-                wattron(win, COLOR_PAIR(1)); // * BLUE for drone
-                mvwprintw(win, drone_pos[3]*height/GAME_HEIGHT, drone_pos[2]*width/GAME_WIDTH, "+");
-                wattroff(win, COLOR_PAIR(1));
+                draw_drone(win, &world, height, width, drone_pos[0], drone_pos[1], " ");
+                draw_drone(win, &world, height, width, drone_pos[2], drone_pos[3], "+");
                 // * Compute the new forces of the drone
                 command_drone(drone_force, c);
-                // * Send the new grid to drone dynamics
-                if (write(dynamic_write, grid, GAME_WIDTH * GAME_HEIGHT * sizeof(char)) == -1) {
-                    perror("write target");
-                    status = -1;
-                    c = 'q';
-                    break;
-                }
-                // * Send drone positions and forces generate by the user
+                // * Send the neighbourhood of the drone, the drone positions and the forces generated by the user to
+                // * drone dynamics
                 char msg[100];
-                snprintf(msg, sizeof(msg), "%d,%d,%d,%d,%d,%d", drone_pos[0], drone_pos[1], drone_pos[2],
-                    drone_pos[3], drone_force[0], drone_force[1]);
-                if (write(dynamic_write, msg, sizeof(msg)) == -1) {
-                    perror("write");
+                snprintf(msg, sizeof(msg), "%d,%d,%d,%d,%d,%d,%u,%u", drone_pos[0], drone_pos[1], drone_pos[2],
+                    drone_pos[3], drone_force[0], drone_force[1], frame_key, ++dynamics_sequence);
+                if (occupancy_window(&world, drone_pos[2] - FIELD_RADIUS - world.origin_x,
+                    drone_pos[3] - FIELD_RADIUS - world.origin_y,
+                    2 * FIELD_RADIUS + 1, 2 * FIELD_RADIUS + 1, &field_window) == -1 ||
+                    dynamics_request(dynamic_write, &field_window, msg) == -1) {
+                    perror("write dynamics");
                     status = -1;
                     c = 'q';
                     break;
                 }
+                lap = stage_end(STAGE_SEND, frame_key, lap);
+                // * Predict the next position from the last velocity and the user force only, and show it
+                // * while the dynamics computes the authoritative one
+                const int predicted_x = drone_clamp(drone_integrate((double)drone_force[0]/10, drone_pos[0],
+                    drone_pos[2]), map_width);
+                const int predicted_y = drone_clamp(drone_integrate((double)drone_force[1]/10, drone_pos[1],
+                    drone_pos[3]), map_height);
+                draw_drone(win, &world, height, width, drone_pos[2], drone_pos[3], " ");
+                draw_drone(win, &world, height, width, predicted_x, predicted_y, "+");
+                wrefresh(win);
+                predicted_frames++;
+                lap = stage_end(STAGE_PREDICT, frame_key, lap);
                 // * Retrieve the new position
-                char in_buf[32];
-                if (read(dynamic_read, in_buf, sizeof(in_buf)) == -1) {
-                    perror("write");
+                int new_x, new_y;
+                if (dynamics_reply(dynamic_read, dynamic_write, &field_window, msg, dynamics_sequence, &new_x,
+                    &new_y) == -1) {
+                    perror("read dynamics");
                     status = -1;
                     c = 'q';
                     break;
                 }
                 drone_pos[0] = drone_pos[2];
                 drone_pos[1] = drone_pos[3];
-                if (sscanf(in_buf, "%d,%d", &drone_pos[2], &drone_pos[3]) != 2) {
-                    perror("sscanf");
+                drone_pos[2] = new_x;
+                drone_pos[3] = new_y;
+                lap = stage_end(STAGE_DYNAMICS, frame_key, lap);
+                // * Remove any target along the path and stop the drone on the first obstacle
+                collect_on_path(&world, &index, chunked ? &chunks : NULL, &timers, drone_pos, prev_x, prev_y);
+                lap = stage_end(STAGE_COLLECT, frame_key, lap);
+                // * Fire the world events due at this frame
+                const uint64_t now = (uint64_t)((monotonic_seconds() - clock_origin) * FRAME_RATE);
+                int expired = 0;
+                const int removed = run_events(&timers, now, &world, &index, &events_rng, drone_pos, &count_obstacles,
+                    &expired);
+                // * One round trip to the targets generator for all the targets expired on this tick (a whole wave at
+                // * times), sent again to a generator restarted meanwhile
+                int respawned = removed != -1 && expired > 0 ?
+                    respawn_targets(&generators, expired, &world, &index, &timers, now) : 0;
+                while (respawned == -1 && generator_lost(&generators, seed, round, chunked ? NULL : &world, &index,
+                    moving_entities, num_moving, streaming) == 0) {
+                    respawned = respawn_targets(&generators, expired, &world, &index, &timers, now);
+                }
+                if (removed == -1 || respawned == -1) {
+                    perror("world events");
+                    status = -1;
+                    c = 'q';
+                    break;
+                }
+                lap = stage_end(STAGE_EVENTS, frame_key, lap);
+                // * Move the obstacles by the events streamed since the last frame
+                // * A generator restarted meanwhile is given the map and moves the obstacles from there
+                int moved = streaming ? apply_obstacle_moves(generators.obstacle_read, 0, &world, &index,
+                    moving_entities, num_moving, drone_pos) : 0;
+                if (moved == -1 && generator_lost(&generators, seed, round, &world, &index, moving_entities, num_moving,
+                    1) == 0) {
+                    moved = 0;
+                }
+                if (moved == -1) {
+                    perror("obstacle moves");
                     status = -1;
                     c = 'q';
                     break;
                 }
+                if (removed > 0 || moved > 0) {
+                    werase(win);
+                }
+                // * Move the view when the drone enters another tile
+                if (chunked && (chunk_tile_of(drone_pos[2]) != chunk_tile_of(world.origin_x) + CHUNK_VIEW_RADIUS ||
+                    chunk_tile_of(drone_pos[3]) != chunk_tile_of(world.origin_y) + CHUNK_VIEW_RADIUS)) {
+                    int loaded = load_view(&generators, seed, round, &chunks, drone_pos[2], drone_pos[3], &world,
+                        &index);
+                    while (loaded == -1 && generator_lost(&generators, seed, round, NULL, &index, NULL, 0, 0) == 0) {
+                        loaded = load_view(&generators, seed, round, &chunks, drone_pos[2], drone_pos[3], &world,
+                            &index);
+                    }
+                    if (loaded == -1) {
+                        fprintf(stderr, "Failed to load the tiles around the drone.\n");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    count_obstacles = (int)occupancy_popcount(world.obstacles, occupancy_words(&world));
+                    werase(win);
+                }
+                lap = stage_end(STAGE_WORLD, frame_key, lap);
+                // * Reconcile the prediction with the authoritative position
+                if (drone_pos[2] != predicted_x || drone_pos[3] != predicted_y) {
+                    corrected_frames++;
+                    draw_drone(win, &world, height, width, predicted_x, predicted_y, " ");
+                    draw_drone(win, &world, height, width, drone_pos[2], drone_pos[3], "+");
+                }
                 // * Compute the mean velocity
                 int vel_x = drone_pos[2] - prev_x;
                 int vel_y = drone_pos[3] - prev_y;
-                // * Remove any target along the path
-                remove_target_on_path(grid, prev_x, prev_y, drone_pos[2], drone_pos[3]);
-                // * Send the message containing foce, postion and velocity of the drone to the inspector window
-                char insp_msg[128];
-                char key;
-                if (c == '\0') key = '-';
-                else key = c;
-                snprintf(insp_msg, sizeof(insp_msg), "%d,%d,%d,%d,%d,%d,%c", drone_force[0], -1*drone_force[1],
-                    drone_pos[2], drone_pos[3], vel_x, vel_y, key);
-                const int fd = open(INSPECTOR_FIFO, O_WRONLY);
-                if (write(fd, insp_msg, strlen(insp_msg)) == -1) {
-                    perror("write insp_pipe");
-                    status = -1;
-                    c = 'q';
+                // * Send the message containing foce, postion and velocity of the drone to the inspector window (none
+                // * without its terminal; a message the inspector is not there to read is dropped)
+                if (insp_pid > 0) {
+                    char insp_msg[128];
+                    char key;
+                    if (c == '\0') key = '-';
+                    else key = c;
+                    snprintf(insp_msg, sizeof(insp_msg), "%d,%d,%d,%d,%d,%d,%c,%u\n", drone_force[0],
+                        -1*drone_force[1], drone_pos[2], drone_pos[3], vel_x, vel_y, key, frame_key);
+                    const int sent = inspector_send(&insp_fd, insp_msg, strlen(insp_msg));
+                    if (sent == -1) {
+                        perror("write insp_pipe");
+                    } else if (sent) {
+                        inspector_bytes += strlen(insp_msg);
+                        inspector_messages++;
+                    }
                 }
-                close(fd);
+                lap = stage_end(STAGE_INSPECTOR, frame_key, lap);
                 // * Update the traveled distance
                 distance_traveled += abs(drone_pos[2] - prev_x) + abs(drone_pos[3] - prev_y);
                 // * Compite the time
                 int elapsed_time = (int)(time(NULL) - start_time);
-                // * Count the remaining targets
-                int count_targets = 0;
-                for (int r = 0; r < GAME_HEIGHT; r++) {
-                    for (int col = 0; col < GAME_WIDTH; col++) {
-                        if (strchr("0123456789", grid[r][col]) != NULL)
-                            count_targets++;
+                // * Count the remaining targets (in chunked mode, the ones in view: the world has no end)
+                int count_targets = world.num_targets;
+                // * Refill the map with a new wave until the last one is collected
+                if (count_targets == 0 && !chunked && wave < TARGET_WAVES) {
+                    int respawned_wave = respawn_targets(&generators, TARGETS_PER_WAVE, &world, &index, &timers, now);
+                    while (respawned_wave == -1 && generator_lost(&generators, seed, round, &world, &index,
+                        moving_entities, num_moving, streaming) == 0) {
+                        respawned_wave = respawn_targets(&generators, TARGETS_PER_WAVE, &world, &index, &timers, now);
+                    }
+                    if (respawned_wave == -1) {
+                        perror("respawn targets");
+                        status = -1;
+                        c = 'q';
+                        break;
                     }
+                    wave++;
+                    count_targets = world.num_targets;
                 }
                 // * Compute the loss score
-                score -= elapsed_time * 10 + distance_traveled * 5 + count_obstacles/((10 -count_targets) * 3000);
+                score -= elapsed_time * 10 + distance_traveled * 5 +
+                    (count_targets < 10 ? count_obstacles/((10 -count_targets) * 3000) : 0);
                 if (score < 0) score = 0;
-                if (count_targets == 0) {
+                if (count_targets == 0 && !chunked) {
                     status = -1;
                     c = 'q';
                     mvwprintw(win, height/2, width/2, "YOU WIN SCORE %d", score);
@@ -296,13 +741,119 @@ int main(const int argc, char *argv[]) {
                     c = 'q';
                     mvwprintw(win, height/2, width/2, "GAME OVER");
                 }
+                stage_end(STAGE_TARGETS, frame_key, lap);
                 if (c == 'q') {
                     status = -1;
                 }
+                // * Snapshot of the round, for a blackboard restarted by the supervisor: the drone every frame, the
+                // * map every period (written by a fork, off the frame)
+                if (status == 2 && !chunked) {
+                    const checkpoint_state state = {
+                        {drone_pos[0], drone_pos[1], drone_pos[2], drone_pos[3]}, {drone_force[0], drone_force[1]},
+                        score, distance_traveled, wave, round, elapsed_time,
+                    };
+                    checkpoint_track(&state);
+                    if (monotonic_seconds() >= next_checkpoint) {
+                        if (checkpoint_save(&world, &state) == -1) {
+                            perror("checkpoint");
+                        }
+                        next_checkpoint = monotonic_seconds() + CHECKPOINT_PERIOD;
+                    }
+                }
+                // * The dynamics is deterministic: no movement and no user force means no movement next frame either
+                resting = drone_pos[0] == drone_pos[2] && drone_pos[1] == drone_pos[3] &&
+                    drone_force[0] == 0 && drone_force[1] == 0;
+                if (c == 'm') {
+                    // * Save the world as it is now (in chunked mode, the view around the drone)
+                    char save_path[64], save_msg[128];
+                    snprintf(save_path, sizeof(save_path), "map_%llu_%d.dgm", (unsigned long long)seed, round);
+                    snprintf(save_msg, sizeof(save_msg), map_file_save(save_path, &world) == -1 ?
+                        "Failed to save the map to %s." : "Map saved to %s.", save_path);
+                    log_write(save_msg);
+                }
+                if (c == 'n' && status == 2) {
+                    // * New round: drop the world of this one and let the initialization take the next map, which
+                    // * the obstacles generator has ready in its queue
+                    if (streaming && obstacle_stream(&generators, 0, &world, &index, moving_entities, num_moving,
+                        drone_pos) == -1 && generator_lost(&generators, seed, round, &world, &index, moving_entities,
+                        num_moving, 0) == -1) {
+                        perror("obstacle stream");
+                        status = -1;
+                        c = 'q';
+                        break;
+                    }
+                    streaming = 0;
+                    timer_wheel_free(&timers);
+                    timer_wheel_init(&timers, 0);
+                    clock_origin = monotonic_seconds();
+                    chunk_world_free(&chunks);
+                    round++;
+                    wave = 1;
+                    score = 500000000;
+                    distance_traveled = 0;
+                    start_time = time(NULL);
+                    drone_force[0] = drone_force[1] = 0;
+                    resting = 0;
+                    status = 1;
+                    werase(win);
+                }
+                if (c == 'p' && status == 2) {
+                    status = -2;
+                    pause_time = time(NULL);
+                    pause_clock = monotonic_seconds();
+                    // * The obstacles stop with the game
+                    if (streaming && obstacle_stream(&generators, 0, &world, &index, moving_entities, num_moving,
+                        drone_pos) == -1 && generator_lost(&generators, seed, round, &world, &index, moving_entities,
+                        num_moving, 0) == -1) {
+                        perror("obstacle stream");
+                        status = -1;
+                        c = 'q';
+                    }
+                    streaming = 0;
+                }
+                // * Tell the autopilot where the drone is and what changed during the frame
+                if (status == 2 && autopilot.out) {
+                    lap = latency_now();
+                    if (autopilot_send(&world, AUTOPILOT_FRAME, drone_pos, drone_force) == -1) {
+                        perror("write autopilot");
+                        status = -1;
+                        c = 'q';
+                    }
+                    stage_end(STAGE_AUTOPILOT, frame_key, lap);
+                }
+                break;
+            }
+            case -2: { // * Pause
+                const char *message = "Paused: press P to resume or Q to quit";
+                int msg_length = (int)strlen(message);
+                mvwprintw(win, height / 2, (width - msg_length) / 2, "%s", message);
+                wrefresh(win);
+                // * Sleep on the keyboard pipe until the user resumes or quits
+                c = wait_key(keyboard, NULL, -1);
+                if (c == 'q') status = -1;
+                if (c != '\0' && c != 'q' && c != 'p') {
+                    metrics_add(metrics, METRIC_KEYS_DROPPED, 1);
+                }
+                if (c == 'p') {
+                    // * The paused time does not count in the score
+                    start_time += time(NULL) - pause_time;
+                    clock_origin += monotonic_seconds() - pause_clock;
+                    status = 2;
+                    werase(win);
+                    if (moving_entities && obstacle_stream(&generators, 1, &world, &index, moving_entities, num_moving,
+                        drone_pos) == -1 && generator_lost(&generators, seed, round, &world, &index, moving_entities,
+                        num_moving, 1) == -1) {
+                        perror("obstacle stream");
+                        status = -1;
+                        c = 'q';
+                    }
+                    streaming = moving_entities != NULL;
+                }
                 break;
             }
             default: break;
         }
+        const uint64_t refresh_start = latency_now();
         // * See if the windows is resized
         int new_height = 0, new_width = 0;
         getmaxyx(stdscr, new_height, new_width);
@@ -318,41 +869,93 @@ int main(const int argc, char *argv[]) {
         box(win, 0, 0);   // * Redraw border
         // * Stampa il punteggio a posizione y=0, x=4
         mvwprintw(win, 0, 4, "Score: %d", score);
-        mvwprintw(win, 0, width-20, "Press q to quit");
+        mvwprintw(win, 0, width-36, "Press n for a new round, q to quit");
         wrefresh(win);
         refresh();  // * Ensure standard screen updates
         // * Refresh the standard screen and the new window
         wrefresh(win);
         wrefresh(stdscr);
+        if (frame_start) {
+            stage_end(STAGE_REFRESH, frame_key, refresh_start);
+            const uint64_t frame_end = latency_lap(&stages[STAGE_FRAME], frame_start);
+            if (frame_key) {
+                // * From the key read to the screen refreshed: the hop of the key through the blackboard
+                trace_record("frame", frame_key, key_time, frame_end, 't');
+            }
+            metrics_add(metrics, METRIC_FRAMES, 1);
+            if ((double)(frame_end - frame_start - frame_idle) > 1e9 / FRAME_RATE) {
+                metrics_add(metrics, METRIC_FRAMES_MISSED, 1);
+            }
+            frame_start = 0;
+            if (starting) {
+                startup_phase("blackboard", "frame");
+                starting = 0;
+            }
+        }
+        publish_metrics(ends, score, world.num_targets);
+        if (latency_dump) {
+            latency_dump = 0;
+            latency_report("Blackboard", stages, NUM_STAGES);
+        }
     } while (!(status == -1  && c == 'q')); // * Exit on 'q' and if status is -1
 
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "Blackboard prediction: %d frames predicted, %d corrected by the dynamics.",
+        predicted_frames, corrected_frames);
+    log_write(log_msg);
+    latency_report("Blackboard", stages, NUM_STAGES);
+    // * Stop the obstacles so that the generator is not left writing to a closed pipe, and take the first map if
+    // * the game ended before it was played
+    if (streaming) {
+        obstacle_stream(&generators, 0, &world, &index, moving_entities, num_moving, drone_pos);
+    }
+    if (prefetch > 0) {
+        complete_map(&generators, &first_map, prefetch, &world);
+    }
+    free(moving_entities);
+    free(autopilot.changes);
+    collision_index_free(&index);
+    timer_wheel_free(&timers);
+    chunk_world_free(&chunks);
+    occupancy_free(&world);
+    occupancy_free(&field_window);
     // * Close the inspector window
-    kill(-insp_pid, SIGTERM);
-    waitpid(insp_pid, NULL, 0);
+    if (insp_fd != -1) {
+        close(insp_fd);
+    }
+    if (insp_pid > 0) {
+        kill(-insp_pid, SIGTERM);
+        waitpid(insp_pid, NULL, 0);
+    }
     // * Final cleanup
     if (win) {
         delwin(win);
     }
     endwin();
-
-    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
-        close(read_fds[i]);
-    }
-    for (int i = 0; i < NUM_CHILD_PIPES - 1; i++) {
-        close(write_fds[i]);
-    }
-    fclose(logfile);
+    trace_close();
+    metrics_close(metrics);
+    heartbeat_close();
+    checkpoint_close();
+    log_close();
 
     return EXIT_SUCCESS;
 }
 
-int parser(int argc, char *argv[], int *read_fds, int *write_fds) {
+#ifndef DRONE_THREADS
+static int parser(int argc, char *argv[], int *read_fds, int *write_fds, int *map_height, int *map_width,
+    uint64_t *seed, int *chunked, const char **map_path, int *autopilot_fd) {
     /*
      * Parse the file descriptors and watchdog PID from the command-line arguments.
      * @param argc Number of arguments.
      * @param argv Array of arguments.
      * @param read_fds Array to store read file descriptors.
      * @param write_fds Array to store write file descriptors.
+     * @param map_height Map height.
+     * @param map_width Map width.
+     * @param seed Seed of the generators.
+     * @param chunked 1 if the world is generated tile by tile around the drone.
+     * @param map_path Map file to load for the first round, NULL to generate it.
+     * @param autopilot_fd Write end of the pipe towards the autopilot, -1 if the keyboard manager is used.
      * @param watchdog_pid Pointer to store the watchdog PID.
      * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
     */
@@ -374,26 +977,38 @@ int parser(int argc, char *argv[], int *read_fds, int *write_fds) {
             return EXIT_FAILURE;
         }
     }
-    // * Parse logfile file descriptor and open it
-    int logfile_fd = atoi(argv[argc - 1]);
-    logfile = fdopen(logfile_fd, "a");
-    if (!logfile) {
-        perror("fdopen logfile");
+    // * Parse the map size
+    if (occupancy_parse_size(argv[2 * NUM_CHILD_PIPES], argv[2 * NUM_CHILD_PIPES + 1], map_height, map_width) == -1) {
+        return EXIT_FAILURE;
+    }
+    // * Parse the seed and the world mode
+    char *endptr;
+    *seed = strtoull(argv[2 * NUM_CHILD_PIPES + 2], &endptr, 10);
+    if (*endptr != '\0') {
+        fprintf(stderr, "Invalid seed: %s\n", argv[2 * NUM_CHILD_PIPES + 2]);
+        return EXIT_FAILURE;
+    }
+    *chunked = atoi(argv[2 * NUM_CHILD_PIPES + 3]) != 0;
+    *map_path = strcmp(argv[2 * NUM_CHILD_PIPES + 4], "-") ? argv[2 * NUM_CHILD_PIPES + 4] : NULL;
+    *autopilot_fd = (int)strtol(argv[2 * NUM_CHILD_PIPES + 5], &endptr, 10);
+    if (*endptr != '\0' || *autopilot_fd < -1) {
+        fprintf(stderr, "Invalid autopilot file descriptor: %s\n", argv[2 * NUM_CHILD_PIPES + 5]);
         return EXIT_FAILURE;
     }
-
     return EXIT_SUCCESS;
 }
 
-void signal_triggered(int signum) {
-        time_t now = time(NULL);
-        struct tm *t = localtime(&now);
-        fprintf(logfile, "[%02d:%02d:%02d] PID: %d - %s\n", t->tm_hour, t->tm_min, t->tm_sec, getpid(),
-                "Blackboard is active.");
-        fflush(logfile);
+static void signal_triggered(int signum) {
+    log_write("Blackboard is active.");
+}
+
+static void signal_latency(int signum) {
+    // * The report is written by the main loop, at the end of the current frame
+    latency_dump = 1;
 }
+#endif
 
-int initialize_ncurses() {
+static int initialize_ncurses() {
     /*
      * Initialize ncurses settings and create a new window.
      * @return Pointer to the newly created window, or NULL on failure.
@@ -415,14 +1030,14 @@ int initialize_ncurses() {
     return EXIT_SUCCESS;
 }
 
-void command_drone(int *drone_force, char c) {
+static void command_drone(int *drone_force, char c) {
     /*
      * Modify the drone force based on the input key.
      * Command keys:
      * 'w': Up Left, 'e': Up, 'r': Up Right or Reset,
      * 's': Left or Suspend, 'd': Brake, 'f': Right,
      * 'x': Down Left, 'c': Down, 'v': Down Right,
-     * 'p': Pause, 'q': Quit
+     * 'p': Pause, 'n': New round, 'm': Save the map, 'q': Quit
      * -------
      * @param drone_force Array representing the drone's force.
      * @param c The input character.
@@ -445,58 +1060,858 @@ void command_drone(int *drone_force, char c) {
     }
 }
 
-pid_t launch_inspection_window() {
+static char wait_key(channel *keyboard, channel *wake, const long timeout_us) {
+    /*
+     * Wait for a key on the keyboard channel.
+     * @param keyboard Reading end of the keyboard channel.
+     * @param wake Another channel that ends the wait when it has data (it is not read), NULL for none.
+     * @param timeout_us Maximum wait in microseconds, -1 to sleep until a key (or a signal) arrives.
+     * @return The key read, '\0' on timeout, wake up, signal or error.
+     */
+    const int keyboard_fd = channel_fd(keyboard);
+    const int wake_fd = wake ? channel_fd(wake) : -1;
+    fd_set read_keyboard;
+    FD_ZERO(&read_keyboard);
+    FD_SET(keyboard_fd, &read_keyboard);
+    if (wake_fd >= 0) {
+        FD_SET(wake_fd, &read_keyboard);
+    }
+    struct timeval timeout;
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_usec = timeout_us % 1000000;
+    char c = '\0';
+    heartbeat_wait();
+    if (select((keyboard_fd > wake_fd ? keyboard_fd : wake_fd) + 1, &read_keyboard, NULL, NULL,
+        timeout_us < 0 ? NULL : &timeout) > 0 && FD_ISSET(keyboard_fd, &read_keyboard)) {
+        // * EPIPE: the keyboard manager is gone
+        if (channel_read(keyboard, &c, 1) == -1) {
+            if (errno != EPIPE) {
+                perror("read keyboard");
+            }
+            c = '\0';
+        } else {
+            keys_read++;
+        }
+    }
+    heartbeat_beat();
+    return c;
+}
+
+static pid_t launch_inspection_window() {
     /*
      * Launches a new terminal window running the "inspector" program.
      * Returns:
-     * @return pid The process ID (pid) of the newly created child process.
+     * @return pid The process ID (pid) of the newly created child process, -1 without a terminal (the game goes on
+     * without the inspector).
     */
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        exit(EXIT_FAILURE);
+    // * In its own process group, so that the terminal and the inspector in it are closed together
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    // * with SIGPIPE back to its default, ignored by the blackboard
+    sigset_t default_set;
+    sigemptyset(&default_set);
+    sigaddset(&default_set, SIGPIPE);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setsigdefault(&attr, &default_set);
+    char *const args[] = {"gnome-terminal", "--disable-factory", "--", "bash", "-c", "./inspector; exec bash", NULL};
+    pid_t pid;
+    const int error = posix_spawnp(&pid, args[0], NULL, &attr, args, environ);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0) {
+        errno = error;
+        perror("gnome-terminal");
+        return -1;
     }
-    if (pid == 0) {
-        if (setpgid(0, 0) == -1) {
-            perror("setpgid");
-            exit(EXIT_FAILURE);
+    return pid;
+}
+
+static int inspector_send(int *fd, const char *msg, const size_t length) {
+    /*
+     * Send a status line to the inspector without ever waiting for it: the FIFO is opened non-blocking once a reader
+     * holds it, and kept open.
+     * @param fd End of the FIFO, -1 if not open (updated: opened, or closed when the inspector went away).
+     * @param length At most PIPE_BUF: a line is written whole or not at all.
+     * @return 1 if the line was sent, 0 if it was dropped (no reader, or a full FIFO), -1 on failure.
+     */
+    if (*fd == -1) {
+        *fd = open(INSPECTOR_FIFO, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (*fd == -1) {
+            return errno == ENXIO ? 0 : -1;
         }
-        execlp("gnome-terminal", "gnome-terminal", "--disable-factory", "--", "bash", "-c", "./inspector; exec bash", (char *)NULL);
-        perror("execlp");
-        exit(EXIT_FAILURE);
     }
-    return pid;
+    // * A reader gone raises SIGPIPE: keep it blocked in this thread and take it back, the EPIPE is enough
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+    const ssize_t written = write(*fd, msg, length);
+    const int error = errno;
+    if (written == -1 && error == EPIPE) {
+        const struct timespec now = {0, 0};
+        sigtimedwait(&pipe_set, NULL, &now);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    if (written == (ssize_t)length) {
+        return 1;
+    }
+    if (error == EAGAIN) {
+        return 0;
+    }
+    close(*fd);
+    *fd = -1;
+    errno = error;
+    return error == EPIPE ? 0 : -1;
+}
+
+static void draw_world(WINDOW *win, const occupancy_map *world, const int height, const int width) {
+    /*
+     * Draw obstacles and targets proportionally to the window dimension, visiting only the set bits of the layers.
+     * @param win Game window.
+     * @param world Game map.
+     * @param height Window height.
+     * @param width Window width.
+     */
+    for (int row = 1; row < world->height - 1; row++) {
+        for (int w = 0; w < world->words_per_row; w++) {
+            const long word = (long)row * world->words_per_row + w;
+            uint64_t bits = world->obstacles[word] | world->targets[word];
+            while (bits) {
+                const int col = 64 * w + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (col == 0 || col >= world->width - 1) continue;
+                if (world->obstacles[word] >> (col % 64) & 1) {
+                    wattron(win, COLOR_PAIR(3)); // * YELLOW for obstacles
+                    mvwprintw(win, row * height / world->height, col * width / world->width, "o");
+                    wattroff(win, COLOR_PAIR(3));
+                    continue;
+                }
+                wattron(win, COLOR_PAIR(2)); // * GREEN for targets
+                mvwprintw(win, row * height / world->height, col * width / world->width, "%c",
+                    occupancy_target_id(world, col, row));
+                wattroff(win, COLOR_PAIR(2));
+            }
+        }
+    }
+}
+
+static int collect_on_path(occupancy_map *world, collision_index *index, chunk_world *chunks, timer_wheel *timers,
+    int drone_pos[4], const int x0, const int y0) {
+    /*
+     * Sweep the drone movement of the frame against the spatial index.
+     * The targets crossed before the first obstacle are removed from the map and from the index.
+     * If an obstacle is crossed the drone is stopped in the last free cell before it, with zero velocity.
+     * @param world Game map.
+     * @param index Spatial index of the map entities.
+     * @param chunks Resident tiles in chunked mode (the collected targets are removed from them too), NULL otherwise.
+     * @param timers Wheel holding the lifetime of the targets (the timers of the collected ones are cancelled).
+     * @param drone_pos Drone positions {x(t-1), y(t-1), x(t), y(t)}, updated on an obstacle hit.
+     * @param x0 Position of the drone at the beginning of the frame.
+     * @param y0 Position of the drone at the beginning of the frame.
+     * @return 1 if the drone hit an obstacle, 0 otherwise.
+     */
+    // * The index works in map coordinates, the drone in world coordinates
+    const int ox = world->origin_x, oy = world->origin_y;
+    const collision_segment segment = {x0 - ox, y0 - oy, drone_pos[2] - ox, drone_pos[3] - oy};
+    collision_result result;
+    // * Repeat while the query is truncated so that no target on the path is missed
+    do {
+        collision_query(index, &segment, &result);
+        for (int i = 0; i < result.num_targets; i++) {
+            const collision_entity *target = &index->entities[result.targets[i]];
+            occupancy_remove_target(world, target->x, target->y);
+            autopilot_record(world, target->x, target->y, AUTOPILOT_FREE);
+            if (chunks) {
+                chunk_world_remove_target(chunks, ox + target->x, oy + target->y);
+            }
+            timer_wheel_cancel(timers, target->tag);
+            collision_index_remove(index, result.targets[i]);
+        }
+    } while (result.truncated);
+    if (result.obstacle == -1) {
+        return 0;
+    }
+    // * Step back half a cell from the hit point along the segment
+    const int dx = segment.x1 - segment.x0, dy = segment.y1 - segment.y0;
+    const int steps = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+    double t_stop = result.t_obstacle - 0.5 / steps;
+    if (t_stop < 0.0) t_stop = 0.0;
+    int stop_x = (int)lround(segment.x0 + t_stop * dx);
+    int stop_y = (int)lround(segment.y0 + t_stop * dy);
+    const collision_entity *obstacle = &index->entities[result.obstacle];
+    if (stop_x == obstacle->x && stop_y == obstacle->y) {
+        stop_x = segment.x0;
+        stop_y = segment.y0;
+    }
+    drone_pos[0] = drone_pos[2] = ox + stop_x;
+    drone_pos[1] = drone_pos[3] = oy + stop_y;
+    return 1;
+}
+
+static void draw_drone(WINDOW *win, const occupancy_map *world, const int height, const int width, const int x,
+    const int y, const char *glyph) {
+    /*
+     * Draw the drone (or erase it with " ") at a world position, scaled like draw_world.
+     * @param world Game map, its origin is subtracted from the position.
+     */
+    wattron(win, COLOR_PAIR(1)); // * BLUE for drone
+    mvwprintw(win, (y - world->origin_y) * height / world->height, (x - world->origin_x) * width / world->width, "%s",
+        glyph);
+    wattroff(win, COLOR_PAIR(1));
+}
+
+static int generate_map(const generator_pipes *pipes, const int type, const int tile_x, const int tile_y,
+    const uint64_t seed, const int round, occupancy_map *map) {
+    /*
+     * Ask the generators for a whole map (GEN_MAP) or for one tile (GEN_TILE): the obstacles first, then the
+     * targets on top of them.
+     * @param round Round of the game, the maps of the next rounds are generated ahead of time.
+     * @param map Filled with the obstacles and the targets.
+     * @return 0 on success, -1 on failure.
+     */
+    const generator_request request = {type, tile_x, tile_y, round, seed};
+    return complete_map(pipes, &request, 0, map);
+}
+
+static int map_stage(const generator_pipes *pipes, const generator_request *request, const int stage,
+    occupancy_map *map) {
+    /*
+     * One step of the generation of a map, so that the blackboard can work between the steps: 0 asks the obstacles
+     * generator, 1 reads the obstacles and hands them to the targets generator, 2 reads the complete map.
+     * @return The next step, 0 once the map is complete, -1 on failure.
+     */
+    switch (stage) {
+        case 0:
+            return channel_write(pipes->obstacle_write, request, sizeof(*request)) == -1 ? -1 : 1;
+        case 1:
+            return occupancy_read(pipes->obstacle_read, map) == -1 ||
+                channel_write(pipes->target_write, request, sizeof(*request)) == -1 ||
+                occupancy_write(pipes->target_write, map) == -1 ? -1 : 2;
+        case 2:
+            return occupancy_read(pipes->target_read, map) == -1 ? -1 : 0;
+        default:
+            return -1;
+    }
+}
+
+static int complete_map(const generator_pipes *pipes, const generator_request *request, int stage, occupancy_map *map) {
+    /*
+     * Run the steps of map_stage left from `stage` to the complete map.
+     * @return 0 on success, -1 on failure (also when `stage` is a failed step).
+     */
+    // * A large map keeps the generators busy for a while: the blackboard waits for them, it is not stalled
+    heartbeat_wait();
+    do {
+        stage = map_stage(pipes, request, stage, map);
+    } while (stage > 0);
+    heartbeat_beat();
+    return stage;
 }
 
-void remove_target_on_path(char grid[GAME_HEIGHT][GAME_WIDTH], int x0, int y0, int x1, int y1) {
-    // * To see more about this -> "https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm"
-    // * Compute the directions
-    int dx = abs(x1 - x0);
-    int sx = (x0 < x1) ? 1 : -1;
-    int dy = -abs(y1 - y0);
-    int sy = (y0 < y1) ? 1 : -1;
-    // * Starting Bresenham's error
-    int err = dx + dy;
-    while (1) {
-        // * REmove the target if it is inside the grid
-        if (x0 >= 0 && x0 < GAME_WIDTH && y0 >= 0 && y0 < GAME_HEIGHT) {
-            if (strchr("0123456789", grid[y0][x0]) != NULL) {
-                grid[y0][x0] = ' ';
+static int load_map(const generator_pipes *pipes, const char *path, const uint64_t seed, occupancy_map *map) {
+    /*
+     * Map a map file in place of a generated map, and have both generators map it too (GEN_LOAD) so that the
+     * moves and the respawns start from it.
+     * @param map Replaced by the map of the file, its origin is reset (a saved view becomes a whole map).
+     * @return 0 on success, -1 on failure.
+     */
+    if (map_file_load(path, map) == -1) {
+        return -1;
+    }
+    map->origin_x = 0;
+    map->origin_y = 0;
+    const int32_t length = (int32_t)strlen(path);
+    const generator_request request = {GEN_LOAD, 0, 0, length, seed};
+    channel *const ends[2][2] = {{pipes->obstacle_write, pipes->obstacle_read},
+        {pipes->target_write, pipes->target_read}};
+    for (int i = 0; i < 2; i++) {
+        int32_t status;
+        if (channel_write(ends[i][0], &request, sizeof(request)) == -1 ||
+            channel_write(ends[i][0], path, length) == -1 || channel_read(ends[i][1], &status, sizeof(status)) == -1) {
+            return -1;
+        }
+        if (status != 0) {
+            errno = EPROTO;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int respawn_targets(const generator_pipes *pipes, const int count, occupancy_map *world, collision_index *index,
+    timer_wheel *timers, const uint64_t now) {
+    /*
+     * Ask the targets generator for a batch of new targets and add them to the map and to the index.
+     * @param count Number of targets requested (fewer arrive if the map is full).
+     * @param timers Wheel where the lifetime of the new targets starts at the tick now.
+     * @return 0 on success, -1 on failure.
+     */
+    const generator_request request = {GEN_RESPAWN, 0, 0, count, 0};
+    int32_t size;
+    if (channel_write(pipes->target_write, &request, sizeof(request)) == -1 ||
+        channel_read(pipes->target_read, &size, sizeof(size)) == -1) {
+        return -1;
+    }
+    if (size < 0 || size > count) {
+        errno = EPROTO;
+        return -1;
+    }
+    occupancy_target batch[size > 0 ? size : 1];
+    if (channel_read(pipes->target_read, batch, size * sizeof(occupancy_target)) == -1) {
+        return -1;
+    }
+    // * The targets generator does not see the obstacles move: drop a target placed under one
+    int kept = 0;
+    for (int i = 0; i < size; i++) {
+        if (!occupancy_test(world, world->obstacles, batch[i].cell % world->width, batch[i].cell / world->width)) {
+            batch[kept++] = batch[i];
+        }
+    }
+    size = kept;
+    for (int i = 0; i < size; i++) {
+        const int id = collision_index_insert(index, batch[i].cell % world->width, batch[i].cell / world->width,
+            batch[i].id);
+        if (id == -1 || schedule_target(timers, index, id, now) == -1) {
+            return -1;
+        }
+        autopilot_record(world, batch[i].cell % world->width, batch[i].cell / world->width, AUTOPILOT_TARGET);
+    }
+    return occupancy_add_targets(world, batch, size);
+}
+
+static int load_view(const generator_pipes *pipes, const uint64_t seed, const int round, chunk_world *chunks,
+    const int drone_x, const int drone_y, occupancy_map *world, collision_index *index) {
+    /*
+     * Make the tiles around the drone resident, generating the missing ones, and rebuild the view and its index.
+     * The tiles farthest from the drone are evicted when the cache is full: their targets come back if the drone
+     * returns there, because a tile is regenerated identically from the seed.
+     * @param round Round of the game, part of the seed of the tiles.
+     * @param drone_x, drone_y Drone position in the world.
+     * @param world Replaced by the view of the (2*CHUNK_VIEW_RADIUS+1)^2 tiles centred on the drone's tile.
+     * @param index Rebuilt for the new view.
+     * @return 0 on success, -1 on failure.
+     */
+    const int tile_x = chunk_tile_of(drone_x), tile_y = chunk_tile_of(drone_y);
+    for (int ty = tile_y - CHUNK_VIEW_RADIUS; ty <= tile_y + CHUNK_VIEW_RADIUS; ty++) {
+        for (int tx = tile_x - CHUNK_VIEW_RADIUS; tx <= tile_x + CHUNK_VIEW_RADIUS; tx++) {
+            if (tx < 0 || ty < 0 || tx * CHUNK_SIZE >= CHUNKED_WORLD_SIDE || ty * CHUNK_SIZE >= CHUNKED_WORLD_SIDE ||
+                chunk_world_find(chunks, tx, ty)) {
+                continue;
+            }
+            occupancy_map *tile = chunk_world_reserve(chunks, tx, ty, tile_x, tile_y);
+            if (!tile || generate_map(pipes, GEN_TILE, tx, ty, seed, round, tile) == -1) {
+                return -1;
             }
         }
-        // * Stop when it is reached the last point (x1, y1)
-        if (x0 == x1 && y0 == y1) {
-            break;
+    }
+    const int side = (2 * CHUNK_VIEW_RADIUS + 1) * CHUNK_SIZE;
+    if (chunk_world_window(chunks, (tile_x - CHUNK_VIEW_RADIUS) * CHUNK_SIZE, (tile_y - CHUNK_VIEW_RADIUS) * CHUNK_SIZE,
+        side, side, world) == -1) {
+        return -1;
+    }
+    return collision_index_build(index, world);
+}
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static int schedule_target(timer_wheel *timers, collision_index *index, const int id, const uint64_t now) {
+    /*
+     * Start the lifetime of a target; the timer is kept in the tag of its entity to cancel it on pickup.
+     * @return 0 on success, -1 on failure.
+     */
+    const timer_event event = {EVENT_TARGET_EXPIRE, id, index->entities[id].generation};
+    index->entities[id].tag = timer_wheel_schedule(timers, now + (uint64_t)(TARGET_LIFETIME * FRAME_RATE), event);
+    return index->entities[id].tag == -1 ? -1 : 0;
+}
+
+static int run_events(timer_wheel *timers, const uint64_t now, occupancy_map *world, collision_index *index,
+    rng_state *rng, const int drone_pos[4], int *count_obstacles, int *expired) {
+    /*
+     * Apply the world events due up to the tick now. Only the entities named by the events are touched.
+     * @param rng Random stream used to place the temporary obstacles.
+     * @param drone_pos Drone positions, temporary obstacles do not appear next to the drone.
+     * @param count_obstacles Number of obstacles for the score, updated.
+     * @param expired Number of targets expired, to respawn (the caller asks the targets generator).
+     * @return Number of entities removed from the map (their cells must be redrawn), -1 on failure.
+     */
+    timer_event fired[64];
+    int n, removed = 0;
+    *expired = 0;
+    do {
+        n = timer_wheel_advance(timers, now, fired, 64);
+        for (int i = 0; i < n; i++) {
+            const timer_event *event = &fired[i];
+            collision_entity *entity = event->a >= 0 ? &index->entities[event->a] : NULL;
+            // * Already collected, its id may hold another entity by now
+            if (entity && !collision_index_live(index, event->a, event->b)) continue;
+            switch (event->kind) {
+                case EVENT_TARGET_EXPIRE:
+                    occupancy_remove_target(world, entity->x, entity->y);
+                    autopilot_record(world, entity->x, entity->y, AUTOPILOT_FREE);
+                    collision_index_remove(index, event->a);
+                    removed++;
+                    (*expired)++;
+                    break;
+                case EVENT_OBSTACLE_SPAWN: {
+                    // * A few random attempts on a free cell away from the drone, the spawn is skipped otherwise
+                    for (int attempt = 0; attempt < 16; attempt++) {
+                        const int x = 1 + (int)rng_range(rng, world->width - 2);
+                        const int y = 1 + (int)rng_range(rng, world->height - 2);
+                        if (abs(x - drone_pos[2]) <= 2 && abs(y - drone_pos[3]) <= 2) continue;
+                        if (occupancy_test(world, world->obstacles, x, y) ||
+                            occupancy_test(world, world->targets, x, y)) continue;
+                        const int id = collision_index_insert(index, x, y, 'o');
+                        if (id == -1) {
+                            return -1;
+                        }
+                        const timer_event expire = {EVENT_OBSTACLE_EXPIRE, id, index->entities[id].generation};
+                        if (timer_wheel_schedule(timers, now + (uint64_t)(TEMP_OBSTACLE_LIFETIME *
+                            FRAME_RATE), expire) == -1) {
+                            return -1;
+                        }
+                        occupancy_set(world, world->obstacles, x, y);
+                        autopilot_record(world, x, y, AUTOPILOT_OBSTACLE);
+                        (*count_obstacles)++;
+                        break;
+                    }
+                    const timer_event next = {EVENT_OBSTACLE_SPAWN, -1, 0};
+                    if (timer_wheel_schedule(timers, now + (uint64_t)(TEMP_OBSTACLE_PERIOD * FRAME_RATE), next) == -1) {
+                        return -1;
+                    }
+                    break;
+                }
+                case EVENT_OBSTACLE_EXPIRE:
+                    occupancy_reset(world, world->obstacles, entity->x, entity->y);
+                    autopilot_record(world, entity->x, entity->y, AUTOPILOT_FREE);
+                    collision_index_remove(index, event->a);
+                    (*count_obstacles)--;
+                    removed++;
+                    break;
+                default: break;
+            }
+        }
+    } while (n == 64);
+    return removed;
+}
+
+static int track_obstacles(const collision_index *index, int **entities, int *count) {
+    /*
+     * List the obstacle entities of a freshly built index: they were inserted in row-major order, which is the order
+     * of the obstacle ids used by the move events of the generator.
+     * @param entities Filled with the collision entity of each obstacle id (to free).
+     * @return 0 on success, -1 on failure.
+     */
+    *count = 0;
+    free(*entities);
+    *entities = malloc((index->num_entities ? index->num_entities : 1) * sizeof(int));
+    if (!*entities) {
+        return -1;
+    }
+    for (int id = 0; id < index->num_entities; id++) {
+        if (index->entities[id].kind == 'o') {
+            (*entities)[(*count)++] = id;
         }
-        // * Update the e2
-        int e2 = 2 * err;
-        if (e2 >= dy) {
-            err += dy;
-            x0  += sx;
+    }
+    return 0;
+}
+
+static int obstacle_stream(const generator_pipes *pipes, const int on, occupancy_map *world, collision_index *index,
+    const int *entities, const int count, const int drone_pos[4]) {
+    /*
+     * Start or stop the move events of the obstacles generator. On a stop the moves already sent are applied
+     * until the end of the stream, so that the pipe carries replies again.
+     * @return 0 on success, -1 on failure.
+     */
+    const generator_request request = {GEN_STREAM, 0, 0, on, 0};
+    if (channel_write(pipes->obstacle_write, &request, sizeof(request)) == -1) {
+        return -1;
+    }
+    if (on) {
+        return 0;
+    }
+    // * The generator may be filling its map queue, seconds on a large map, before it reads the stop: the
+    // * blackboard waits for the end of the stream, it is not stalled
+    heartbeat_wait();
+    const int moved = apply_obstacle_moves(pipes->obstacle_read, 1, world, index, entities, count, drone_pos);
+    heartbeat_beat();
+    return moved == -1 ? -1 : 0;
+}
+
+static int apply_obstacle_moves(channel *in, const int until_end, occupancy_map *world, collision_index *index,
+    const int *entities, const int count, const int drone_pos[4]) {
+    /*
+     * Read the batches of move events available on the obstacles channel and apply them to the map and to the index,
+     * one entity at a time. The blackboard stays authoritative: a step onto an occupied cell, onto the border or
+     * next to the drone is refused and the obstacle keeps its cell (later steps are applied from there).
+     * @param until_end 1 to block until the end of the stream, 0 to stop when the channel is empty.
+     * @param entities Collision entity of each obstacle id.
+     * @return Number of obstacles moved, -1 on failure.
+     */
+    int moved = 0;
+    for (;;) {
+        const long pending = channel_pending(in);
+        if (!until_end && pending <= 0) {
+            // * Readable with nothing to read: the end of the stream, the generator is gone
+            if (pending == 0 && channel_wait(in, 0) == 1 && channel_pending(in) == 0) {
+                errno = EPIPE;
+                return -1;
+            }
+            return moved;
         }
-        if (e2 <= dx) {
-            err += dx;
-            y0  += sy;
+        obstacle_moves_header header;
+        if (channel_read(in, &header, sizeof(header)) == -1) {
+            return -1;
         }
+        if (header.magic != OBSTACLE_MOVES_MAGIC || header.count > OBSTACLE_MOVES_MAX || header.count < -1) {
+            errno = EPROTO;
+            return -1;
+        }
+        if (header.count == -1) {
+            return moved;
+        }
+        obstacle_move moves[OBSTACLE_MOVES_MAX];
+        if (channel_read(in, moves, header.count * sizeof(obstacle_move)) == -1) {
+            return -1;
+        }
+        for (int i = 0; i < header.count; i++) {
+            if (moves[i].id < 0 || moves[i].id >= count) continue;
+            const collision_entity *entity = &index->entities[entities[moves[i].id]];
+            const int dx = moves[i].to % world->width - moves[i].from % world->width;
+            const int dy = moves[i].to / world->width - moves[i].from / world->width;
+            const int x = entity->x + dx, y = entity->y + dy;
+            if (abs(dx) + abs(dy) != 1 || x < 1 || x >= world->width - 1 || y < 1 || y >= world->height - 1) continue;
+            if (abs(world->origin_x + x - drone_pos[2]) <= 1 && abs(world->origin_y + y - drone_pos[3]) <= 1) continue;
+            if (occupancy_test(world, world->obstacles, x, y) || occupancy_test(world, world->targets, x, y)) continue;
+            occupancy_reset(world, world->obstacles, entity->x, entity->y);
+            occupancy_set(world, world->obstacles, x, y);
+            autopilot_record(world, entity->x, entity->y, AUTOPILOT_FREE);
+            autopilot_record(world, x, y, AUTOPILOT_OBSTACLE);
+            if (collision_index_move(index, entities[moves[i].id], x, y) == -1) {
+                return -1;
+            }
+            moved++;
+        }
+    }
+}
+
+static int generator_lost(const generator_pipes *pipes, const uint64_t seed, const int round,
+    const occupancy_map *world, const collision_index *index, int *entities, const int count, const int streaming) {
+    /*
+     * Recover from a request to a generator that failed because the generator is gone: take the one the supervisor
+     * restarted alone and give it the map being played, so that the request can be sent again.
+     * @param world Map being played, NULL when there is none to give (between two maps, chunked mode).
+     * @param index, entities, count Obstacles moved by the obstacles generator (entities is reordered for the new
+     *     one), see apply_obstacle_moves.
+     * @param streaming 1 to start the moves of the obstacles again.
+     * @return 0 if the request can be sent again, -1 otherwise (not a generator gone, or no supervisor).
+     */
+    if (errno != EPIPE || pipes->link == -1) {
+        return -1;
+    }
+    const int generator = reconnect_generator(pipes);
+    if (generator == -1) {
+        return -1;
+    }
+    // * A new generator that fails in turn is taken again on the next attempt of the request
+    if (world && resync_generator(pipes, generator, seed, round, world, index, entities, count, streaming) == -1 &&
+        errno != EPIPE) {
+        return -1;
+    }
+    char message[128];
+    snprintf(message, sizeof(message), "Blackboard: the %s generator was restarted, round %d goes on.",
+        generator == 1 ? "obstacles" : "targets", round);
+    log_write(message);
+    return 0;
+}
+
+static int reconnect_generator(const generator_pipes *pipes) {
+    /*
+     * Wait for the ends of a generator restarted alone, sent by main on the generator socket, and swap them into
+     * the channels of that generator (their descriptors do not change).
+     * @return Slot of the generator (1 obstacles, 2 targets), -1 if none arrives within SUPERVISOR_RECONNECT_MS.
+     */
+    struct pollfd link = {pipes->link, POLLIN, 0};
+    int ready;
+    heartbeat_wait();
+    do {
+        ready = poll(&link, 1, SUPERVISOR_RECONNECT_MS);
+    } while (ready == -1 && errno == EINTR);
+    heartbeat_beat();
+    if (ready <= 0) {
+        if (ready == 0) {
+            errno = ETIMEDOUT;
+        }
+        return -1;
+    }
+    supervisor_restart restarted;
+    struct iovec payload = {&restarted, sizeof(restarted)};
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message = {.msg_iov = &payload, .msg_iovlen = 1, .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf)};
+    if (recvmsg(pipes->link, &message, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(restarted)) {
+        return -1;
+    }
+    const struct cmsghdr *rights = CMSG_FIRSTHDR(&message);
+    if (!rights || rights->cmsg_level != SOL_SOCKET || rights->cmsg_type != SCM_RIGHTS ||
+        rights->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+        errno = EPROTO;
+        return -1;
+    }
+    int ends[2];
+    memcpy(ends, CMSG_DATA(rights), sizeof(ends));
+    if (restarted.component != 1 && restarted.component != 2) {
+        close(ends[0]);
+        close(ends[1]);
+        errno = EPROTO;
+        return -1;
+    }
+    channel *const read_end = restarted.component == 1 ? pipes->obstacle_read : pipes->target_read;
+    channel *const write_end = restarted.component == 1 ? pipes->obstacle_write : pipes->target_write;
+    if (channel_replace(read_end, ends[0]) == -1) {
+        close(ends[1]);
+        return -1;
+    }
+    return channel_replace(write_end, ends[1]) == -1 ? -1 : restarted.component;
+}
+
+static int resync_generator(const generator_pipes *pipes, const int generator, const uint64_t seed, const int round,
+    const occupancy_map *world, const collision_index *index, int *entities, const int count, const int streaming) {
+    /*
+     * Give a generator restarted alone the map being played (GEN_LOAD of a file in the snapshot directory).
+     * - The obstacles generator gets the obstacles it moves, and names them by rank again: entities is sorted in
+     *   row-major order to match. It keeps the game seed for the maps of the next rounds.
+     * - The targets generator gets the whole world, and draws the respawns from the seed of the round.
+     * @return 0 on success, -1 on failure.
+     */
+    const char *directory = getenv(CHECKPOINT_ENV);
+    char path[GEN_PATH_MAX];
+    if (!directory || snprintf(path, sizeof(path), "%s/%s", directory, CHECKPOINT_GENERATOR_MAP) >=
+        (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int saved;
+    if (generator == 1) {
+        // * Rank of each obstacle in the row-major order, with its entity in the low bits
+        uint64_t *keys = malloc((count ? count : 1) * sizeof(uint64_t));
+        occupancy_map obstacles;
+        memset(&obstacles, 0, sizeof(obstacles));
+        if (!keys || occupancy_init(&obstacles, world->height, world->width) == -1) {
+            free(keys);
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            const collision_entity *entity = &index->entities[entities[i]];
+            keys[i] = (uint64_t)(entity->y * world->width + entity->x) << 32 | (uint32_t)entities[i];
+            occupancy_set(&obstacles, obstacles.obstacles, entity->x, entity->y);
+        }
+        qsort(keys, count, sizeof(uint64_t), by_key);
+        for (int i = 0; i < count; i++) {
+            entities[i] = (int)(keys[i] & 0xFFFFFFFFu);
+        }
+        free(keys);
+        saved = map_file_save(path, &obstacles);
+        occupancy_free(&obstacles);
+    } else {
+        saved = map_file_save(path, world);
+    }
+    if (saved == -1) {
+        return -1;
+    }
+    const int32_t length = (int32_t)strlen(path);
+    const generator_request request = {GEN_LOAD, 0, 0, length, generator == 1 ? seed : GEN_ROUND_SEED(seed, round)};
+    channel *const write_end = generator == 1 ? pipes->obstacle_write : pipes->target_write;
+    channel *const read_end = generator == 1 ? pipes->obstacle_read : pipes->target_read;
+    int32_t status = -1;
+    const int sent = channel_write(write_end, &request, sizeof(request)) == -1 ||
+        channel_write(write_end, path, length) == -1 || channel_read(read_end, &status, sizeof(status)) == -1 ? -1 : 0;
+    const int error = errno;
+    unlink(path);
+    errno = error;
+    if (sent == -1) {
+        return -1;
+    }
+    if (status != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    const generator_request stream = {GEN_STREAM, 0, 0, 1, 0};
+    return generator == 1 && streaming ? (channel_write(write_end, &stream, sizeof(stream)) == -1 ? -1 : 0) : 0;
+}
+
+static int by_key(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void autopilot_record(const occupancy_map *world, const int x, const int y, const int state) {
+    /*
+     * Record the new state of a cell of the map for the next message to the autopilot (nothing without autopilot).
+     */
+    if (!autopilot.out || autopilot.resync) {
+        return;
+    }
+    if (autopilot.count == autopilot.capacity) {
+        const int capacity = autopilot.capacity ? 2 * autopilot.capacity : 64;
+        autopilot_change *changes = realloc(autopilot.changes, capacity * sizeof(autopilot_change));
+        if (!changes) {
+            autopilot.resync = 1;
+            return;
+        }
+        autopilot.changes = changes;
+        autopilot.capacity = capacity;
     }
-}
\ No newline at end of file
+    autopilot.changes[autopilot.count++] = (autopilot_change){y * world->width + x, state};
+}
+
+static int autopilot_send(const occupancy_map *world, const int type, const int drone_pos[4],
+    const int drone_force[2]) {
+    /*
+     * Send a message to the autopilot: the whole map (AUTOPILOT_MAP, also when a change was lost) or the changes
+     * recorded since the last message (AUTOPILOT_FRAME).
+     * @param drone_pos Drone positions, the current one is sent.
+     * @param drone_force Force of the drone set by the keys.
+     * @return 0 on success, -1 on failure.
+     */
+    const int whole_map = type == AUTOPILOT_MAP || autopilot.resync;
+    const autopilot_header header = {AUTOPILOT_MAGIC, whole_map ? AUTOPILOT_MAP : AUTOPILOT_FRAME, drone_pos[2],
+        drone_pos[3], drone_force[0], drone_force[1], whole_map ? 0 : autopilot.count};
+    const int result = channel_write(autopilot.out, &header, sizeof(header)) == -1 ||
+        (whole_map ? occupancy_write(autopilot.out, world) :
+        channel_write(autopilot.out, autopilot.changes, autopilot.count * sizeof(autopilot_change))) == -1 ? -1 : 0;
+    autopilot.count = 0;
+    autopilot.resync = 0;
+    return result;
+}
+
+static uint64_t stage_end(const int stage, const uint32_t key, const uint64_t start) {
+    /*
+     * Close a stage of the running frame: add it to its latency histogram, and record its span if the frame
+     * consumed a key (tracing on).
+     * @return The current time, the start of the next stage.
+     */
+    const uint64_t now = latency_lap(&stages[stage], start);
+    if (key) {
+        trace_record(stages[stage].name, key, start, now, 0);
+    }
+    return now;
+}
+
+static void register_metrics(channel *const ends[NUM_PIPES][2]) {
+    /*
+     * Describe the counters of the blackboard in its metrics page, in the order of their enum, then the traffic of
+     * every direction a pipe has.
+     * @param ends Reading and writing end of every channel, NULL for a direction it does not have.
+     */
+    static const char *const pipe_names[NUM_PIPES] = {
+        [PIPE_KEYBOARD] = "keyboard", [PIPE_OBSTACLES] = "obstacles", [PIPE_TARGETS] = "targets",
+        [PIPE_DYNAMICS] = "dynamics", [PIPE_AUTOPILOT] = "autopilot", [PIPE_INSPECTOR] = "inspector",
+    };
+    metrics_register(metrics, "dronegame_frames_total", "", "Running frames rendered.", METRICS_COUNTER, 1);
+    metrics_register(metrics, "dronegame_frames_missed_total", "",
+        "Running frames whose work took longer than a frame period.", METRICS_COUNTER, 1);
+    metrics_register(metrics, "dronegame_keys_received_total", "", "Keys read from the keyboard pipe.",
+        METRICS_COUNTER, 1);
+    metrics_register(metrics, "dronegame_keys_dropped_total", "", "Keys read that had no effect.", METRICS_COUNTER, 1);
+    metrics_register(metrics, "dronegame_keys_pending", "", "Keys waiting in the keyboard pipe.", METRICS_GAUGE, 1);
+    metrics_register(metrics, "dronegame_score", "", "Score of the current round.", METRICS_GAUGE, 1);
+    metrics_register(metrics, "dronegame_targets_remaining", "", "Targets left on the map.", METRICS_GAUGE, 1);
+    metrics_register(metrics, "dronegame_dynamics_resends_total", "",
+        "Frames sent again to a dynamics restarted by the supervisor.", METRICS_COUNTER, 1);
+    for (int p = 0; p < NUM_PIPES; p++) {
+        for (int k = 0; k < 4; k++) {
+            // * The inspector has no descriptor of its own: it only has the write direction
+            const int has = p == PIPE_INSPECTOR ? k % 2 == 1 : ends[p][k % 2] != NULL;
+            char labels[64];
+            snprintf(labels, sizeof(labels), "pipe=\"%s\",direction=\"%s\"", pipe_names[p], k % 2 ? "out" : "in");
+            pipe_slots[p][k] = !has ? -1 : k < 2 ?
+                metrics_register(metrics, "dronegame_ipc_bytes_total", labels, "Bytes moved through the pipes.",
+                    METRICS_COUNTER, 1) :
+                metrics_register(metrics, "dronegame_ipc_messages_total", labels,
+                    "Messages (whole-buffer transfers) moved through the pipes.", METRICS_COUNTER, 1);
+        }
+    }
+}
+
+static void publish_metrics(channel *const ends[NUM_PIPES][2], const int score, const int targets) {
+    /*
+     * Update the gauges and the traffic of the pipes in the metrics page (relaxed stores, no system call but the
+     * count of the pending keys).
+     * @param ends Reading and writing end of every channel, as given to register_metrics.
+     */
+    static const pipe_io_stats no_traffic;
+    const long pending = channel_pending(ends[PIPE_KEYBOARD][0]);
+    metrics_set(metrics, METRIC_KEYS, keys_read);
+    metrics_set(metrics, METRIC_KEYS_PENDING, pending > 0 ? pending : 0);
+    metrics_set(metrics, METRIC_SCORE, score);
+    metrics_set(metrics, METRIC_TARGETS, targets);
+    for (int p = 0; p < NUM_PIPES; p++) {
+        const pipe_io_stats *in = ends[p][0] ? channel_stats(ends[p][0]) : &no_traffic;
+        const pipe_io_stats *out = ends[p][1] ? channel_stats(ends[p][1]) : &no_traffic;
+        uint64_t traffic[4] = {in->bytes_in, out->bytes_out, in->reads, out->writes};
+        if (p == PIPE_KEYBOARD) {
+            // * One byte per key, read directly
+            traffic[0] = traffic[2] = keys_read;
+        }
+        if (p == PIPE_INSPECTOR) {
+            traffic[1] = inspector_bytes;
+            traffic[3] = inspector_messages;
+        }
+        for (int k = 0; k < 4; k++) {
+            metrics_set(metrics, pipe_slots[p][k], (int64_t)traffic[k]);
+        }
+    }
+}
+
+static int dynamics_request(channel *out, const occupancy_map *window, const char *msg) {
+    /*
+     * Send a frame to the dynamics: the window of the map around the drone, then the drone state.
+     * @param msg Drone state, a buffer of 100 bytes.
+     * @return 0 on success, -1 on failure.
+     */
+    return occupancy_write(out, window) == -1 || channel_write(out, msg, 100) == -1 ? -1 : 0;
+}
+
+static int dynamics_reply(channel *in, channel *out, const occupancy_map *window, const char *msg,
+    const uint32_t sequence, int *x, int *y) {
+    /*
+     * Wait for the new position computed by the dynamics for a frame. A dynamics restarted alone by the supervisor
+     * lost the frame: it replies DYNAMICS_RESTARTED and the frame is sent again, and the replies to earlier frames
+     * (or to the same frame sent twice) are dropped. A slow dynamics is only waited for.
+     * @param msg Drone state of the frame, as sent with dynamics_request.
+     * @param sequence Number of the frame, echoed in the reply.
+     * @return 0 on success, -1 on failure (the dynamics closed its end of the channel).
+     */
+    for (;;) {
+        char in_buf[32];
+        uint32_t answered;
+        // * The blackboard waits for the dynamics, it is not stalled
+        heartbeat_wait();
+        const ssize_t received = channel_read(in, in_buf, sizeof(in_buf));
+        heartbeat_beat();
+        if (received == -1) {
+            return -1;
+        }
+        if (strncmp(in_buf, DYNAMICS_RESTARTED, sizeof(in_buf)) == 0) {
+            metrics_add(metrics, METRIC_DYNAMICS_RESENDS, 1);
+            if (dynamics_request(out, window, msg) == -1) {
+                return -1;
+            }
+            continue;
+        }
+        if (sscanf(in_buf, "%d,%d,%u", x, y, &answered) != 3) {
+            errno = EPROTO;
+            return -1;
+        }
+        if (answered == sequence) {
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+//
+// Created by Gian Marco Balia
+//
+// src/blue_noise.c
+#include <stdlib.h>
+#include <math.h>
+#include "blue_noise.h"
+
+typedef struct {
+    int x, y; // * Accepted point of the stratum, x = -1 if the stratum is empty
+} stratum_point;
+
+long blue_noise_place(const occupancy_map *map, uint64_t *layer, const blue_noise_params *params, rng_state *rng) {
+    /*
+     * Set the bits of a blue-noise set of cells in a rectangle of a layer.
+     * @param map Map owning the layer.
+     * @param layer Layer to fill (the bits already set are kept, but not used for the spacing).
+     * @param params Rectangle, density and minimum spacing.
+     * @param rng Random stream.
+     * @return Number of cells set, -1 on failure.
+     */
+    if (params->height <= 0 || params->width <= 0 || params->density <= 0.0) {
+        return 0;
+    }
+    const double density = params->density > 1.0 ? 1.0 : params->density;
+    // * Number of strata per axis so that the strata count matches density * area
+    int nx = (int)lround(params->width * sqrt(density));
+    int ny = (int)lround(params->height * sqrt(density));
+    if (nx < 1) nx = 1;
+    if (ny < 1) ny = 1;
+    if (nx > params->width) nx = params->width;
+    if (ny > params->height) ny = params->height;
+    // * The spacing can not exceed the smallest stratum, otherwise the 8 neighbours would not be enough
+    int spacing = params->spacing;
+    const int min_side_x = params->width / nx, min_side_y = params->height / ny;
+    if (spacing > min_side_x) spacing = min_side_x;
+    if (spacing > min_side_y) spacing = min_side_y;
+    const long spacing2 = (long)spacing * spacing;
+
+    // * Only the previous row of strata is needed to check the spacing: keep two rows
+    stratum_point *rows = malloc(2 * (size_t)nx * sizeof(stratum_point));
+    if (!rows) {
+        return -1;
+    }
+    long placed = 0;
+    for (int j = 0; j < ny; j++) {
+        stratum_point *row = &rows[(long)(j % 2) * nx], *previous = &rows[(long)((j + 1) % 2) * nx];
+        const int ys = (int)((long)j * params->height / ny), ye = (int)((long)(j + 1) * params->height / ny);
+        for (int i = 0; i < nx; i++) {
+            const int xs = (int)((long)i * params->width / nx), xe = (int)((long)(i + 1) * params->width / nx);
+            stratum_point *point = &row[i];
+            point->x = -1;
+            for (int attempt = 0; attempt < BLUE_NOISE_ATTEMPTS; attempt++) {
+                const int x = xs + (int)rng_range(rng, xe - xs);
+                const int y = ys + (int)rng_range(rng, ye - ys);
+                // * Only the strata already visited (above and on the left) can hold a point
+                int spaced = 1;
+                for (int dj = -1; dj <= 0 && spaced; dj++) {
+                    for (int di = -1; di <= 1 && spaced; di++) {
+                        const int ni = i + di, nj = j + dj;
+                        if (ni < 0 || ni >= nx || nj < 0 || (dj == 0 && di >= 0)) continue;
+                        const stratum_point *other = dj == 0 ? &row[ni] : &previous[ni];
+                        if (other->x == -1) continue;
+                        const long ddx = x - other->x, ddy = y - other->y;
+                        spaced = ddx * ddx + ddy * ddy >= spacing2;
+                    }
+                }
+                if (spaced) {
+                    point->x = x;
+                    point->y = y;
+                    occupancy_set(map, layer, params->x0 + x, params->y0 + y);
+                    placed++;
+                    break;
+                }
+            }
+        }
+    }
+    free(rows);
+    return placed;
+}
@@ -0,0 +1,341 @@
+//
+// Created by Gian Marco Balia
+//
+// src/channel.c
+#define _GNU_SOURCE // * dup3
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include "channel.h"
+
+// * In-memory queue shared by its two ends
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // * Bytes written or read, or an end closed
+    char *buffer;
+    size_t head, count; // * Offset of the first byte, bytes buffered
+    int reader_open, writer_open;
+    int data_fd; // * eventfd of channel_fd on the reading end, -1 before its first use
+    int data_level; // * data_fd is readable
+    int closed_fd; // * eventfd of channel_fd on the writing end, -1 before its first use
+} queue;
+
+struct channel {
+    int fd; // * End of a pipe, -1 for an end of a queue
+    queue *queue;
+    int writer; // * The writing end of the queue
+    pipe_io_stats stats;
+};
+
+static channel *channel_new(int fd, queue *q, int writer);
+static void sync_data_fd(queue *q);
+
+channel *channel_from_fd(const int fd) {
+    /*
+     * Wrap an end of a pipe, which channel_close closes.
+     * @return The channel, NULL on failure (errno set).
+     */
+    return channel_new(fd, NULL, 0);
+}
+
+int channel_queue(channel *ends[2]) {
+    /*
+     * Create an in-memory queue, like pipe(): ends[0] reads what ends[1] writes.
+     * @return 0 on success, -1 on failure (errno set).
+     */
+    queue *q = calloc(1, sizeof(queue));
+    ends[0] = channel_new(-1, q, 0);
+    ends[1] = channel_new(-1, q, 1);
+    char *buffer = malloc(CHANNEL_CAPACITY);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    const int ready = q && ends[0] && ends[1] && buffer && pthread_cond_init(&q->changed, &attr) == 0;
+    pthread_condattr_destroy(&attr);
+    if (!ready) {
+        free(buffer);
+        free(ends[0]);
+        free(ends[1]);
+        free(q);
+        errno = ENOMEM;
+        return -1;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    q->buffer = buffer;
+    q->reader_open = q->writer_open = 1;
+    q->data_fd = q->closed_fd = -1;
+    return 0;
+}
+
+void channel_close(channel *ch) {
+    // * Close the end: the other one sees the end of the stream, the queue is released with its last end
+    if (!ch) {
+        return;
+    }
+    queue *q = ch->queue;
+    if (!q) {
+        close(ch->fd);
+        free(ch);
+        return;
+    }
+    pthread_mutex_lock(&q->lock);
+    if (ch->writer) {
+        q->writer_open = 0;
+        sync_data_fd(q);
+    } else {
+        // * As for a pipe, the bytes nobody will read are dropped and the writer fails from now on
+        q->reader_open = 0;
+        q->count = 0;
+        if (q->closed_fd != -1) {
+            eventfd_write(q->closed_fd, 1);
+        }
+    }
+    pthread_cond_broadcast(&q->changed);
+    const int last = !q->reader_open && !q->writer_open;
+    pthread_mutex_unlock(&q->lock);
+    free(ch);
+    if (last) {
+        if (q->data_fd != -1) {
+            close(q->data_fd);
+        }
+        if (q->closed_fd != -1) {
+            close(q->closed_fd);
+        }
+        pthread_cond_destroy(&q->changed);
+        pthread_mutex_destroy(&q->lock);
+        free(q->buffer);
+        free(q);
+    }
+}
+
+ssize_t channel_read(channel *ch, void *buf, const size_t size) {
+    /*
+     * Read exactly size bytes, blocking until they have all arrived.
+     * @return size on success, -1 on failure (EPIPE: the writer closed before the end of the transfer).
+     */
+    queue *q = ch->queue;
+    if (!q) {
+        if (read_full(ch->fd, buf, size) == -1) {
+            return -1;
+        }
+    } else {
+        pthread_mutex_lock(&q->lock);
+        size_t done = 0;
+        while (done < size) {
+            if (q->count == 0) {
+                if (!q->writer_open) {
+                    break;
+                }
+                pthread_cond_wait(&q->changed, &q->lock);
+                continue;
+            }
+            // * At most two copies: up to the end of the ring, then from its start
+            size_t n = size - done < q->count ? size - done : q->count;
+            if (n > CHANNEL_CAPACITY - q->head) {
+                n = CHANNEL_CAPACITY - q->head;
+            }
+            memcpy((char *)buf + done, q->buffer + q->head, n);
+            q->head = (q->head + n) % CHANNEL_CAPACITY;
+            q->count -= n;
+            done += n;
+            pthread_cond_broadcast(&q->changed);
+        }
+        sync_data_fd(q);
+        pthread_mutex_unlock(&q->lock);
+        if (done < size) {
+            errno = EPIPE;
+            return -1;
+        }
+    }
+    ch->stats.bytes_in += size;
+    ch->stats.reads++;
+    return (ssize_t)size;
+}
+
+ssize_t channel_write(channel *ch, const void *buf, const size_t size) {
+    /*
+     * Write exactly size bytes, blocking while the queue is full.
+     * @return size on success, -1 on failure (EPIPE: the reader is closed).
+     */
+    queue *q = ch->queue;
+    if (!q) {
+        if (write_full(ch->fd, buf, size) == -1) {
+            return -1;
+        }
+    } else {
+        pthread_mutex_lock(&q->lock);
+        size_t done = 0;
+        while (done < size && q->reader_open) {
+            if (q->count == CHANNEL_CAPACITY) {
+                pthread_cond_wait(&q->changed, &q->lock);
+                continue;
+            }
+            const size_t tail = (q->head + q->count) % CHANNEL_CAPACITY;
+            size_t n = size - done < CHANNEL_CAPACITY - q->count ? size - done : CHANNEL_CAPACITY - q->count;
+            if (n > CHANNEL_CAPACITY - tail) {
+                n = CHANNEL_CAPACITY - tail;
+            }
+            memcpy(q->buffer + tail, (const char *)buf + done, n);
+            q->count += n;
+            done += n;
+            pthread_cond_broadcast(&q->changed);
+        }
+        sync_data_fd(q);
+        pthread_mutex_unlock(&q->lock);
+        if (done < size) {
+            errno = EPIPE;
+            return -1;
+        }
+    }
+    ch->stats.bytes_out += size;
+    ch->stats.writes++;
+    return (ssize_t)size;
+}
+
+int channel_wait(channel *ch, const int timeout_ms) {
+    /*
+     * Wait until the reading end has data or is at the end of the stream.
+     * @param timeout_ms Longest wait, -1 without limit.
+     * @return 1 when a read would not block, 0 on timeout, -1 on failure (EINTR: interrupted by a signal).
+     */
+    queue *q = ch->queue;
+    if (!q) {
+        struct pollfd pfd = {ch->fd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, timeout_ms);
+        return ready > 0 ? 1 : ready;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&q->lock);
+    int expired = 0;
+    while (q->count == 0 && q->writer_open && !expired) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        } else {
+            expired = pthread_cond_timedwait(&q->changed, &q->lock, &deadline) == ETIMEDOUT;
+        }
+    }
+    const int ready = q->count > 0 || !q->writer_open;
+    pthread_mutex_unlock(&q->lock);
+    return ready;
+}
+
+long channel_pending(channel *ch) {
+    // * Bytes that a read would get without waiting, -1 on failure
+    queue *q = ch->queue;
+    if (!q) {
+        int pending = 0;
+        return ioctl(ch->fd, FIONREAD, &pending) == -1 ? -1 : pending;
+    }
+    pthread_mutex_lock(&q->lock);
+    const long pending = (long)q->count;
+    pthread_mutex_unlock(&q->lock);
+    return pending;
+}
+
+void channel_drain(channel *ch) {
+    // * Discard what the reading end holds, without waiting
+    queue *q = ch->queue;
+    if (!q) {
+        const int flags = fcntl(ch->fd, F_GETFL);
+        fcntl(ch->fd, F_SETFL, flags | O_NONBLOCK);
+        char buf[4096];
+        while (read(ch->fd, buf, sizeof(buf)) > 0) {
+        }
+        fcntl(ch->fd, F_SETFL, flags);
+        return;
+    }
+    pthread_mutex_lock(&q->lock);
+    q->head = q->count = 0;
+    sync_data_fd(q);
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+}
+
+int channel_replace(channel *ch, const int fd) {
+    /*
+     * Move the end of a pipe onto the descriptor of the channel, in place of the end it wrapped (a component
+     * restarted on new pipes): the descriptor number stays the same, so a wait on channel_fd still holds.
+     * @param fd New end, closed by the call.
+     * @return 0 on success, -1 on failure (EINVAL for an end of a queue).
+     */
+    if (ch->queue) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    const int result = dup3(fd, ch->fd, O_CLOEXEC);
+    close(fd);
+    return result == -1 ? -1 : 0;
+}
+
+int channel_fd(channel *ch) {
+    /*
+     * Descriptor to wait for the end with poll() or select(), owned by the channel.
+     * @return The descriptor, -1 on failure (errno set).
+     */
+    queue *q = ch->queue;
+    if (!q) {
+        return ch->fd;
+    }
+    pthread_mutex_lock(&q->lock);
+    int fd;
+    if (ch->writer) {
+        if (q->closed_fd == -1) {
+            q->closed_fd = eventfd(q->reader_open ? 0 : 1, EFD_CLOEXEC | EFD_NONBLOCK);
+        }
+        fd = q->closed_fd;
+    } else {
+        if (q->data_fd == -1) {
+            q->data_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            q->data_level = 0;
+            sync_data_fd(q);
+        }
+        fd = q->data_fd;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return fd;
+}
+
+const pipe_io_stats *channel_stats(const channel *ch) {
+    // * Traffic of the end since its creation
+    return &ch->stats;
+}
+
+static channel *channel_new(const int fd, queue *q, const int writer) {
+    channel *ch = calloc(1, sizeof(channel));
+    if (ch) {
+        ch->fd = fd;
+        ch->queue = q;
+        ch->writer = writer;
+    }
+    return ch;
+}
+
+static void sync_data_fd(queue *q) {
+    // * Keep the eventfd of the reading end readable exactly while a read would not block (lock held)
+    if (q->data_fd == -1) {
+        return;
+    }
+    const int level = q->count > 0 || !q->writer_open;
+    eventfd_t value;
+    if (level && !q->data_level) {
+        eventfd_write(q->data_fd, 1);
+    } else if (!level && q->data_level) {
+        eventfd_read(q->data_fd, &value);
+    }
+    q->data_level = level;
+}
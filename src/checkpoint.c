@@ -0,0 +1,176 @@
+//
+// Created by Gian Marco Balia
+//
+// src/checkpoint.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "checkpoint.h"
+#include "map_file.h"
+
+// * State file of this process and its directory, NULL before checkpoint_open or without a directory
+static checkpoint_page *page = NULL;
+static const char *directory = NULL;
+// * Process writing the last snapshot, -1 when none runs
+static pid_t saver = -1;
+
+static void slot_path(char *path, size_t size, const char *dir, int slot);
+
+int checkpoint_open(void) {
+    /*
+     * Map the state file of the directory given in the environment, creating it empty the first time.
+     * @return 0 on success or without a directory (nothing is saved), -1 on failure.
+     */
+    const char *dir = getenv(CHECKPOINT_ENV);
+    if (!dir) {
+        return 0;
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/state", dir);
+    const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    // * Growing a file keeps its content and zeroes the new bytes: a new file has no snapshot (magic 0)
+    if (ftruncate(fd, sizeof(checkpoint_page)) == -1) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, sizeof(checkpoint_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    page = map;
+    directory = dir;
+    return 0;
+}
+
+void checkpoint_close(void) {
+    // * The files stay for the next blackboard, main removes them at the end of the game: let the saver publish its
+    // * snapshot first
+    if (saver != -1) {
+        waitpid(saver, NULL, 0);
+        saver = -1;
+    }
+    if (page) {
+        munmap(page, sizeof(checkpoint_page));
+        page = NULL;
+    }
+}
+
+int checkpoint_save(const occupancy_map *world, const checkpoint_state *state) {
+    /*
+     * Fork a saver that writes a snapshot into the slot that does not hold the last one, then publishes it. The fork
+     * has its own copy of the world: the frame goes on while the map is written.
+     * @return 0 on success, without a directory or while the last saver still runs (the period is skipped), -1 on
+     * failure (the last snapshot is still whole).
+     */
+    if (!page) {
+        return 0;
+    }
+    if (saver != -1) {
+        const pid_t done = waitpid(saver, NULL, WNOHANG);
+        if (done == 0) {
+            return 0;
+        }
+        saver = -1;
+    }
+    // * Only savers change the slot, and one runs at a time. The blackboard forks as a single-threaded process: the
+    // * supervisor, and so the directory, is not available in the threaded build
+    const int slot = page->magic == CHECKPOINT_MAGIC ?
+        1 - atomic_load_explicit(&page->slot, memory_order_relaxed) : 0;
+    const pid_t parent = getpid();
+    const pid_t pid = fork();
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid > 0) {
+        saver = pid;
+        return 0;
+    }
+    // * Saver: a snapshot of a blackboard that died is not published, its replacement saves its own
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) {
+        _exit(EXIT_FAILURE);
+    }
+    char path[4096];
+    slot_path(path, sizeof(path), directory, slot);
+    if (map_file_save(path, world) == -1) {
+        perror("checkpoint");
+        _exit(EXIT_FAILURE);
+    }
+    page->states[slot] = *state;
+    atomic_store_explicit(&page->slot, slot, memory_order_release);
+    page->magic = CHECKPOINT_MAGIC;
+    // * _exit: the exit handlers of the blackboard (the window) are not the saver's to run
+    _exit(EXIT_SUCCESS);
+}
+
+void checkpoint_track(const checkpoint_state *state) {
+    // * Record of the last frame, written in the slot that does not hold the previous one
+    if (!page) {
+        return;
+    }
+    const int slot = page->frame_magic == CHECKPOINT_FRAME_MAGIC ?
+        1 - atomic_load_explicit(&page->frame_slot, memory_order_relaxed) : 0;
+    page->frames[slot] = *state;
+    atomic_store_explicit(&page->frame_slot, slot, memory_order_release);
+    page->frame_magic = CHECKPOINT_FRAME_MAGIC;
+}
+
+int checkpoint_restore(checkpoint_state *state, char *map_path, const size_t size) {
+    /*
+     * Last snapshot left by a previous blackboard.
+     * @param map_path Filled with the map file of the snapshot, to be loaded with load_map.
+     * @return 1 if there is one, 0 if there is none (first start, or no directory).
+     */
+    if (!page || page->magic != CHECKPOINT_MAGIC) {
+        return 0;
+    }
+    const int slot = atomic_load_explicit(&page->slot, memory_order_acquire);
+    *state = page->states[slot];
+    slot_path(map_path, size, directory, slot);
+    return 1;
+}
+
+int checkpoint_last_frame(checkpoint_state *state) {
+    /*
+     * Last frame record left by a previous blackboard, at most one frame older than its end.
+     * @return 1 if there is one, 0 if there is none (it can be older than the snapshot, or of another round).
+     */
+    if (!page || page->frame_magic != CHECKPOINT_FRAME_MAGIC) {
+        return 0;
+    }
+    *state = page->frames[atomic_load_explicit(&page->frame_slot, memory_order_acquire)];
+    return 1;
+}
+
+void checkpoint_remove(const char *dir) {
+    // * Remove the files of a directory and the directory (main, at the end of the game)
+    char path[4096];
+    for (int slot = 0; slot < 2; slot++) {
+        slot_path(path, sizeof(path), dir, slot);
+        unlink(path);
+        // * Left by a save interrupted before its rename
+        snprintf(path + strlen(path), sizeof(path) - strlen(path), ".tmp");
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, CHECKPOINT_GENERATOR_MAP);
+    unlink(path);
+    snprintf(path + strlen(path), sizeof(path) - strlen(path), ".tmp");
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/state", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+static void slot_path(char *path, const size_t size, const char *dir, const int slot) {
+    snprintf(path, size, "%s/world.%d.dgm", dir, slot);
+}
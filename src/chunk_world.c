@@ -0,0 +1,159 @@
+//
+// Created by Gian Marco Balia
+//
+// src/chunk_world.c
+#include <stdlib.h>
+#include <string.h>
+#include "chunk_world.h"
+#include "macros.h"
+
+static int tile_distance(const chunk_slot *slot, int center_x, int center_y);
+
+int chunk_world_init(chunk_world *world, const int capacity) {
+    /*
+     * Allocate an empty cache.
+     * @param world Cache to initialise.
+     * @param capacity Maximum number of resident tiles.
+     * @return 0 on success, -1 on failure.
+     */
+    memset(world, 0, sizeof(*world));
+    world->slots = calloc(capacity, sizeof(chunk_slot));
+    if (!world->slots) {
+        return -1;
+    }
+    world->capacity = capacity;
+    return 0;
+}
+
+void chunk_world_free(chunk_world *world) {
+    if (world->slots) {
+        for (int i = 0; i < world->capacity; i++) {
+            occupancy_free(&world->slots[i].tile);
+        }
+    }
+    free(world->slots);
+    memset(world, 0, sizeof(*world));
+}
+
+occupancy_map *chunk_world_find(chunk_world *world, const int tile_x, const int tile_y) {
+    /*
+     * @return The resident tile (tile_x, tile_y), NULL if it is not loaded.
+     */
+    // * The cache is a few tens of slots: a linear scan is cheaper than hashing
+    for (int i = 0; i < world->capacity; i++) {
+        const chunk_slot *slot = &world->slots[i];
+        if (slot->used && slot->tile_x == tile_x && slot->tile_y == tile_y) {
+            return &world->slots[i].tile;
+        }
+    }
+    return NULL;
+}
+
+occupancy_map *chunk_world_reserve(chunk_world *world, const int tile_x, const int tile_y, const int center_x,
+    const int center_y) {
+    /*
+     * Get a slot for the tile (tile_x, tile_y), evicting the tile farthest from (center_x, center_y) if the cache
+     * is full. The caller fills the returned map (e.g. with occupancy_read).
+     * @return The map of the slot, NULL on failure.
+     */
+    int free_slot = -1, farthest = -1;
+    for (int i = 0; i < world->capacity; i++) {
+        if (!world->slots[i].used) {
+            free_slot = i;
+            break;
+        }
+        if (farthest == -1 || tile_distance(&world->slots[i], center_x, center_y) >
+            tile_distance(&world->slots[farthest], center_x, center_y)) {
+            farthest = i;
+        }
+    }
+    if (free_slot == -1) {
+        free_slot = farthest;
+        world->resident--;
+    }
+    if (free_slot == -1) {
+        return NULL;
+    }
+    chunk_slot *slot = &world->slots[free_slot];
+    if (slot->tile.height != CHUNK_SIZE || slot->tile.width != CHUNK_SIZE) {
+        occupancy_free(&slot->tile);
+        if (occupancy_init(&slot->tile, CHUNK_SIZE, CHUNK_SIZE) == -1) {
+            slot->used = 0;
+            return NULL;
+        }
+    }
+    slot->used = 1;
+    slot->tile_x = tile_x;
+    slot->tile_y = tile_y;
+    world->resident++;
+    return &slot->tile;
+}
+
+int chunk_world_window(const chunk_world *world, const int x0, const int y0, const int height, const int width,
+    occupancy_map *window) {
+    /*
+     * Compose the rectangle [x0, x0+width) x [y0, y0+height) of the world from the resident tiles.
+     * Cells of tiles that are not loaded are empty. Target labels are copied.
+     * @param window Destination, (re)allocated if its size differs. Its origin is set to (x0, y0).
+     * @return 0 on success, -1 on failure.
+     */
+    if (window->height != height || window->width != width || !window->obstacles) {
+        occupancy_free(window);
+        if (occupancy_init(window, height, width) == -1) {
+            return -1;
+        }
+    } else {
+        occupancy_clear(window);
+    }
+    window->origin_x = x0;
+    window->origin_y = y0;
+    for (int i = 0; i < world->capacity; i++) {
+        const chunk_slot *slot = &world->slots[i];
+        if (!slot->used) continue;
+        const occupancy_map *tile = &slot->tile;
+        for (int row = 0; row < tile->height; row++) {
+            const int y = tile->origin_y + row - y0;
+            if (y < 0 || y >= height) continue;
+            for (int w = 0; w < tile->words_per_row; w++) {
+                const long word = (long)row * tile->words_per_row + w;
+                uint64_t bits = tile->obstacles[word] | tile->targets[word];
+                while (bits) {
+                    const int col = 64 * w + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    const int x = tile->origin_x + col - x0;
+                    if (x < 0 || x >= width) continue;
+                    if (tile->obstacles[word] >> (col % 64) & 1) {
+                        occupancy_set(window, window->obstacles, x, y);
+                    } else if (occupancy_add_target(window, x, y, occupancy_target_id(tile, col, row)) == -1) {
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int chunk_world_remove_target(chunk_world *world, const int x, const int y) {
+    /*
+     * Remove the target at the world cell (x, y) from its resident tile.
+     * @return 1 if a target was removed, 0 otherwise.
+     */
+    occupancy_map *tile = chunk_world_find(world, chunk_tile_of(x), chunk_tile_of(y));
+    if (!tile) {
+        return 0;
+    }
+    return occupancy_remove_target(tile, x - tile->origin_x, y - tile->origin_y);
+}
+
+int chunk_tile_of(const int position) {
+    /*
+     * @return Index of the tile containing a world coordinate (rounded towards minus infinity).
+     */
+    return position >= 0 ? position / CHUNK_SIZE : -((-position + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+static int tile_distance(const chunk_slot *slot, const int center_x, const int center_y) {
+    const int dx = abs(slot->tile_x - center_x), dy = abs(slot->tile_y - center_y);
+    return dx > dy ? dx : dy;
+}
@@ -0,0 +1,322 @@
+//
+// Created by Gian Marco Balia
+//
+// src/collision.c
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "collision.h"
+
+// * Half side of a cell: slightly less than 0.5 so that a diagonal move does not touch corner cells
+#define CELL_HALF (0.5 - 1e-6)
+
+static int bucket_push(collision_bucket *bucket, int id);
+static void bucket_pop(collision_index *index, int id);
+static int segment_hits_cell(const collision_segment *segment, int cx, int cy, double *t_hit);
+static void result_add_target(collision_result *result, int id, double t);
+
+int collision_index_init(collision_index *index, const int height, const int width) {
+    /*
+     * Initialise an empty spatial index for a map of the given size.
+     * @param index Index to initialise.
+     * @param height Map height in cells.
+     * @param width Map width in cells.
+     * @return 0 on success, -1 on failure.
+     */
+    memset(index, 0, sizeof(*index));
+    index->free_list = -1;
+    index->height = height;
+    index->width = width;
+    index->buckets_x = (width + COLLISION_BUCKET - 1) / COLLISION_BUCKET;
+    index->buckets_y = (height + COLLISION_BUCKET - 1) / COLLISION_BUCKET;
+    index->buckets = calloc((size_t)index->buckets_x * index->buckets_y, sizeof(collision_bucket));
+    if (!index->buckets) {
+        return -1;
+    }
+    return 0;
+}
+
+void collision_index_free(collision_index *index) {
+    /*
+     * Release the memory held by the index.
+     * @param index Index to release.
+     */
+    if (index->buckets) {
+        for (int i = 0; i < index->buckets_x * index->buckets_y; i++) {
+            free(index->buckets[i].items);
+        }
+    }
+    free(index->buckets);
+    free(index->entities);
+    memset(index, 0, sizeof(*index));
+    index->free_list = -1;
+}
+
+int collision_index_build(collision_index *index, const occupancy_map *map) {
+    /*
+     * Build the index from the obstacle and target layers of a map.
+     * @param index Index to fill, it is (re)initialised.
+     * @param map Map to index.
+     * @return 0 on success, -1 on failure.
+     */
+    collision_index_free(index);
+    if (collision_index_init(index, map->height, map->width) == -1) {
+        return -1;
+    }
+    for (int row = 0; row < map->height; row++) {
+        for (int w = 0; w < map->words_per_row; w++) {
+            uint64_t bits = map->obstacles[(long)row * map->words_per_row + w] |
+                map->targets[(long)row * map->words_per_row + w];
+            while (bits) {
+                const int col = 64 * w + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                const char kind = occupancy_test(map, map->obstacles, col, row) ? 'o' : occupancy_target_id(map, col, row);
+                if (collision_index_insert(index, col, row, kind) == -1) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int collision_index_insert(collision_index *index, const int x, const int y, const char kind) {
+    /*
+     * Insert an entity in the index, under the last removed id if any.
+     * @return Id of the entity, -1 on failure or if the cell is outside the map.
+     */
+    if (x < 0 || x >= index->width || y < 0 || y >= index->height) {
+        return -1;
+    }
+    const int bucket = (y / COLLISION_BUCKET) * index->buckets_x + x / COLLISION_BUCKET;
+    if (index->free_list != -1) {
+        const int id = index->free_list;
+        collision_entity *entity = &index->entities[id];
+        if (bucket_push(&index->buckets[bucket], id) == -1) {
+            return -1;
+        }
+        index->free_list = entity->slot;
+        entity->x = x;
+        entity->y = y;
+        entity->kind = kind;
+        entity->tag = -1;
+        entity->bucket = bucket;
+        entity->slot = index->buckets[bucket].count - 1;
+        return id;
+    }
+    if (index->num_entities == index->capacity_entities) {
+        const int capacity = index->capacity_entities ? 2 * index->capacity_entities : 64;
+        collision_entity *entities = realloc(index->entities, capacity * sizeof(collision_entity));
+        if (!entities) {
+            return -1;
+        }
+        index->entities = entities;
+        index->capacity_entities = capacity;
+    }
+    const int id = index->num_entities++;
+    collision_entity *entity = &index->entities[id];
+    entity->x = x;
+    entity->y = y;
+    entity->kind = kind;
+    entity->tag = -1;
+    entity->generation = 0;
+    entity->bucket = bucket;
+    entity->slot = index->buckets[bucket].count;
+    if (bucket_push(&index->buckets[entity->bucket], id) == -1) {
+        index->num_entities--;
+        return -1;
+    }
+    return id;
+}
+
+void collision_index_remove(collision_index *index, const int id) {
+    /*
+     * Remove an entity from its bucket in O(1) (swap with the last element of the bucket) and free its id.
+     * @param id Id returned by collision_index_insert or reported by a query.
+     */
+    if (id < 0 || id >= index->num_entities || index->entities[id].bucket < 0) {
+        return;
+    }
+    collision_entity *entity = &index->entities[id];
+    bucket_pop(index, id);
+    entity->bucket = -1;
+    entity->slot = index->free_list;
+    entity->generation++;
+    index->free_list = id;
+}
+
+int collision_index_live(const collision_index *index, const int id, const int generation) {
+    /*
+     * Check a reference to an entity kept past the frame it was taken in.
+     * @param generation Generation of the id when the reference was taken.
+     * @return 1 if the entity is still in the index, 0 if it was removed (its id may hold another entity now).
+     */
+    return id >= 0 && id < index->num_entities && index->entities[id].bucket >= 0 &&
+        index->entities[id].generation == generation;
+}
+
+int collision_index_move(collision_index *index, const int id, const int x, const int y) {
+    /*
+     * Move an entity to another cell, keeping its id: O(1), the bucket changes only when the cell crosses its border.
+     * @param id Id of an entity still in the index.
+     * @return 0 on success, -1 on failure or if the cell is outside the map.
+     */
+    if (id < 0 || id >= index->num_entities || index->entities[id].bucket < 0 ||
+        x < 0 || x >= index->width || y < 0 || y >= index->height) {
+        return -1;
+    }
+    collision_entity *entity = &index->entities[id];
+    const int bucket = (y / COLLISION_BUCKET) * index->buckets_x + x / COLLISION_BUCKET;
+    if (bucket != entity->bucket) {
+        if (bucket_push(&index->buckets[bucket], id) == -1) {
+            return -1;
+        }
+        // * Out of the old bucket only: the id stays in use
+        bucket_pop(index, id);
+        entity->bucket = bucket;
+        entity->slot = index->buckets[bucket].count - 1;
+    }
+    entity->x = x;
+    entity->y = y;
+    return 0;
+}
+
+void collision_query(const collision_index *index, const collision_segment *segment, collision_result *result) {
+    /*
+     * Find the first obstacle hit by the segment and the targets crossed before it.
+     * The buckets are visited in order along the segment (Amanatides-Woo traversal on the bucket grid)
+     * and the walk stops as soon as the next bucket starts after the first obstacle found.
+     * @param index Spatial index.
+     * @param segment Movement of the drone during the frame.
+     * @param result Filled with the first obstacle and the targets crossed.
+     */
+    result->obstacle = -1;
+    result->t_obstacle = 1.0;
+    result->num_targets = 0;
+    result->truncated = 0;
+    if (index->buckets_x == 0 || index->buckets_y == 0) {
+        return;
+    }
+    // * Work in cell-corner coordinates: the cell (x, y) covers [x, x+1) so it belongs to exactly one bucket
+    const double ux = segment->x0 + 0.5, uy = segment->y0 + 0.5;
+    const double dx = segment->x1 - segment->x0, dy = segment->y1 - segment->y0;
+    int bx = (int)floor(ux / COLLISION_BUCKET), by = (int)floor(uy / COLLISION_BUCKET);
+    const int end_bx = (int)floor((segment->x1 + 0.5) / COLLISION_BUCKET);
+    const int end_by = (int)floor((segment->y1 + 0.5) / COLLISION_BUCKET);
+    const int step_x = dx > 0 ? 1 : -1, step_y = dy > 0 ? 1 : -1;
+    const double t_delta_x = dx != 0 ? COLLISION_BUCKET / fabs(dx) : INFINITY;
+    const double t_delta_y = dy != 0 ? COLLISION_BUCKET / fabs(dy) : INFINITY;
+    double t_max_x = INFINITY, t_max_y = INFINITY;
+    if (dx > 0) t_max_x = ((bx + 1) * COLLISION_BUCKET - ux) / dx;
+    if (dx < 0) t_max_x = (bx * COLLISION_BUCKET - ux) / dx;
+    if (dy > 0) t_max_y = ((by + 1) * COLLISION_BUCKET - uy) / dy;
+    if (dy < 0) t_max_y = (by * COLLISION_BUCKET - uy) / dy;
+    double t_entry = 0.0;
+    while (t_entry <= result->t_obstacle) {
+        if (bx >= 0 && bx < index->buckets_x && by >= 0 && by < index->buckets_y) {
+            const collision_bucket *bucket = &index->buckets[by * index->buckets_x + bx];
+            for (int i = 0; i < bucket->count; i++) {
+                const int id = bucket->items[i];
+                const collision_entity *entity = &index->entities[id];
+                double t_hit;
+                if (!segment_hits_cell(segment, entity->x, entity->y, &t_hit)) continue;
+                if (entity->kind == 'o') {
+                    // * The drone cannot crash into the cell it is leaving
+                    if (entity->x == segment->x0 && entity->y == segment->y0) continue;
+                    if (result->obstacle == -1 || t_hit < result->t_obstacle) {
+                        result->obstacle = id;
+                        result->t_obstacle = t_hit;
+                    }
+                } else {
+                    result_add_target(result, id, t_hit);
+                }
+            }
+        }
+        if (bx == end_bx && by == end_by) break;
+        // * Move to the next bucket crossed by the segment
+        if (t_max_x < t_max_y) {
+            t_entry = t_max_x;
+            t_max_x += t_delta_x;
+            bx += step_x;
+        } else {
+            t_entry = t_max_y;
+            t_max_y += t_delta_y;
+            by += step_y;
+        }
+        if (t_entry > 1.0) break;
+    }
+    // * Drop the targets found behind the obstacle
+    if (result->obstacle != -1) {
+        while (result->num_targets > 0 && result->t_targets[result->num_targets - 1] > result->t_obstacle) {
+            result->num_targets--;
+        }
+    }
+}
+
+static int bucket_push(collision_bucket *bucket, const int id) {
+    if (bucket->count == bucket->capacity) {
+        const int capacity = bucket->capacity ? 2 * bucket->capacity : 4;
+        int *items = realloc(bucket->items, capacity * sizeof(int));
+        if (!items) {
+            return -1;
+        }
+        bucket->items = items;
+        bucket->capacity = capacity;
+    }
+    bucket->items[bucket->count++] = id;
+    return 0;
+}
+
+static void bucket_pop(collision_index *index, const int id) {
+    // * Take an entity out of its bucket in O(1): the last element of the bucket takes its slot
+    const collision_entity *entity = &index->entities[id];
+    collision_bucket *bucket = &index->buckets[entity->bucket];
+    const int last = bucket->items[--bucket->count];
+    bucket->items[entity->slot] = last;
+    index->entities[last].slot = entity->slot;
+}
+
+static int segment_hits_cell(const collision_segment *segment, const int cx, const int cy, double *t_hit) {
+    // * Slab test of the segment against the square of the cell
+    const double p[2] = {segment->x0, segment->y0};
+    const double d[2] = {segment->x1 - segment->x0, segment->y1 - segment->y0};
+    const double c[2] = {cx, cy};
+    double t_min = 0.0, t_max = 1.0;
+    for (int axis = 0; axis < 2; axis++) {
+        const double lo = c[axis] - CELL_HALF, hi = c[axis] + CELL_HALF;
+        if (d[axis] == 0) {
+            if (p[axis] < lo || p[axis] > hi) return 0;
+            continue;
+        }
+        double t1 = (lo - p[axis]) / d[axis], t2 = (hi - p[axis]) / d[axis];
+        if (t1 > t2) {
+            const double tmp = t1;
+            t1 = t2;
+            t2 = tmp;
+        }
+        if (t1 > t_min) t_min = t1;
+        if (t2 < t_max) t_max = t2;
+        if (t_min > t_max) return 0;
+    }
+    *t_hit = t_min;
+    return 1;
+}
+
+static void result_add_target(collision_result *result, const int id, const double t) {
+    // * Sorted insertion, the farthest target is dropped when the result is full
+    int pos = result->num_targets;
+    if (pos == COLLISION_MAX_PICKUPS) {
+        result->truncated = 1;
+        if (t >= result->t_targets[pos - 1]) return;
+        pos--;
+    } else {
+        result->num_targets++;
+    }
+    while (pos > 0 && result->t_targets[pos - 1] > t) {
+        result->targets[pos] = result->targets[pos - 1];
+        result->t_targets[pos] = result->t_targets[pos - 1];
+        pos--;
+    }
+    result->targets[pos] = id;
+    result->t_targets[pos] = t;
+}
@@ -9,20 +9,57 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
 #include <ncurses.h>
 #include "macros.h"
+#include "occupancy.h"
+#include "channel.h"
+#include "components.h"
+#include "physics.h"
+#include "latency.h"
+#include "trace.h"
+#include "metrics.h"
+#include "heartbeat.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
+#include "supervisor.h"
 
-FILE *logfile;
 static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t latency_dump = 0;
 
-void signal_close(int signum);
-void signal_triggered(int signum);
+// * Stages of a frame, timed on the monotonic clock (the report is written on exit and on SIGUSR2)
+enum {
+  STAGE_RECEIVE, // * Wait for the blackboard and read the window and the drone state
+  STAGE_FIELD, // * Forces of the obstacles and targets of the window
+  STAGE_REPLY, // * Integration and reply
+  STAGE_SERVICE, // * From the request read to the reply written
+  NUM_STAGES
+};
+
+static latency_histogram stages[NUM_STAGES] = {
+  [STAGE_RECEIVE] = {"receive"}, [STAGE_FIELD] = {"field"}, [STAGE_REPLY] = {"reply"}, [STAGE_SERVICE] = {"service"},
+};
+
+// * Counters published on the metrics endpoint of the watchdog (metrics.h), in the order of their slots
+enum {
+  METRIC_FRAMES, // * Frames computed
+  METRIC_COMPUTE, // * Time spent from the request read to the reply written (ns, published in seconds)
+  METRIC_BYTES_IN, METRIC_BYTES_OUT, METRIC_MESSAGES_IN, METRIC_MESSAGES_OUT, // * Traffic with the blackboard
+  NUM_METRICS
+};
+
+#ifndef DRONE_THREADS
+static void signal_close(int signum);
+static void signal_triggered(int signum);
+static void signal_latency(int signum);
 
 int main(int argc, char *argv[]) {
   /*
    * Dynamics process
    * @param argv[1]: Read file descriptors
    * @param argv[2]: Write file descriptors
+   * @param argv[3], argv[4]: Map height and width
   */
   // * Signal handler closure
   struct sigaction sa0;
@@ -42,9 +79,18 @@ int main(int argc, char *argv[]) {
     perror("sigaction");
     exit(EXIT_FAILURE);
   }
+  // * Latency report on demand
+  struct sigaction sa2;
+  memset(&sa2, 0, sizeof(sa2));
+  sa2.sa_handler = signal_latency;
+  sa2.sa_flags = SA_RESTART;
+  if (sigaction(SIGUSR2, &sa2, NULL) == -1) {
+    perror("sigaction");
+    exit(EXIT_FAILURE);
+  }
   // * CHeck if the nuber of argument correspond
-  if (argc != 4) {
-    fprintf(stderr, "Usage: %s <read_fd> <write_fd> <logfile_fd>\n", argv[0]);
+  if (argc != 6) {
+    fprintf(stderr, "Usage: %s <read_fd> <write_fd> <height> <width> <logfile_fd>\n", argv[0]);
     return EXIT_FAILURE;
   }
   // * Parse the read and write
@@ -58,95 +104,185 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "Invalid write file descriptor: %s\n", argv[2]);
     return EXIT_FAILURE;
   }
+  // * Parse the map size
+  int map_height, map_width;
+  if (occupancy_parse_size(argv[3], argv[4], &map_height, &map_width) == -1) {
+    return EXIT_FAILURE;
+  }
   // * Parse logfile file descriptors
   int logfile_fd = atoi(argv[argc - 1]);
-  logfile = fdopen(logfile_fd, "a");
-  if (!logfile) {
-    perror("fdopen logfile");
+  channel *in = channel_from_fd(read_fd), *out = channel_from_fd(write_fd);
+  if (!in || !out) {
+    perror("channel");
     return EXIT_FAILURE;
   }
+  const int status = dynamics_run(in, out, map_height, map_width, logfile_fd);
+  channel_close(in);
+  channel_close(out);
+  return status;
+}
+
+static void signal_close(int signum) {
+  keep_running = 0;
+}
+
+static void signal_triggered(int signum) {
+  log_write("Dynamics is active.");
+}
+
+static void signal_latency(int signum) {
+  latency_dump = 1;
+}
+#endif
+
+int dynamics_run(channel *in, channel *out, const int map_height, const int map_width, const int logfile_fd) {
+  /*
+   * Loop of the dynamics: answer every frame of the blackboard with the new position of the drone.
+   * @param in, out Channels from and to the blackboard, closed by the caller.
+   * @return EXIT_SUCCESS when it is stopped or the blackboard is gone, EXIT_FAILURE on failure.
+   */
+  if (log_open("dynamics", logfile_fd) == -1) {
+    perror("log");
+  }
+  if (trace_open("dynamics") == -1) {
+    perror("trace");
+  }
+  if (heartbeat_open() == -1) {
+    perror("heartbeat");
+  }
+  realtime_enter("dynamics");
+  // * The dynamics runs without metrics if the page cannot be created
+  metrics_page *metrics = metrics_open("dynamics");
+  if (!metrics) {
+    perror("metrics");
+  }
+  metrics_register(metrics, "dronegame_dynamics_frames_total", "", "Frames computed by the dynamics.",
+    METRICS_COUNTER, 1);
+  metrics_register(metrics, "dronegame_dynamics_compute_seconds_total", "",
+    "Time from the request read to the reply written.", METRICS_COUNTER, 1e-9);
+  metrics_register(metrics, "dronegame_ipc_bytes_total", "pipe=\"blackboard\",direction=\"in\"",
+    "Bytes moved through the pipes.", METRICS_COUNTER, 1);
+  metrics_register(metrics, "dronegame_ipc_bytes_total", "pipe=\"blackboard\",direction=\"out\"",
+    "Bytes moved through the pipes.", METRICS_COUNTER, 1);
+  metrics_register(metrics, "dronegame_ipc_messages_total", "pipe=\"blackboard\",direction=\"in\"",
+    "Messages (whole-buffer transfers) moved through the pipes.", METRICS_COUNTER, 1);
+  metrics_register(metrics, "dronegame_ipc_messages_total", "pipe=\"blackboard\",direction=\"out\"",
+    "Messages (whole-buffer transfers) moved through the pipes.", METRICS_COUNTER, 1);
+  // * Neighbourhood of the drone sent by the blackboard every frame
+  occupancy_map window;
+  memset(&window, 0, sizeof(window));
+  int result = EXIT_SUCCESS;
+  // * Restarted alone by the supervisor: what is left of the frame the previous dynamics was reading is dropped,
+  // * and the blackboard is asked to send the frame again
+  if (getenv(SUPERVISOR_RESTART_ENV)) {
+    channel_drain(in);
+    char restarted[32];
+    snprintf(restarted, sizeof(restarted), "%s", DYNAMICS_RESTARTED);
+    if (channel_write(out, restarted, sizeof(restarted)) == -1) {
+      perror("write");
+    }
+  }
+  startup_phase("dynamics", "ready");
+  uint64_t lap = latency_now();
   while(keep_running) {
-    // * Receive the updated map
-    char grid[GAME_HEIGHT][GAME_WIDTH];
-    memset(grid, ' ', GAME_HEIGHT*GAME_WIDTH);
-    if (read(read_fd, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char)) != GAME_HEIGHT * GAME_WIDTH * sizeof(char)) {
-      perror("read grid");
-      return EXIT_FAILURE;
+    // * Receive the updated map around the drone (the end of the channel is the end of the game)
+    heartbeat_wait();
+    if (occupancy_read(in, &window) == -1) {
+      if (errno == EPROTO) {
+        // * Middle of a frame (see the drain above): skip to the frame sent again
+        channel_drain(in);
+        continue;
+      }
+      if (errno != EPIPE) {
+        perror("read grid");
+        result = EXIT_FAILURE;
+      }
+      break;
     }
+    heartbeat_beat();
     // * Read the drone position and force
     char msg[100];
-    if (read(read_fd, msg, sizeof(msg)) == -1) {
+    if (channel_read(in, msg, sizeof(msg)) == -1) {
       perror("read");
-      return EXIT_FAILURE;
+      result = EXIT_FAILURE;
+      break;
     }
     int x[2], y[2], force_x, force_y;
-    if (sscanf(msg, "%d,%d,%d,%d,%d,%d", &x[0], &y[0], &x[1], &y[1], &force_x, &force_y) != 6) {
+    unsigned int key; // * Sequence number of the key of the frame, 0 if none
+    unsigned int sequence; // * Number of the frame, echoed in the reply
+    if (sscanf(msg, "%d,%d,%d,%d,%d,%d,%u,%u", &x[0], &y[0], &x[1], &y[1], &force_x, &force_y, &key,
+      &sequence) != 8) {
       fprintf(stderr, "Failed to parse message: %s\n", msg);
-      return EXIT_FAILURE;
+      channel_drain(in);
+      continue;
     }
+    const uint64_t received = lap = latency_lap(&stages[STAGE_RECEIVE], lap);
     // * Declare the total force
     double Fx = (double)force_x/10, Fy = (double)force_y/10;
-    // * Compute the repulsive and attractive forces
-    for (int i = 0; i < GAME_HEIGHT; i++) {
-      for (int j = 0; j < GAME_WIDTH; j++) {
-        const char cell = grid[i][j];
-        if (cell == ' ') continue;
-        const int dx = x[1] - j;
-        const int dy = y[1] - i;
-        double dist = sqrt((double)dx*dx + (double)dy*dy);
-        // * Repulsive forces
-        dist = dist < MIN_RHO_OBST ? MIN_RHO_OBST : dist;
-        if (dist < RHO_OBST && cell == 'o') {
-          Fx -= ETA*(1/dist - 1/RHO_OBST)*dx/pow(dist,3);
-          Fy -= ETA*(1/dist - 1/RHO_OBST)*dy/pow(dist,3);
-          continue;
-        }
-        // * Attractive forces
-        dist = sqrt((double)dx*dx + (double)dy*dy);
-        dist = dist < MIN_RHO_TRG ? MIN_RHO_TRG : dist;
-        if (dist < RHO_TRG && strchr("0123456789", cell)) {
-          Fx -= EPSILON*(double)dx/dist;
-          Fy -= EPSILON*(double)dy/dist;
+    // * Compute the repulsive and attractive forces, visiting only the non-empty cells of the window
+    for (int row = 0; row < window.height; row++) {
+      for (int w = 0; w < window.words_per_row; w++) {
+        const long word = (long)row * window.words_per_row + w;
+        uint64_t cells = window.obstacles[word] | window.targets[word];
+        while (cells) {
+          const int col = 64 * w + __builtin_ctzll(cells);
+          cells &= cells - 1;
+          const int is_obstacle = (int)(window.obstacles[word] >> (col % 64) & 1);
+          const int dx = x[1] - (window.origin_x + col);
+          const int dy = y[1] - (window.origin_y + row);
+          double dist = sqrt((double)dx*dx + (double)dy*dy);
+          // * Repulsive forces
+          dist = dist < MIN_RHO_OBST ? MIN_RHO_OBST : dist;
+          if (dist < RHO_OBST && is_obstacle) {
+            Fx -= ETA*(1/dist - 1/RHO_OBST)*dx/pow(dist,3);
+            Fy -= ETA*(1/dist - 1/RHO_OBST)*dy/pow(dist,3);
+            continue;
+          }
+          // * Attractive forces
+          dist = sqrt((double)dx*dx + (double)dy*dy);
+          dist = dist < MIN_RHO_TRG ? MIN_RHO_TRG : dist;
+          if (dist < RHO_TRG && !is_obstacle) {
+            Fx -= EPSILON*(double)dx/dist;
+            Fy -= EPSILON*(double)dy/dist;
+          }
         }
       }
     }
-    // * Compute the position from the force
-    int x_new = (int)(
-            (TIME*TIME*Fx - DRONE_MASS*x[0] + (2*DRONE_MASS + DAMPING*TIME)*x[1]) / (DRONE_MASS + DAMPING*TIME)
-        );
-    int y_new = (int)(
-        (TIME*TIME*Fy - DRONE_MASS*y[0] + (2*DRONE_MASS + DAMPING*TIME)*y[1]) / (DRONE_MASS + DAMPING*TIME)
-    );
-    // * Clamp to window boundaries so we do not jump outside:
-    if (x_new < 3) {
-      x_new = 3;
-    } else if (x_new > GAME_WIDTH - 3) {
-      x_new = GAME_WIDTH - 3;
-    }
-    if (y_new < 3) {
-      y_new = 3;
-    } else if (y_new > GAME_HEIGHT - 3) {
-      y_new = GAME_HEIGHT - 3;
-    }
+    lap = latency_lap(&stages[STAGE_FIELD], lap);
+    // * Compute the position from the force and clamp it to the map boundaries
+    const int x_new = drone_clamp(drone_integrate(Fx, x[0], x[1]), map_width);
+    const int y_new = drone_clamp(drone_integrate(Fy, y[0], y[1]), map_height);
     // * Send the new position of the drone
     char out_buf[32];
-    sprintf(out_buf, "%d,%d", x_new, y_new);
-    if (write(write_fd, out_buf, sizeof(out_buf)) == -1) {
+    snprintf(out_buf, sizeof(out_buf), "%d,%d,%u", x_new, y_new, sequence);
+    if (channel_write(out, out_buf, sizeof(out_buf)) == -1) {
       perror("write");
-      return EXIT_FAILURE;
+      result = EXIT_FAILURE;
+      break;
+    }
+    lap = latency_lap(&stages[STAGE_REPLY], lap);
+    latency_record(&stages[STAGE_SERVICE], lap - received);
+    metrics_add(metrics, METRIC_FRAMES, 1);
+    metrics_add(metrics, METRIC_COMPUTE, (int64_t)(lap - received));
+    metrics_set(metrics, METRIC_BYTES_IN, (int64_t)channel_stats(in)->bytes_in);
+    metrics_set(metrics, METRIC_BYTES_OUT, (int64_t)channel_stats(out)->bytes_out);
+    metrics_set(metrics, METRIC_MESSAGES_IN, (int64_t)channel_stats(in)->reads);
+    metrics_set(metrics, METRIC_MESSAGES_OUT, (int64_t)channel_stats(out)->writes);
+    if (key) {
+      trace_record("dynamics", key, received, lap, 't');
+    }
+    if (latency_dump) {
+      // * On demand: written after the frame, so that the report never delays the reply
+      latency_dump = 0;
+      latency_report("Dynamics", stages, NUM_STAGES);
+      lap = latency_now();
     }
   }
-  return EXIT_SUCCESS;
+  latency_report("Dynamics", stages, NUM_STAGES);
+  trace_close();
+  metrics_close(metrics);
+  heartbeat_close();
+  log_close();
+  occupancy_free(&window);
+  return result;
 }
-
-void signal_close(int signum) {
-  keep_running = 0;
-}
-
-void signal_triggered(int signum) {
-  time_t now = time(NULL);
-  struct tm *t = localtime(&now);
-  fprintf(logfile, "[%02d:%02d:%02d] PID: %d - %s\n", t->tm_hour, t->tm_min, t->tm_sec, getpid(),
-      "Dynamics is active.");
-  fflush(logfile);
-}
\ No newline at end of file
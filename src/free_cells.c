@@ -0,0 +1,137 @@
+//
+// Created by Gian Marco Balia
+//
+// src/free_cells.c
+#include <stdlib.h>
+#include <string.h>
+#include "free_cells.h"
+
+static int collect(free_cells *pool);
+static uint64_t free_bits(const free_cells *pool, int y, int w, int x0, int x1);
+static int cell_free(const free_cells *pool, int x, int y);
+
+int free_cells_build(free_cells *pool, const occupancy_map *map, const int x0, const int y0, const int height,
+    const int width, const int32_t exclude, const uint64_t *allowed) {
+    /*
+     * Count the free cells of the rectangle [x0, x0+width) x [y0, y0+height) and, if they are less than half of it,
+     * collect them in a list.
+     * @param pool Pool to initialise.
+     * @param map Map to sample, it must outlive the pool.
+     * @param exclude Cell that is never drawn, -1 if none.
+     * @param allowed Layer of the cells that can be drawn, NULL for every cell; it must outlive the pool.
+     * @return 0 on success, -1 on failure.
+     */
+    memset(pool, 0, sizeof(*pool));
+    pool->map = map;
+    pool->x0 = x0;
+    pool->y0 = y0;
+    pool->height = height;
+    pool->width = width;
+    pool->exclude = exclude;
+    pool->allowed = allowed;
+    if (height <= 0 || width <= 0) {
+        return 0;
+    }
+    return collect(pool);
+}
+
+void free_cells_free(free_cells *pool) {
+    free(pool->cells);
+    memset(pool, 0, sizeof(*pool));
+}
+
+int32_t free_cells_draw(free_cells *pool, rng_state *rng) {
+    /*
+     * Draw a free cell uniformly and take it out of the pool.
+     * @return The cell (y * map width + x), -1 if no free cell is left.
+     */
+    if (pool->count <= 0) {
+        return -1;
+    }
+    // * Retries get expensive when the rectangle fills up: switch to the list
+    if (!pool->cells && 4 * pool->count < (long)pool->height * pool->width && collect(pool) == -1) {
+        return -1;
+    }
+    if (pool->cells) {
+        // * One step of a partial Fisher-Yates shuffle
+        const long i = (long)rng_range(rng, pool->count);
+        const int32_t cell = pool->cells[i];
+        pool->cells[i] = pool->cells[--pool->count];
+        return cell;
+    }
+    const occupancy_map *map = pool->map;
+    for (;;) {
+        const int x = pool->x0 + (int)rng_range(rng, pool->width);
+        const int y = pool->y0 + (int)rng_range(rng, pool->height);
+        const int32_t cell = y * map->width + x;
+        if (cell != pool->exclude && cell_free(pool, x, y)) {
+            pool->count--;
+            return cell;
+        }
+    }
+}
+
+static int cell_free(const free_cells *pool, const int x, const int y) {
+    const occupancy_map *map = pool->map;
+    return !occupancy_test(map, map->obstacles, x, y) && !occupancy_test(map, map->targets, x, y) &&
+        (!pool->allowed || occupancy_test(map, pool->allowed, x, y));
+}
+
+static uint64_t free_bits(const free_cells *pool, const int y, const int w, const int x0, const int x1) {
+    // * Free (and allowed) cells of the word w of the row y, restricted to the columns [x0, x1)
+    const occupancy_map *map = pool->map;
+    const long word = (long)y * map->words_per_row + w;
+    uint64_t bits = ~(map->obstacles[word] | map->targets[word]);
+    if (pool->allowed) {
+        bits &= pool->allowed[word];
+    }
+    if (64 * w < x0) {
+        bits &= ~(uint64_t)0 << (x0 - 64 * w);
+    }
+    if (64 * w + 64 > x1) {
+        bits &= x1 - 64 * w >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (x1 - 64 * w)) - 1;
+    }
+    return bits;
+}
+
+static int collect(free_cells *pool) {
+    // * Count the free cells and collect them in a list if they are less than half of the rectangle
+    const occupancy_map *map = pool->map;
+    const int x0 = pool->x0, y0 = pool->y0, x1 = pool->x0 + pool->width;
+    const int w0 = x0 / 64, w1 = (x1 - 1) / 64;
+    const int32_t exclude = pool->exclude;
+    free(pool->cells);
+    pool->cells = NULL;
+    pool->count = 0;
+    for (int y = y0; y < y0 + pool->height; y++) {
+        for (int w = w0; w <= w1; w++) {
+            pool->count += __builtin_popcountll(free_bits(pool, y, w, x0, x1));
+        }
+    }
+    if (exclude >= 0 && exclude % map->width >= x0 && exclude % map->width < x1 && exclude / map->width >= y0 &&
+        exclude / map->width < y0 + pool->height && cell_free(pool, exclude % map->width, exclude / map->width)) {
+        pool->count--;
+    }
+    if (2 * pool->count >= (long)pool->height * pool->width) {
+        return 0;
+    }
+    // * Visit only the set bits of the free mask
+    pool->cells = malloc((pool->count ? pool->count : 1) * sizeof(int32_t));
+    if (!pool->cells) {
+        return -1;
+    }
+    long n = 0;
+    for (int y = y0; y < y0 + pool->height; y++) {
+        for (int w = w0; w <= w1; w++) {
+            uint64_t bits = free_bits(pool, y, w, x0, x1);
+            while (bits) {
+                const int32_t cell = y * map->width + 64 * w + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (cell != exclude) {
+                    pool->cells[n++] = cell;
+                }
+            }
+        }
+    }
+    return 0;
+}
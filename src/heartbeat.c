@@ -0,0 +1,118 @@
+//
+// Created by Gian Marco Balia
+//
+// src/heartbeat.c
+#define _GNU_SOURCE // * gettid
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "heartbeat.h"
+
+// * Page of this process (of this thread in the threaded build, threads.h), NULL before heartbeat_open or if it failed
+static _Thread_local heartbeat_page *page = NULL;
+
+static void page_name(char *name, size_t size, pid_t pid);
+
+int heartbeat_open(void) {
+    /*
+     * Create the heartbeat page of this process, busy with no beat yet.
+     * @return 0 on success, -1 on failure (the beats are then not counted).
+     */
+    char name[64];
+    page_name(name, sizeof(name), gettid());
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(heartbeat_page)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    void *map = mmap(NULL, sizeof(heartbeat_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+    page = map;
+    atomic_init(&page->waiting, 0);
+    atomic_init(&page->beats, 0);
+    page->magic = HEARTBEAT_MAGIC;
+    return 0;
+}
+
+void heartbeat_close(void) {
+    // * The page is removed with the process: a watchdog that maps it sees the count stop, and the process gone
+    if (page) {
+        char name[64];
+        page_name(name, sizeof(name), gettid());
+        munmap(page, sizeof(heartbeat_page));
+        shm_unlink(name);
+        page = NULL;
+    }
+}
+
+void heartbeat_beat(void) {
+    // * One iteration of the main loop, busy until the next wait (single writer: no lock prefix)
+    if (page) {
+        atomic_store_explicit(&page->waiting, 0, memory_order_relaxed);
+        atomic_store_explicit(&page->beats, atomic_load_explicit(&page->beats, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+    }
+}
+
+void heartbeat_wait(void) {
+    // * About to block on the input of the process
+    if (page) {
+        atomic_store_explicit(&page->waiting, 1, memory_order_relaxed);
+        atomic_store_explicit(&page->beats, atomic_load_explicit(&page->beats, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+    }
+}
+
+heartbeat_page *heartbeat_attach(const pid_t pid) {
+    /*
+     * Map the heartbeat page of a process read-only.
+     * @return The page, NULL if the process has none (yet).
+     */
+    char name[64];
+    page_name(name, sizeof(name), pid);
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat info;
+    heartbeat_page *attached = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(heartbeat_page)) {
+        attached = mmap(NULL, sizeof(heartbeat_page), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (attached == MAP_FAILED) {
+        return NULL;
+    }
+    if (attached->magic != HEARTBEAT_MAGIC) {
+        munmap(attached, sizeof(heartbeat_page));
+        return NULL;
+    }
+    return attached;
+}
+
+void heartbeat_detach(heartbeat_page *attached) {
+    if (attached) {
+        munmap(attached, sizeof(heartbeat_page));
+    }
+}
+
+void heartbeat_remove(const pid_t pid) {
+    // * Remove the page of a process that could not do it (killed)
+    char name[64];
+    page_name(name, sizeof(name), pid);
+    shm_unlink(name);
+}
+
+static void page_name(char *name, const size_t size, const pid_t pid) {
+    snprintf(name, size, "/dronegame_heartbeat.%d", pid);
+}
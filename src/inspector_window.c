@@ -5,18 +5,25 @@
 
 #include <ncurses.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/fcntl.h>
 #include <signal.h>
 #include <errno.h>
 
 #include "macros.h"
+#include "latency.h"
+#include "trace.h"
 
 static volatile sig_atomic_t keep_running = 1;
 
 void signal_close(int signum);
+static int next_status(char *line, size_t size);
 
 int main() {
+    if (trace_open("inspector") == -1) {
+        perror("trace");
+    }
     // * Initialize ncurses
     initscr();
     cbreak();
@@ -73,29 +80,19 @@ int main() {
 
     while (keep_running) {
         char insp_msg[128] = {0};
-        int fd = open(INSPECTOR_FIFO, O_RDONLY);
-        if (fd == -1) {
-            continue;
-        }
-        int ret = read(fd, insp_msg, sizeof(insp_msg) - 1);
+        const int ret = next_status(insp_msg, sizeof(insp_msg));
         if (ret == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                close(fd);
-                continue;
-            } else {
-                perror("read");
-                close(fd);
-                return EXIT_FAILURE;
-            }
+            perror("read");
+            return EXIT_FAILURE;
         }
-        insp_msg[ret] = '\0';
-        close(fd);
+        const uint64_t received = latency_now();
+        unsigned int key = 0; // * Sequence number of the key of the frame, 0 if none
 
         if (ret > 0) {
             char c;
             int force_x, force_y, pos_x, pos_y, vel_x, vel_y;
-            if (sscanf(insp_msg, "%d,%d,%d,%d,%d,%d,%c",
-                       &force_x, &force_y, &pos_x, &pos_y, &vel_x, &vel_y, &c) != 7) {
+            if (sscanf(insp_msg, "%d,%d,%d,%d,%d,%d,%c,%u",
+                       &force_x, &force_y, &pos_x, &pos_y, &vel_x, &vel_y, &c, &key) != 8) {
                 mvwprintw(left_box, 5, 1, "Invalid message format:");
                 mvwprintw(left_box, 6, 1, "%s", insp_msg);
                 wrefresh(left_box);
@@ -184,8 +181,13 @@ int main() {
             }
         }
         wrefresh(right_box);
+        if (key) {
+            // * Last hop of the key: from the status read to the keypad on screen
+            trace_record("inspector", key, received, latency_now(), 'f');
+        }
     }
     // * Cleanup
+    trace_close();
     delwin(left_box);
     delwin(right_box);
     delwin(inspect_win);
@@ -193,6 +195,53 @@ int main() {
     return EXIT_SUCCESS;
 }
 
+static int next_status(char *line, const size_t size) {
+    /*
+     * Next status line of the blackboard, from the FIFO kept open while the blackboard writes to it.
+     * @param line Filled with the line without its newline, cut to size - 1 characters.
+     * @return Length of the line, 0 if the blackboard closed the FIFO (it is opened again on the next call), -1 on
+     * failure.
+     */
+    static int fd = -1;
+    static char pending[512];
+    static size_t length = 0;
+    for (;;) {
+        const char *end = memchr(pending, '\n', length);
+        if (end) {
+            const size_t n = (size_t)(end - pending);
+            const size_t kept = n < size - 1 ? n : size - 1;
+            memcpy(line, pending, kept);
+            line[kept] = '\0';
+            length -= n + 1;
+            memmove(pending, end + 1, length);
+            return (int)kept;
+        }
+        if (fd == -1) {
+            // * Waits for the blackboard, as long as it plays
+            fd = open(INSPECTOR_FIFO, O_RDONLY);
+            if (fd == -1) {
+                return errno == EINTR ? 0 : -1;
+            }
+        }
+        // * A line longer than the buffer is not a status: drop it
+        if (length == sizeof(pending)) {
+            length = 0;
+        }
+        const ssize_t ret = read(fd, pending + length, sizeof(pending) - length);
+        if (ret == -1) {
+            return errno == EINTR ? 0 : -1;
+        }
+        if (ret == 0) {
+            // * The blackboard closed its end (it ended, or was restarted)
+            close(fd);
+            fd = -1;
+            length = 0;
+            return 0;
+        }
+        length += (size_t)ret;
+    }
+}
+
 void signal_close(int signum) {
     keep_running = 0;
 }
\ No newline at end of file
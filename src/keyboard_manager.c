@@ -8,13 +8,23 @@
 #include <time.h>
 #include <signal.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
 #include <ncurses.h>
+#include "channel.h"
+#include "components.h"
+#include "latency.h"
+#include "trace.h"
+#include "heartbeat.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
 
-FILE *logfile;
 static volatile sig_atomic_t keep_running = 1;
 
-void signal_close(int signum);
-void signal_triggered(int signum);
+#ifndef DRONE_THREADS
+static void signal_close(int signum);
+static void signal_triggered(int signum);
 
 int main(const int argc, char *argv[]) {
     /*
@@ -53,18 +63,74 @@ int main(const int argc, char *argv[]) {
 
     // * Parse logfile file descriptors
     int logfile_fd = atoi(argv[argc - 1]);
-    logfile = fdopen(logfile_fd, "a");
-    if (!logfile) {
-        perror("fdopen logfile");
+    channel *out = channel_from_fd(write_fd);
+    if (!out) {
+        perror("channel");
         return EXIT_FAILURE;
     }
+    // * The terminal is set up here: in the threaded build it belongs to the blackboard
     if (initscr() == NULL) {
         return EXIT_FAILURE;
     }
     nodelay(stdscr, TRUE);
     noecho();
+    const int status = keyboard_run(out, logfile_fd);
+    endwin();
+    channel_close(out);
+    return status;
+}
+
+static void signal_close(int signum) {
+    keep_running = 0;
+}
+
+static void signal_triggered(int signum) {
+    log_write("Keyboard manager is active.");
+}
+#endif
+
+int keyboard_run(channel *out, const int logfile_fd) {
+    /*
+     * Loop of the keyboard manager: forward the keys of the game from the terminal to the blackboard.
+     * The keys are read from the standard input, not with getch(): ncurses is not thread-safe and the threaded build
+     * draws the blackboard meanwhile.
+     * @param out Channel to the blackboard, closed by the caller.
+     * @return EXIT_SUCCESS when it is stopped or the blackboard is gone, EXIT_FAILURE on failure.
+     */
+    if (log_open("keyboard", logfile_fd) == -1) {
+        perror("log");
+    }
+    if (trace_open("keyboard") == -1) {
+        perror("trace");
+    }
+    if (heartbeat_open() == -1) {
+        perror("heartbeat");
+    }
+    realtime_enter("input");
+    // * Keys written so far: the sequence number of a key is its trace id (the blackboard counts the same)
+    uint32_t keys_written = 0;
+    startup_phase("keyboard", "ready");
+    // * The descriptor of the channel becomes readable once the blackboard is gone
+    struct pollfd input[2] = {{STDIN_FILENO, POLLIN, 0}, {channel_fd(out), POLLIN, 0}};
     while(keep_running) {
-        char c = getch();
+        // * Sleep until the terminal has input (or a signal arrives) instead of spinning
+        heartbeat_wait();
+        if (poll(input, 2, -1) <= 0) {
+            continue;
+        }
+        heartbeat_beat();
+        if (input[1].revents) {
+            break;
+        }
+        const uint64_t pressed = latency_now();
+        char c;
+        const ssize_t n = read(STDIN_FILENO, &c, sizeof(c));
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            continue;
+        }
         switch (c) {
             case 'w': // * Up Left
             case 'e': // * Up
@@ -76,31 +142,29 @@ int main(const int argc, char *argv[]) {
             case 'c': // * Down
             case 'v': // * Down Right
             case 'p': // * Pause
+            case 'n': // * New round
+            case 'm': // * Save the map
             case 'q': {
                 // * Quit
-                if (write(write_fd, &c, sizeof(c)) == -1) {
-                    perror("write");
-                    return EXIT_FAILURE;
+                if (channel_write(out, &c, sizeof(c)) == -1) {
+                    // * EPIPE: the blackboard is gone (the threaded build raises no SIGPIPE)
+                    if (errno != EPIPE) {
+                        perror("write");
+                        return EXIT_FAILURE;
+                    }
+                    keep_running = 0;
+                    break;
                 }
+                // * First hop of the key: from the terminal to the channel
+                trace_record("getch", ++keys_written, pressed, latency_now(), 's');
                 break;
             }
             default:
                 break;
         }
     }
-    endwin();
-    close(write_fd);
+    trace_close();
+    heartbeat_close();
+    log_close();
     return EXIT_SUCCESS;
-}
-
-void signal_close(int signum) {
-    keep_running = 0;
-}
-
-void signal_triggered(int signum) {
-    const time_t now = time(NULL);
-    const struct tm *t = localtime(&now);
-    fprintf(logfile, "[%02d:%02d:%02d] PID: %d - %s\n", t->tm_hour, t->tm_min, t->tm_sec, getpid(),
-        "Keyboard manager is active.");
-    fflush(logfile);
 }
\ No newline at end of file
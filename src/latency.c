@@ -0,0 +1,98 @@
+//
+// Created by Gian Marco Balia
+//
+// src/latency.c
+#include <time.h>
+#include "latency.h"
+#include "log_ring.h"
+
+#define SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+
+static int bucket_of(uint64_t ns);
+static uint64_t bucket_top(int bucket);
+
+uint64_t latency_now(void) {
+    // * Monotonic clock in nanoseconds (vDSO, no system call)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void latency_record(latency_histogram *histogram, const uint64_t ns) {
+    histogram->buckets[bucket_of(ns)]++;
+    histogram->count++;
+    histogram->sum += ns;
+    if (ns > histogram->max) {
+        histogram->max = ns;
+    }
+}
+
+uint64_t latency_lap(latency_histogram *histogram, const uint64_t since) {
+    /*
+     * Record the time elapsed since `since` (a previous latency_now or latency_lap) and start the next stage.
+     * @return The current time, the start of the next stage.
+     */
+    const uint64_t now = latency_now();
+    latency_record(histogram, now - since);
+    return now;
+}
+
+uint64_t latency_percentile(const latency_histogram *histogram, const double percentile) {
+    /*
+     * Value below which `percentile` percent of the samples fall, rounded up to the top of its bucket.
+     * @return The value in nanoseconds, 0 if there are no samples.
+     */
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100 * (double)histogram->count + 0.999999);
+    rank = rank < 1 ? 1 : rank > histogram->count ? histogram->count : rank;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank) {
+            const uint64_t top = bucket_top(bucket);
+            return top < histogram->max ? top : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void latency_report(const char *process, const latency_histogram *histograms, const int count) {
+    /*
+     * Log p50, p99 and max of every stage that has samples, one line per stage.
+     * @param process Name of the process, at the start of every line.
+     */
+    for (int i = 0; i < count; i++) {
+        const latency_histogram *h = &histograms[i];
+        if (h->count == 0) {
+            continue;
+        }
+        log_printf("%s latency %-10s n=%llu mean=%.3f ms p50=%.3f ms p99=%.3f ms max=%.3f ms", process, h->name,
+            (unsigned long long)h->count, (double)h->sum / (double)h->count / 1e6,
+            (double)latency_percentile(h, 50) / 1e6, (double)latency_percentile(h, 99) / 1e6, (double)h->max / 1e6);
+    }
+}
+
+static int bucket_of(const uint64_t ns) {
+    // * Exact below SUB_BUCKETS, then SUB_BUCKETS linear buckets per power of two
+    if (ns >> LATENCY_MAX_BITS) {
+        return LATENCY_BUCKETS - 1;
+    }
+    if (ns < SUB_BUCKETS) {
+        return (int)ns;
+    }
+    const int magnitude = 63 - __builtin_clzll(ns);
+    return ((magnitude - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) +
+        (int)(ns >> (magnitude - LATENCY_SUB_BITS) & (SUB_BUCKETS - 1));
+}
+
+static uint64_t bucket_top(const int bucket) {
+    // * Largest value that falls in the bucket
+    if (bucket < SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    const int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    const uint64_t low = (uint64_t)(SUB_BUCKETS | (bucket & (SUB_BUCKETS - 1))) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
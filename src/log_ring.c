@@ -0,0 +1,473 @@
+//
+// Created by Gian Marco Balia
+//
+// src/log_ring.c
+#define _GNU_SOURCE // * gettid
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log_ring.h"
+#include "pipe_io.h"
+
+// * Record copied out of a ring by the collector
+typedef struct {
+    uint64_t time;
+    int32_t pid;
+    char text[LOG_TEXT_MAX];
+} log_line;
+
+typedef struct {
+    log_line *lines;
+    int count, capacity;
+} log_batch;
+
+// * Ring followed by the collector, and the record it found uncommitted at the last drain (UINT64_MAX for none)
+typedef struct {
+    char name[NAME_MAX + 1];
+    log_ring *ring;
+    size_t size;
+    uint64_t uncommitted;
+} collected_ring;
+
+// * Ring of this process (of this thread in the threaded build, threads.h), NULL without one, and the logfile written
+// * directly without a ring
+static _Thread_local log_ring *ring = NULL;
+static _Thread_local int fallback = -1;
+// * Offset of the local time from UTC in seconds, for the lines written directly (localtime_r is not
+// * async-signal-safe)
+static _Thread_local long local_offset = 0;
+// * Rings mapped by the collector of this process
+static collected_ring collected[LOG_MAX_RINGS];
+static int num_collected = 0;
+
+static size_t ring_size(uint32_t capacity);
+static void copy_text(char *dest, const char *src);
+static void write_line(int fd, uint64_t time, pid_t pid, const char *text);
+static int put_number(char *dest, long value, int digits);
+static int is_ring(const char *name, int dead);
+static int is_dead(const log_ring *source);
+static log_ring *map_ring(const char *dir, const char *name, int writable, size_t *size);
+static void drain_ring(log_ring *source, uint64_t *uncommitted, log_batch *batch);
+static void replay_ring(const log_ring *source, log_batch *batch);
+static int batch_add(log_batch *batch, uint64_t time, pid_t pid, const char *text);
+static int write_batch(int fd, log_batch *batch);
+static int by_time(const void *a, const void *b);
+
+int log_open(const char *process, const int fallback_fd) {
+    /*
+     * Create the ring of this process in the directory of the game (LOG_ENV).
+     * @param process Name of the process, at the start of the name of its ring.
+     * @param fallback_fd Logfile written directly when there is no ring.
+     * @return 0 on success or without a directory, -1 on failure (the lines go to the logfile directly).
+     */
+    fallback = fallback_fd;
+    const time_t now = time(NULL);
+    struct tm t;
+    if (localtime_r(&now, &t)) {
+        local_offset = t.tm_gmtoff;
+    }
+    const char *dir = getenv(LOG_ENV);
+    if (!dir || dir[0] == '\0') {
+        return 0;
+    }
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.%d.ring", dir, process, gettid());
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    const size_t size = ring_size(LOG_CAPACITY);
+    if (ftruncate(fd, (off_t)size) == -1) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path);
+        return -1;
+    }
+    log_ring *created = map;
+    created->capacity = LOG_CAPACITY;
+    created->pid = gettid();
+    strncpy(created->process, process, sizeof(created->process) - 1);
+    atomic_init(&created->closed, 0);
+    atomic_init(&created->head, 0);
+    atomic_init(&created->tail, 0);
+    // * The collector follows a ring once its magic is written
+    atomic_thread_fence(memory_order_release);
+    created->magic = LOG_MAGIC;
+    ring = created;
+    return 0;
+}
+
+void log_close(void) {
+    // * Hand the ring over to the collector, which removes it once drained; the next lines go to the logfile directly
+    if (ring) {
+        log_ring *closing = ring;
+        ring = NULL;
+        atomic_store_explicit(&closing->closed, 1, memory_order_release);
+        munmap(closing, ring_size(closing->capacity));
+    }
+}
+
+void log_write(const char *text) {
+    /*
+     * Log a line (async-signal-safe: no lock, no allocation, no system call but the clock, and the write to the
+     * logfile without a ring).
+     * @param text Line without the timestamp and the PID, truncated to LOG_TEXT_MAX - 1 characters.
+     */
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    const uint64_t time = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    if (!ring) {
+        write_line(fallback, time, gettid(), text);
+        return;
+    }
+    // * A signal handler that interrupts the writer reserves the next record, it never touches this one
+    const uint64_t index = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    log_record *record = &ring->records[index % ring->capacity];
+    atomic_store_explicit(&record->sequence, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    record->time = time;
+    copy_text(record->text, text);
+    atomic_store_explicit(&record->sequence, 2 * (index + 1), memory_order_release);
+}
+
+void log_printf(const char *format, ...) {
+    // * Formatted log_write (not async-signal-safe: vsnprintf)
+    char text[LOG_TEXT_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    log_write(text);
+}
+
+int log_collect(const char *dir, const int fd) {
+    /*
+     * Drain the committed records of every ring of the directory into the logfile, sorted by time, in one write.
+     * Rings of processes that ended normally are removed once drained, the ones of processes that crashed are
+     * renamed with LOG_DEAD_SUFFIX and no longer followed.
+     * @param fd Logfile.
+     * @return Lines written, -1 on failure.
+     */
+    DIR *rings = opendir(dir);
+    if (!rings) {
+        return -1;
+    }
+    // * Follow the rings created since the last drain
+    const struct dirent *entry;
+    while ((entry = readdir(rings)) != NULL && num_collected < LOG_MAX_RINGS) {
+        int known = !is_ring(entry->d_name, 0);
+        for (int i = 0; i < num_collected && !known; i++) {
+            known = strcmp(collected[i].name, entry->d_name) == 0;
+        }
+        if (known) {
+            continue;
+        }
+        collected_ring *follow = &collected[num_collected];
+        follow->ring = map_ring(dir, entry->d_name, 1, &follow->size);
+        if (follow->ring) {
+            strcpy(follow->name, entry->d_name);
+            follow->uncommitted = UINT64_MAX;
+            num_collected++;
+        }
+    }
+    closedir(rings);
+    log_batch batch = {NULL, 0, 0};
+    for (int i = 0; i < num_collected; i++) {
+        collected_ring *follow = &collected[i];
+        const int closed = (int)atomic_load_explicit(&follow->ring->closed, memory_order_acquire);
+        // * Checked before the drain: a process gone then wrote its last record before it
+        const int dead = !closed && is_dead(follow->ring);
+        drain_ring(follow->ring, &follow->uncommitted, &batch);
+        if ((closed || dead) && atomic_load_explicit(&follow->ring->tail, memory_order_relaxed) ==
+            atomic_load_explicit(&follow->ring->head, memory_order_relaxed)) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", dir, follow->name);
+            if (closed) {
+                unlink(path);
+            } else {
+                char kept[PATH_MAX + sizeof(LOG_DEAD_SUFFIX)];
+                snprintf(kept, sizeof(kept), "%s%s", path, LOG_DEAD_SUFFIX);
+                rename(path, kept);
+            }
+            munmap(follow->ring, follow->size);
+            collected[i--] = collected[--num_collected];
+        }
+    }
+    return write_batch(fd, &batch);
+}
+
+int log_dump(const char *dir, const int fd) {
+    /*
+     * Print every record still in the rings of a directory, drained or not (the rings left by crashed processes),
+     * without changing them.
+     * @return Lines written, -1 on failure.
+     */
+    DIR *rings = opendir(dir);
+    if (!rings) {
+        return -1;
+    }
+    log_batch batch = {NULL, 0, 0};
+    const struct dirent *entry;
+    while ((entry = readdir(rings)) != NULL) {
+        size_t size;
+        log_ring *source = is_ring(entry->d_name, 1) ? map_ring(dir, entry->d_name, 0, &size) : NULL;
+        if (source) {
+            replay_ring(source, &batch);
+            munmap(source, size);
+        }
+    }
+    closedir(rings);
+    return write_batch(fd, &batch);
+}
+
+int log_remove(const char *dir) {
+    /*
+     * Remove the directory at the end of the game, unless it holds the rings of crashed processes.
+     * @return Rings kept, -1 on failure.
+     */
+    for (int i = 0; i < num_collected; i++) {
+        munmap(collected[i].ring, collected[i].size);
+    }
+    num_collected = 0;
+    DIR *rings = opendir(dir);
+    if (!rings) {
+        return -1;
+    }
+    int kept = 0;
+    const struct dirent *entry;
+    while ((entry = readdir(rings)) != NULL) {
+        kept += is_ring(entry->d_name, 1);
+    }
+    closedir(rings);
+    if (kept == 0) {
+        rmdir(dir);
+    }
+    return kept;
+}
+
+static size_t ring_size(const uint32_t capacity) {
+    return sizeof(log_ring) + (size_t)capacity * sizeof(log_record);
+}
+
+static void copy_text(char *dest, const char *src) {
+    // * strncpy without the padding (and without relying on the libc in a signal handler)
+    int i = 0;
+    for (; i < LOG_TEXT_MAX - 1 && src[i] != '\0'; i++) {
+        dest[i] = src[i];
+    }
+    dest[i] = '\0';
+}
+
+static void write_line(const int fd, const uint64_t time, const pid_t pid, const char *text) {
+    /*
+     * One line in the format of the logfile, with a single write (appends of other processes do not split it).
+     * Formatted by hand, without snprintf and localtime_r, so that a signal handler can write it.
+     */
+    if (fd < 0) {
+        return;
+    }
+    const long day = (((long)(time / 1000000000ull) + local_offset) % 86400 + 86400) % 86400;
+    char line[LOG_TEXT_MAX + 64];
+    int length = 0;
+    line[length++] = '[';
+    length += put_number(line + length, day / 3600, 2);
+    line[length++] = ':';
+    length += put_number(line + length, day / 60 % 60, 2);
+    line[length++] = ':';
+    length += put_number(line + length, day % 60, 2);
+    memcpy(line + length, "] PID: ", 7);
+    length += 7;
+    length += put_number(line + length, pid, 1);
+    memcpy(line + length, " - ", 3);
+    length += 3;
+    for (int i = 0; i < LOG_TEXT_MAX - 1 && text[i] != '\0'; i++) {
+        line[length++] = text[i];
+    }
+    line[length++] = '\n';
+    write_full(fd, line, (size_t)length);
+}
+
+static int put_number(char *dest, long value, const int digits) {
+    // * Decimal digits of a value >= 0, zero-padded to at least digits, without a terminator; returns their count
+    char reversed[20];
+    int count = 0;
+    do {
+        reversed[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 || count < digits);
+    for (int i = 0; i < count; i++) {
+        dest[i] = reversed[count - 1 - i];
+    }
+    return count;
+}
+
+static int is_ring(const char *name, const int dead) {
+    // * dead: also the crashed rings no longer followed
+    size_t length = strlen(name);
+    const size_t suffix = sizeof(LOG_DEAD_SUFFIX) - 1;
+    if (dead && length > suffix && strcmp(name + length - suffix, LOG_DEAD_SUFFIX) == 0) {
+        length -= suffix;
+    }
+    return length > 5 && strncmp(name + length - 5, ".ring", 5) == 0;
+}
+
+static int is_dead(const log_ring *source) {
+    // * The process (or thread) of a ring that is not closed is gone: it crashed
+    return kill(source->pid, 0) == -1 && errno == ESRCH;
+}
+
+static log_ring *map_ring(const char *dir, const char *name, const int writable, size_t *size) {
+    /*
+     * Map a ring of the directory.
+     * @param writable The collector writes the drained position, a dump only reads.
+     * @return The ring, NULL if the file is not a complete ring (yet).
+     */
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    const int fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat info;
+    log_ring *source = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(log_ring)) {
+        source = mmap(NULL, (size_t)info.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (source == MAP_FAILED) {
+        return NULL;
+    }
+    if (source->magic != LOG_MAGIC || (size_t)info.st_size < ring_size(source->capacity)) {
+        munmap(source, (size_t)info.st_size);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    *size = (size_t)info.st_size;
+    return source;
+}
+
+static void drain_ring(log_ring *source, uint64_t *uncommitted, log_batch *batch) {
+    /*
+     * Copy the committed records of a ring since the drained position into the batch, and move the position.
+     * - Records overwritten before they were drained (the ring lapped the collector) are counted as lost.
+     * - A record still uncommitted stops the drain; if it is still uncommitted at the next drain its writer died
+     *   while writing it (or never will), and it is skipped as lost.
+     */
+    const uint64_t head = atomic_load_explicit(&source->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&source->tail, memory_order_relaxed);
+    uint64_t lost = 0;
+    if (head - tail > source->capacity) {
+        lost += head - source->capacity - tail;
+        tail = head - source->capacity;
+    }
+    for (; tail < head; tail++) {
+        log_record *record = &source->records[tail % source->capacity];
+        const uint64_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        if (sequence < 2 * (tail + 1)) {
+            if (*uncommitted != tail) {
+                *uncommitted = tail;
+                break;
+            }
+            lost++;
+            continue;
+        }
+        log_line line;
+        line.time = record->time;
+        memcpy(line.text, record->text, LOG_TEXT_MAX);
+        line.text[LOG_TEXT_MAX - 1] = '\0';
+        atomic_thread_fence(memory_order_acquire);
+        // * Overwritten by a writer that lapped the ring, before or while it was copied
+        if (sequence != 2 * (tail + 1) ||
+            atomic_load_explicit(&record->sequence, memory_order_relaxed) != sequence) {
+            lost++;
+            continue;
+        }
+        batch_add(batch, line.time, source->pid, line.text);
+    }
+    if (tail == head) {
+        *uncommitted = UINT64_MAX;
+    }
+    atomic_store_explicit(&source->tail, tail, memory_order_release);
+    if (lost) {
+        char text[64];
+        snprintf(text, sizeof(text), "Log: %llu records of this process were lost.", (unsigned long long)lost);
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        batch_add(batch, (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec, source->pid, text);
+    }
+}
+
+static void replay_ring(const log_ring *source, log_batch *batch) {
+    // * Every committed record still in the ring, from the oldest
+    const uint64_t head = atomic_load_explicit((_Atomic uint64_t *)&source->head, memory_order_acquire);
+    for (uint64_t i = head > source->capacity ? head - source->capacity : 0; i < head; i++) {
+        const log_record *record = &source->records[i % source->capacity];
+        if (atomic_load_explicit((_Atomic uint64_t *)&record->sequence, memory_order_acquire) == 2 * (i + 1)) {
+            char text[LOG_TEXT_MAX];
+            memcpy(text, record->text, LOG_TEXT_MAX);
+            text[LOG_TEXT_MAX - 1] = '\0';
+            batch_add(batch, record->time, source->pid, text);
+        }
+    }
+}
+
+static int batch_add(log_batch *batch, const uint64_t time, const pid_t pid, const char *text) {
+    if (batch->count == batch->capacity) {
+        const int capacity = batch->capacity ? 2 * batch->capacity : 256;
+        log_line *lines = realloc(batch->lines, (size_t)capacity * sizeof(log_line));
+        if (!lines) {
+            return -1;
+        }
+        batch->lines = lines;
+        batch->capacity = capacity;
+    }
+    log_line *line = &batch->lines[batch->count++];
+    line->time = time;
+    line->pid = pid;
+    copy_text(line->text, text);
+    return 0;
+}
+
+static int write_batch(const int fd, log_batch *batch) {
+    // * The lines of every process in the order of their time, with one write
+    qsort(batch->lines, (size_t)batch->count, sizeof(log_line), by_time);
+    char *buf = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&buf, &size);
+    if (!out) {
+        free(batch->lines);
+        return -1;
+    }
+    for (int i = 0; i < batch->count; i++) {
+        const log_line *line = &batch->lines[i];
+        const time_t seconds = (time_t)(line->time / 1000000000ull);
+        struct tm t;
+        localtime_r(&seconds, &t);
+        fprintf(out, "[%02d:%02d:%02d] PID: %d - %s\n", t.tm_hour, t.tm_min, t.tm_sec, line->pid, line->text);
+    }
+    fclose(out);
+    const int result = size && write_full(fd, buf, size) == -1 ? -1 : batch->count;
+    free(buf);
+    free(batch->lines);
+    return result;
+}
+
+static int by_time(const void *a, const void *b) {
+    const uint64_t ta = ((const log_line *)a)->time, tb = ((const log_line *)b)->time;
+    return (ta > tb) - (ta < tb);
+}
@@ -0,0 +1,169 @@
+//
+// Created by Gian Marco Balia
+//
+// src/map_file.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "map_file.h"
+#include "pipe_io.h"
+
+static size_t aligned_size(size_t bytes);
+static uint64_t checksum_update(uint64_t hash, const void *data, size_t bytes);
+static int header_valid(const map_file_header *header, size_t file_size);
+
+int map_file_probe(const char *path, int *height, int *width) {
+    /*
+     * Read the size of the map stored in a file, without loading it.
+     * @return 0 on success, -1 if the file cannot be read or is not a map file of this version.
+     */
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    map_file_header header;
+    struct stat st;
+    const int result = fstat(fd, &st) == -1 || read_full(fd, &header, sizeof(header)) == -1 ||
+        !header_valid(&header, (size_t)st.st_size) ? -1 : 0;
+    close(fd);
+    if (result == 0) {
+        *height = header.height;
+        *width = header.width;
+    }
+    return result;
+}
+
+int map_file_load(const char *path, occupancy_map *map) {
+    /*
+     * Map a map file and use its layers in place. The mapping is private: the changes of the game stay in memory
+     * (copy on write) and the file is never modified. Only the small target table is copied, so that it can grow.
+     * @param map Replaced by the map of the file, release it with occupancy_free.
+     * @return 0 on success, -1 on failure (errno is EPROTO for an invalid or corrupted file).
+     */
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(map_file_header)) {
+        close(fd);
+        errno = EPROTO;
+        return -1;
+    }
+    const size_t size = (size_t)st.st_size;
+    unsigned char *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    const map_file_header *header = (const map_file_header *)base;
+    if (!header_valid(header, size) ||
+        checksum_update(0, base + sizeof(*header), size - sizeof(*header)) != header->checksum) {
+        munmap(base, size);
+        errno = EPROTO;
+        return -1;
+    }
+    occupancy_target *table = malloc((header->num_targets ? header->num_targets : 1) * sizeof(occupancy_target));
+    if (!table) {
+        munmap(base, size);
+        return -1;
+    }
+    memcpy(table, base + header->table_offset, header->num_targets * sizeof(occupancy_target));
+    const occupancy_map loaded = {
+        header->height, header->width, header->origin_x, header->origin_y, header->words_per_row,
+        (uint64_t *)(base + header->obstacles_offset), (uint64_t *)(base + header->targets_offset), table,
+        header->num_targets, header->num_targets, base, size,
+    };
+    // * The checksum only tells that the file is the one written: a map saved wrong is refused too
+    if (occupancy_validate(&loaded) == -1) {
+        free(table);
+        munmap(base, size);
+        errno = EPROTO;
+        return -1;
+    }
+    occupancy_free(map);
+    *map = loaded;
+    return 0;
+}
+
+int map_file_save(const char *path, const occupancy_map *map) {
+    /*
+     * Write a map to a file, through a temporary file renamed at the end so that a reader never sees half a map.
+     * @return 0 on success, -1 on failure.
+     */
+    const size_t layer_size = aligned_size(occupancy_words(map) * sizeof(uint64_t));
+    const size_t table_size = aligned_size(map->num_targets * sizeof(occupancy_target));
+    // * Copy the table entry by entry so that the padding of the structure is zero, like the rest of the file
+    occupancy_target *table = calloc(1, table_size ? table_size : 1);
+    if (!table) {
+        return -1;
+    }
+    for (int i = 0; i < map->num_targets; i++) {
+        table[i].cell = map->target_table[i].cell;
+        table[i].id = map->target_table[i].id;
+    }
+    map_file_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MAP_FILE_MAGIC;
+    header.version = MAP_FILE_VERSION;
+    header.height = map->height;
+    header.width = map->width;
+    header.origin_x = map->origin_x;
+    header.origin_y = map->origin_y;
+    header.words_per_row = map->words_per_row;
+    header.num_targets = map->num_targets;
+    header.obstacles_offset = sizeof(header);
+    header.targets_offset = header.obstacles_offset + layer_size;
+    header.table_offset = header.targets_offset + layer_size;
+    // * The layers are allocated (or mapped) with their padding to OCCUPANCY_ALIGN, always zero
+    header.checksum = checksum_update(checksum_update(checksum_update(0, map->obstacles, layer_size), map->targets,
+        layer_size), table, table_size);
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        free(table);
+        return -1;
+    }
+    int result = write_full(fd, &header, sizeof(header)) == -1 || write_full(fd, map->obstacles, layer_size) == -1 ||
+        write_full(fd, map->targets, layer_size) == -1 || write_full(fd, table, table_size) == -1 ? -1 : 0;
+    free(table);
+    if (close(fd) == -1 || result == -1 || rename(tmp_path, path) == -1) {
+        unlink(tmp_path);
+        result = -1;
+    }
+    return result;
+}
+
+static size_t aligned_size(const size_t bytes) {
+    return (bytes + OCCUPANCY_ALIGN - 1) / OCCUPANCY_ALIGN * OCCUPANCY_ALIGN;
+}
+
+static uint64_t checksum_update(uint64_t hash, const void *data, const size_t bytes) {
+    // * Multiply-xorshift over 64-bit words (every section is a multiple of OCCUPANCY_ALIGN bytes)
+    const uint64_t *words = data;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+        hash = (hash ^ words[i]) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+static int header_valid(const map_file_header *header, const size_t file_size) {
+    // * Check that the sections are where the layout puts them and inside the file
+    if (header->magic != MAP_FILE_MAGIC || header->version != MAP_FILE_VERSION || header->height <= 0 ||
+        header->width <= 0 || header->words_per_row != (header->width + 63) / 64 || header->num_targets < 0) {
+        return 0;
+    }
+    const size_t layer_size = aligned_size((size_t)header->height * header->words_per_row * sizeof(uint64_t));
+    const size_t table_size = aligned_size((size_t)header->num_targets * sizeof(occupancy_target));
+    return header->obstacles_offset == sizeof(*header) &&
+        header->targets_offset == header->obstacles_offset + layer_size &&
+        header->table_offset == header->targets_offset + layer_size &&
+        header->table_offset + table_size == file_size;
+}
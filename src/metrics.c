@@ -0,0 +1,192 @@
+//
+// Created by Gian Marco Balia
+//
+// src/metrics.c
+#define _GNU_SOURCE // * gettid
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "metrics.h"
+
+static void page_name(char *name, size_t size, pid_t pid);
+static int printed_before(metrics_page *const *pages, int page, int slot);
+
+metrics_page *metrics_open(const char *process) {
+    /*
+     * Create the page of this process, named after its PID (its TID for a thread of the threaded build).
+     * @param process Value of the `process` label of its samples.
+     * @return The page, NULL on failure (the update functions accept NULL and do nothing).
+     */
+    char name[64];
+    page_name(name, sizeof(name), gettid());
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(metrics_page)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    metrics_page *page = mmap(NULL, sizeof(metrics_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+    page->pid = gettid();
+    strncpy(page->process, process, sizeof(page->process) - 1);
+    atomic_init(&page->count, 0);
+    page->magic = METRICS_MAGIC;
+    return page;
+}
+
+void metrics_close(metrics_page *page) {
+    // * Remove the page: a watchdog that still maps it keeps reading the last values
+    if (!page) {
+        return;
+    }
+    char name[64];
+    page_name(name, sizeof(name), page->pid);
+    munmap(page, sizeof(metrics_page));
+    shm_unlink(name);
+}
+
+int metrics_register(metrics_page *page, const char *family, const char *labels, const char *help, const int type,
+    const double scale) {
+    /*
+     * Describe the next slot of the page.
+     * @param labels Labels of the sample without braces (e.g. `pipe="dynamics"`), "" for none.
+     * @param scale Unit of the value as published (1 for plain counts).
+     * @return Index of the slot, -1 if there is no page or no free slot.
+     */
+    if (!page) {
+        return -1;
+    }
+    const int slot = atomic_load_explicit(&page->count, memory_order_relaxed);
+    if (slot == METRICS_SLOTS) {
+        return -1;
+    }
+    metrics_slot *s = &page->slots[slot];
+    strncpy(s->family, family, sizeof(s->family) - 1);
+    strncpy(s->labels, labels, sizeof(s->labels) - 1);
+    strncpy(s->help, help, sizeof(s->help) - 1);
+    s->type = type;
+    s->scale = scale;
+    atomic_init(&s->value, 0);
+    atomic_store_explicit(&page->count, slot + 1, memory_order_release);
+    return slot;
+}
+
+void metrics_set(metrics_page *page, const int slot, const int64_t value) {
+    if (page && slot >= 0) {
+        atomic_store_explicit(&page->slots[slot].value, value, memory_order_relaxed);
+    }
+}
+
+void metrics_add(metrics_page *page, const int slot, const int64_t delta) {
+    // * Single writer: a plain read-modify-write, without the lock prefix of fetch_add
+    if (page && slot >= 0) {
+        const int64_t value = atomic_load_explicit(&page->slots[slot].value, memory_order_relaxed);
+        atomic_store_explicit(&page->slots[slot].value, value + delta, memory_order_relaxed);
+    }
+}
+
+metrics_page *metrics_attach(const pid_t pid) {
+    /*
+     * Map the page of a process read-only.
+     * @return The page, NULL if the process has none (yet).
+     */
+    char name[64];
+    page_name(name, sizeof(name), pid);
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat info;
+    metrics_page *page = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(metrics_page)) {
+        page = mmap(NULL, sizeof(metrics_page), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (page == MAP_FAILED) {
+        return NULL;
+    }
+    if (page->magic != METRICS_MAGIC) {
+        munmap(page, sizeof(metrics_page));
+        return NULL;
+    }
+    return page;
+}
+
+void metrics_detach(metrics_page *page) {
+    if (page) {
+        munmap(page, sizeof(metrics_page));
+    }
+}
+
+void metrics_remove(const pid_t pid) {
+    // * Remove the page of a process that could not do it (killed)
+    char name[64];
+    page_name(name, sizeof(name), pid);
+    shm_unlink(name);
+}
+
+void metrics_render(FILE *out, metrics_page *const *pages, const int count) {
+    /*
+     * Write the samples of the pages in Prometheus text format: every family once, with its HELP and TYPE, followed
+     * by its samples from every page, labelled with the process.
+     * @param pages Pages to render, NULL entries are skipped.
+     */
+    for (int p = 0; p < count; p++) {
+        const int slots = pages[p] ? atomic_load_explicit(&pages[p]->count, memory_order_acquire) : 0;
+        for (int s = 0; s < slots; s++) {
+            const metrics_slot *first = &pages[p]->slots[s];
+            if (printed_before(pages, p, s)) {
+                continue;
+            }
+            fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", first->family, first->help, first->family,
+                first->type == METRICS_GAUGE ? "gauge" : "counter");
+            for (int q = p; q < count; q++) {
+                const int n = pages[q] ? atomic_load_explicit(&pages[q]->count, memory_order_acquire) : 0;
+                for (int t = q == p ? s : 0; t < n; t++) {
+                    const metrics_slot *sample = &pages[q]->slots[t];
+                    if (strcmp(sample->family, first->family) != 0) {
+                        continue;
+                    }
+                    const int64_t value = atomic_load_explicit(&((metrics_slot *)sample)->value,
+                        memory_order_relaxed);
+                    fprintf(out, "%s{process=\"%s\"%s%s} ", sample->family, pages[q]->process,
+                        sample->labels[0] ? "," : "", sample->labels);
+                    if (sample->scale == 1) {
+                        fprintf(out, "%lld\n", (long long)value);
+                    } else {
+                        fprintf(out, "%.9g\n", (double)value * sample->scale);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void page_name(char *name, const size_t size, const pid_t pid) {
+    snprintf(name, size, "/dronegame_metrics.%d", pid);
+}
+
+static int printed_before(metrics_page *const *pages, const int page, const int slot) {
+    // * Whether the family of the slot appeared earlier, its samples were written with that first slot
+    const char *family = pages[page]->slots[slot].family;
+    for (int p = 0; p <= page; p++) {
+        const int slots = !pages[p] ? 0 : p == page ? slot :
+            atomic_load_explicit(&pages[p]->count, memory_order_acquire);
+        for (int s = 0; s < slots; s++) {
+            if (strcmp(pages[p]->slots[s].family, family) == 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -8,20 +8,57 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
 #include "macros.h"
+#include "occupancy.h"
+#include "channel.h"
+#include "components.h"
+#include "rng.h"
+#include "blue_noise.h"
+#include "generator.h"
+#include "map_file.h"
+#include "reachability.h"
+#include "heartbeat.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
 
-FILE *logfile;
 static volatile sig_atomic_t keep_running = 1;
+// * Density and minimum spacing of the obstacles of this game (./DroneGame -O and -G), set by obstacles_run
+static double obstacle_density = OBSTACLE_DENSITY;
+static int obstacle_spacing = OBSTACLE_SPACING;
 
-void signal_close(int signum) {
+// * Obstacles of the whole map, by rank in the row-major order of the layer
+typedef struct {
+    int32_t *cells;
+    long count;
+    rng_state rng;
+} moving_obstacles;
+
+// * Maps of the next rounds, generated while the blackboard does not need the generator
+typedef struct {
+    occupancy_map maps[MAP_QUEUE_DEPTH];
+    int32_t rounds[MAP_QUEUE_DEPTH];
+    uint64_t seed; // * Seed of the game the queued rounds belong to
+    int32_t last_round; // * Last round served or queued, -1 when the queue is not in use
+    int head, count;
+} map_queue;
+
+static int generate_map(occupancy_map *map, const generator_request *request, int map_height, int map_width);
+static int serve_map(map_queue *queue, occupancy_map *map, const generator_request *request, int map_height,
+    int map_width);
+static int fill_queue(map_queue *queue, int map_height, int map_width);
+static int load_map(channel *in, const generator_request *request, occupancy_map *map, int map_height, int map_width);
+static int track_obstacles(const occupancy_map *map, const generator_request *request, moving_obstacles *moving);
+static int move_obstacles(channel *out, occupancy_map *map, moving_obstacles *moving);
+static int generate_tile(occupancy_map *map, const generator_request *request, int world_height, int world_width);
+
+#ifndef DRONE_THREADS
+static void signal_close(int signum) {
     keep_running = 0;
 }
-void signal_triggered(int signum) {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    fprintf(logfile, "[%02d:%02d:%02d] PID: %d - %s\n", t->tm_hour, t->tm_min, t->tm_sec, getpid(),
-        "Obstacles is active.");
-    fflush(logfile);
+static void signal_triggered(int signum) {
+    log_write("Obstacles is active.");
 }
 
 int main (int argc, char *argv[]) {
@@ -29,6 +66,8 @@ int main (int argc, char *argv[]) {
      * Obstacles process
      * @param argv[1]: Read file descriptors
      * @param argv[2]: Write file descriptors
+     * @param argv[3], argv[4]: Map height and width (size of the whole world in chunked mode)
+     * @param argv[5], argv[6]: Obstacle density and minimum spacing in cells
     */
     // * Signal handler closure
     struct sigaction sa0;
@@ -49,8 +88,9 @@ int main (int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <read_fd> <write_fd> <logfile_fd>\n", argv[0]);
+    if (argc != 8) {
+        fprintf(stderr, "Usage: %s <read_fd> <write_fd> <height> <width> <density> <spacing> <logfile_fd>\n",
+            argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -66,35 +106,380 @@ int main (int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    // * Parse the map size
+    int map_height, map_width;
+    if (occupancy_parse_size(argv[3], argv[4], &map_height, &map_width) == -1) {
+        return EXIT_FAILURE;
+    }
+
+    // * Parse the obstacle density and spacing, checked by main
+    char *end;
+    const double density = strtod(argv[5], &end);
+    const int spacing = atoi(argv[6]);
+    if (*end != '\0' || !(density >= 0.0 && density <= MAX_OBSTACLE_DENSITY) || spacing < 1 ||
+        spacing > MAX_OBSTACLE_SPACING) {
+        fprintf(stderr, "Invalid obstacle density or spacing: %s %s\n", argv[5], argv[6]);
+        return EXIT_FAILURE;
+    }
+
     // * Parse logfile file descriptors
     int logfile_fd = atoi(argv[argc - 1]);
-    logfile = fdopen(logfile_fd, "a");
-    if (!logfile) {
-        perror("fdopen logfile");
+    channel *in = channel_from_fd(read_fd), *out = channel_from_fd(write_fd);
+    if (!in || !out) {
+        perror("channel");
         return EXIT_FAILURE;
     }
+    const int status = obstacles_run(in, out, map_height, map_width, density, spacing, logfile_fd);
+    channel_close(in);
+    channel_close(out);
+    return status;
+}
+#endif
 
-    // * Generate obstacles
-    srand(time(NULL));
-    int num_obstacles = (int)(GAME_HEIGHT * GAME_WIDTH * 0.001);
-    char grid[GAME_HEIGHT][GAME_WIDTH];
-    memset(grid, ' ', GAME_HEIGHT * GAME_WIDTH);
-    while (num_obstacles > 0) {
-        int x = (rand() % (GAME_WIDTH - 2)) + 1;
-        int y = (rand() % (GAME_HEIGHT - 2)) + 1;
+int obstacles_run(channel *in, channel *out, const int map_height, const int map_width, const double density,
+    const int spacing, const int logfile_fd) {
+    /*
+     * Loop of the obstacle generator: serve the requests of the blackboard (generator.h).
+     * @param in, out Channels from and to the blackboard, closed by the caller.
+     * @param map_height, map_width Map size (size of the whole world in chunked mode).
+     * @param density, spacing Fraction of the cells holding an obstacle and minimum distance between two of them.
+     * @return EXIT_SUCCESS when it is stopped or the blackboard is gone, EXIT_FAILURE on failure.
+     */
+    obstacle_density = density;
+    obstacle_spacing = spacing;
+    if (log_open("obstacles", logfile_fd) == -1) {
+        perror("log");
+    }
+    if (heartbeat_open() == -1) {
+        perror("heartbeat");
+    }
+    realtime_enter("obstacles");
+    startup_phase("obstacles", "ready");
 
-        if (grid[y][x] == ' ' && !(x == GAME_WIDTH/2 && y == GAME_HEIGHT/2)) {
-            grid[y][x] = 'o';
-            num_obstacles--;
+    // * Serve the requests of the blackboard until it closes the channel. Between two requests, generate the maps of
+    // * the next rounds and, while the stream is on, move the obstacles of the whole map every tick.
+    generator_request request;
+    occupancy_map map, tile;
+    memset(&map, 0, sizeof(map));
+    memset(&tile, 0, sizeof(tile));
+    moving_obstacles moving;
+    memset(&moving, 0, sizeof(moving));
+    map_queue queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.last_round = -1;
+    int streaming = 0;
+    struct timespec next_tick = {0, 0};
+    while (keep_running) {
+        // * The queue is filled one map per wake up so that a request never waits for more than one map
+        int timeout = -1;
+        if (streaming) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            const long remaining = (next_tick.tv_sec - now.tv_sec) * 1000 + (next_tick.tv_nsec - now.tv_nsec) / 1000000;
+            timeout = remaining > 0 ? (int)remaining : 0;
+        }
+        const int filling = queue.last_round >= 0 && queue.count < MAP_QUEUE_DEPTH;
+        if (filling) {
+            timeout = 0;
+        }
+        heartbeat_wait();
+        const int ready = channel_wait(in, timeout);
+        heartbeat_beat();
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+        if (ready == 0) {
+            if (filling && fill_queue(&queue, map_height, map_width) == -1) {
+                fprintf(stderr, "Failed to allocate the map.\n");
+                return EXIT_FAILURE;
+            }
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (streaming && (now.tv_sec > next_tick.tv_sec ||
+                (now.tv_sec == next_tick.tv_sec && now.tv_nsec >= next_tick.tv_nsec))) {
+                if (move_obstacles(out, &map, &moving) == -1) {
+                    perror("obstacle moves");
+                    return EXIT_FAILURE;
+                }
+                next_tick.tv_nsec += (long)(OBSTACLE_TICK * 1e9);
+                next_tick.tv_sec += next_tick.tv_nsec / 1000000000;
+                next_tick.tv_nsec %= 1000000000;
+            }
+            continue;
+        }
+        if (channel_read(in, &request, sizeof(request)) == -1) {
+            break;
+        }
+        if (request.type == GEN_STREAM) {
+            // * Acknowledge a stop so that the blackboard knows no move follows
+            const obstacle_moves_header end_of_stream = {OBSTACLE_MOVES_MAGIC, -1};
+            if (!request.count && channel_write(out, &end_of_stream, sizeof(end_of_stream)) == -1) {
+                perror("obstacle write");
+                return EXIT_FAILURE;
+            }
+            streaming = request.count && moving.count > 0;
+            clock_gettime(CLOCK_MONOTONIC, &next_tick);
+            continue;
+        }
+        if (request.type == GEN_LOAD) {
+            // * The rounds after a map file are generated from the seed as usual
+            int32_t status = load_map(in, &request, &map, map_height, map_width);
+            if (status == 0) {
+                status = track_obstacles(&map, &request, &moving);
+            }
+            queue.count = 0;
+            queue.seed = request.seed;
+            queue.last_round = 0;
+            if (channel_write(out, &status, sizeof(status)) == -1) {
+                perror("obstacle write");
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        int result;
+        if (request.type == GEN_TILE) {
+            result = generate_tile(&tile, &request, map_height, map_width);
+        } else {
+            result = serve_map(&queue, &map, &request, map_height, map_width);
+            if (result == 0) {
+                result = track_obstacles(&map, &request, &moving);
+            }
+        }
+        if (result == -1) {
+            fprintf(stderr, "Failed to allocate the map.\n");
+            return EXIT_FAILURE;
+        }
+        if (occupancy_write(out, request.type == GEN_TILE ? &tile : &map) == -1) {
+            perror("obstacle write");
+            return EXIT_FAILURE;
         }
     }
-
-    if (write(write_fd, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char)) == -1) {
-        perror("obstacle write");
-        return EXIT_FAILURE;
+    free(moving.cells);
+    for (int i = 0; i < MAP_QUEUE_DEPTH; i++) {
+        occupancy_free(&queue.maps[i]);
     }
-    // * Close the pipes
-    close(read_fd);
-    close(write_fd);
+    occupancy_free(&map);
+    occupancy_free(&tile);
+    heartbeat_close();
+    log_close();
     return EXIT_SUCCESS;
 }
+
+static int generate_map(occupancy_map *map, const generator_request *request, const int map_height,
+    const int map_width) {
+    /*
+     * Generate the obstacles of a whole map with blue noise (obstacle_density, at least obstacle_spacing cells
+     * apart), away from the border and the drone start. The time is linear in the number of obstacles.
+     * A map where the drone cannot reach REACH_MIN_FRACTION of the free cells is drawn again from a seed derived
+     * from the attempt (MAP_ATTEMPTS at most, the last one is kept), so the map still only depends on the round.
+     * @param map Destination map, (re)allocated to the map size.
+     * @param request Request of the blackboard, carrying the seed and the round.
+     * @return 0 on success, -1 on failure.
+     */
+    if (map->height != map_height || map->width != map_width || !map->obstacles) {
+        occupancy_free(map);
+        if (occupancy_init(map, map_height, map_width) == -1) {
+            return -1;
+        }
+    } else {
+        occupancy_clear(map);
+    }
+    const uint64_t round_seed = GEN_ROUND_SEED(request->seed, request->count);
+    for (int attempt = 0; attempt < MAP_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            occupancy_clear(map);
+        }
+        rng_state rng;
+        rng_seed(&rng, attempt ? rng_hash(round_seed, attempt, -5) : round_seed);
+        // * Keep the border free
+        const blue_noise_params params = {1, 1, map_height - 2, map_width - 2, obstacle_density,
+            obstacle_spacing};
+        if (blue_noise_place(map, map->obstacles, &params, &rng) == -1) {
+            return -1;
+        }
+        // * Keep the drone start free
+        occupancy_reset(map, map->obstacles, map_width/2, map_height/2);
+        // * The target layer is empty on this side: use it as scratch for the reachable cells, then clear it
+        long free_count;
+        const long reachable = reachability_fill(map, map_width/2, map_height/2, map->targets, &free_count);
+        memset(map->targets, 0, occupancy_words(map) * sizeof(uint64_t));
+        if (reachable == -1) {
+            return -1;
+        }
+        if (reachable >= REACH_MIN_FRACTION * free_count) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static int serve_map(map_queue *queue, occupancy_map *map, const generator_request *request, const int map_height,
+    const int map_width) {
+    /*
+     * Hand over the map of the round requested: popped from the queue when it was generated ahead of time,
+     * generated now otherwise (first round, other seed, or rounds skipped). The queue then follows this round.
+     * @param map Receives the map, its previous buffers go back to the queue.
+     * @return 0 on success, -1 on failure.
+     */
+    while (queue->count > 0 && (queue->seed != request->seed || queue->rounds[queue->head] < request->count)) {
+        queue->head = (queue->head + 1) % MAP_QUEUE_DEPTH;
+        queue->count--;
+    }
+    int result = 0;
+    if (queue->count > 0 && queue->rounds[queue->head] == request->count) {
+        // * Swap the buffers: the old map is recycled for a later round
+        const occupancy_map ready = queue->maps[queue->head];
+        queue->maps[queue->head] = *map;
+        *map = ready;
+        queue->head = (queue->head + 1) % MAP_QUEUE_DEPTH;
+        queue->count--;
+    } else {
+        queue->count = 0;
+        result = generate_map(map, request, map_height, map_width);
+    }
+    queue->seed = request->seed;
+    queue->last_round = request->count + queue->count;
+    return result;
+}
+
+static int load_map(channel *in, const generator_request *request, occupancy_map *map, const int map_height,
+    const int map_width) {
+    /*
+     * Read the path that follows a GEN_LOAD request and map the file in place of the current map.
+     * @return 0 on success, -1 if the file cannot be loaded or does not have the size of the game.
+     */
+    char path[GEN_PATH_MAX + 1];
+    if (request->count <= 0 || request->count > GEN_PATH_MAX || channel_read(in, path, request->count) == -1) {
+        return -1;
+    }
+    path[request->count] = '\0';
+    if (map_file_load(path, map) == -1) {
+        perror(path);
+        return -1;
+    }
+    return map->height == map_height && map->width == map_width ? 0 : -1;
+}
+
+static int fill_queue(map_queue *queue, const int map_height, const int map_width) {
+    /*
+     * Generate the map of the round after the last one queued.
+     * @return 0 on success, -1 on failure.
+     */
+    const int slot = (queue->head + queue->count) % MAP_QUEUE_DEPTH;
+    const generator_request ahead = {GEN_MAP, 0, 0, queue->last_round + 1, queue->seed};
+    if (generate_map(&queue->maps[slot], &ahead, map_height, map_width) == -1) {
+        return -1;
+    }
+    queue->rounds[slot] = ahead.count;
+    queue->last_round = ahead.count;
+    queue->count++;
+    return 0;
+}
+
+static int generate_tile(occupancy_map *map, const generator_request *request, const int world_height,
+    const int world_width) {
+    /*
+     * Generate the obstacles of one tile of a chunked world, with the same density as a whole map. The spacing is
+     * only kept inside the tile.
+     * The tile only depends on the seed and on its coordinates, so it can be dropped and regenerated identically.
+     * @param map Destination CHUNK_SIZE x CHUNK_SIZE map, its origin is set to the position of the tile.
+     * @param request Request of the blackboard, carrying the seed and the tile coordinates.
+     * @return 0 on success, -1 on failure.
+     */
+    if (map->height != CHUNK_SIZE || map->width != CHUNK_SIZE || !map->obstacles) {
+        occupancy_free(map);
+        if (occupancy_init(map, CHUNK_SIZE, CHUNK_SIZE) == -1) {
+            return -1;
+        }
+    } else {
+        occupancy_clear(map);
+    }
+    map->origin_x = request->tile_x * CHUNK_SIZE;
+    map->origin_y = request->tile_y * CHUNK_SIZE;
+    rng_state rng;
+    rng_seed(&rng, rng_hash(GEN_ROUND_SEED(request->seed, request->count), request->tile_x, request->tile_y));
+    const blue_noise_params params = {0, 0, CHUNK_SIZE, CHUNK_SIZE, obstacle_density, obstacle_spacing};
+    if (blue_noise_place(map, map->obstacles, &params, &rng) == -1) {
+        return -1;
+    }
+    // * Tiles on the border of the world lose the obstacles that fall on it, the drone start is kept free
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            const int world_x = map->origin_x + x, world_y = map->origin_y + y;
+            if (world_x <= 0 || world_x >= world_width - 1 || world_y <= 0 || world_y >= world_height - 1 ||
+                (world_x == world_width/2 && world_y == world_height/2)) {
+                occupancy_reset(map, map->obstacles, x, y);
+            }
+        }
+    }
+    return 0;
+}
+
+static int track_obstacles(const occupancy_map *map, const generator_request *request, moving_obstacles *moving) {
+    /*
+     * List the obstacles of a new map by rank (row-major order), which is the id used in the move events.
+     * @return 0 on success, -1 on failure.
+     */
+    moving->count = occupancy_popcount(map->obstacles, occupancy_words(map));
+    free(moving->cells);
+    moving->cells = malloc((moving->count ? moving->count : 1) * sizeof(int32_t));
+    if (!moving->cells) {
+        return -1;
+    }
+    long n = 0;
+    for (int row = 0; row < map->height; row++) {
+        for (int w = 0; w < map->words_per_row; w++) {
+            uint64_t bits = map->obstacles[(long)row * map->words_per_row + w];
+            while (bits) {
+                moving->cells[n++] = row * map->width + 64 * w + __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        }
+    }
+    rng_seed(&moving->rng, rng_hash(GEN_ROUND_SEED(request->seed, request->count), -3, -3));
+    return 0;
+}
+
+static int move_obstacles(channel *out, occupancy_map *map, moving_obstacles *moving) {
+    /*
+     * Move a random OBSTACLE_MOVE_FRACTION of the obstacles by one cell towards a free neighbour (the border
+     * stays free) and send the moves, in batches of at most OBSTACLE_MOVES_MAX.
+     * @return 0 on success, -1 on failure.
+     */
+    static const int step[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    long movers = (long)(moving->count * OBSTACLE_MOVE_FRACTION);
+    if (movers < 1) movers = 1;
+    struct {
+        obstacle_moves_header header;
+        obstacle_move moves[OBSTACLE_MOVES_MAX];
+    } batch;
+    batch.header.magic = OBSTACLE_MOVES_MAGIC;
+    batch.header.count = 0;
+    for (long i = 0; i < movers; i++) {
+        const int32_t id = (int32_t)rng_range(&moving->rng, moving->count);
+        const int32_t from = moving->cells[id];
+        const int *d = step[rng_range(&moving->rng, 4)];
+        const int x = from % map->width + d[0], y = from / map->width + d[1];
+        if (x < 1 || x >= map->width - 1 || y < 1 || y >= map->height - 1 ||
+            occupancy_test(map, map->obstacles, x, y)) {
+            continue;
+        }
+        occupancy_reset(map, map->obstacles, from % map->width, from / map->width);
+        occupancy_set(map, map->obstacles, x, y);
+        moving->cells[id] = y * map->width + x;
+        batch.moves[batch.header.count++] = (obstacle_move){id, from, moving->cells[id]};
+        if (batch.header.count == OBSTACLE_MOVES_MAX || i == movers - 1) {
+            if (channel_write(out, &batch, sizeof(batch.header) + batch.header.count * sizeof(obstacle_move)) == -1) {
+                return -1;
+            }
+            batch.header.count = 0;
+        }
+    }
+    if (batch.header.count > 0 &&
+        channel_write(out, &batch, sizeof(batch.header) + batch.header.count * sizeof(obstacle_move)) == -1) {
+        return -1;
+    }
+    return 0;
+}
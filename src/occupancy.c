@@ -0,0 +1,480 @@
+//
+// Created by Gian Marco Balia
+//
+// src/occupancy.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "occupancy.h"
+#include "channel.h"
+#include "macros.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OCCUPANCY_POPCNT_X86 1 // * The build targets the baseline ISA: popcnt is chosen at run time
+#endif
+
+static uint64_t *layer_alloc(size_t words);
+static int table_find(const occupancy_map *map, int32_t cell, int *pos);
+static uint64_t extract_bits(const uint64_t *row, int words, int width, long x);
+static int compare_targets(const void *a, const void *b);
+static uint64_t padding_mask(int width);
+static long popcount_swar(const uint64_t *layer, long words);
+#ifdef OCCUPANCY_POPCNT_X86
+static long popcount_popcnt(const uint64_t *layer, long words);
+#endif
+
+int occupancy_parse_size(const char *height_arg, const char *width_arg, int *height, int *width) {
+    /*
+     * Parse the map size passed on the command line by the main process.
+     * @param height_arg Height argument.
+     * @param width_arg Width argument.
+     * @param height Parsed height.
+     * @param width Parsed width.
+     * Dense maps are limited to MAX_GAME_SIDE by the main process, a chunked world is CHUNKED_WORLD_SIDE wide.
+     * @return 0 on success, -1 if a value is not a number in [MIN_GAME_SIDE, CHUNKED_WORLD_SIDE].
+     */
+    char *end_height, *end_width;
+    const long h = strtol(height_arg, &end_height, 10);
+    const long w = strtol(width_arg, &end_width, 10);
+    if (*end_height != '\0' || *end_width != '\0' || h < MIN_GAME_SIDE || h > CHUNKED_WORLD_SIDE ||
+        w < MIN_GAME_SIDE || w > CHUNKED_WORLD_SIDE) {
+        fprintf(stderr, "Invalid map size: %s x %s (allowed %d..%d)\n", height_arg, width_arg, MIN_GAME_SIDE,
+            CHUNKED_WORLD_SIDE);
+        return -1;
+    }
+    *height = (int)h;
+    *width = (int)w;
+    return 0;
+}
+
+int occupancy_init(occupancy_map *map, const int height, const int width) {
+    /*
+     * Allocate an empty map.
+     * @param map Map to initialise.
+     * @param height Height in cells.
+     * @param width Width in cells.
+     * @return 0 on success, -1 on failure.
+     */
+    memset(map, 0, sizeof(*map));
+    if (height <= 0 || width <= 0) {
+        return -1;
+    }
+    map->height = height;
+    map->width = width;
+    map->words_per_row = (width + 63) / 64;
+    map->obstacles = layer_alloc(occupancy_words(map));
+    map->targets = layer_alloc(occupancy_words(map));
+    if (!map->obstacles || !map->targets) {
+        occupancy_free(map);
+        return -1;
+    }
+    return 0;
+}
+
+void occupancy_free(occupancy_map *map) {
+    /*
+     * Release the layers (or the file mapping holding them) and the target table.
+     */
+    if (map->mapping) {
+        munmap(map->mapping, map->mapping_size);
+    } else {
+        free(map->obstacles);
+        free(map->targets);
+    }
+    free(map->target_table);
+    memset(map, 0, sizeof(*map));
+}
+
+void occupancy_clear(occupancy_map *map) {
+    /*
+     * Remove every obstacle and target, keeping the allocation.
+     */
+    memset(map->obstacles, 0, occupancy_words(map) * sizeof(uint64_t));
+    memset(map->targets, 0, occupancy_words(map) * sizeof(uint64_t));
+    map->num_targets = 0;
+}
+
+int occupancy_test(const occupancy_map *map, const uint64_t *layer, const int x, const int y) {
+    /*
+     * @return 1 if the cell is set in the layer, 0 if it is not or if it is outside the map.
+     */
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) {
+        return 0;
+    }
+    return (int)(layer[(long)y * map->words_per_row + x / 64] >> (x % 64) & 1);
+}
+
+void occupancy_set(const occupancy_map *map, uint64_t *layer, const int x, const int y) {
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) return;
+    layer[(long)y * map->words_per_row + x / 64] |= (uint64_t)1 << (x % 64);
+}
+
+void occupancy_reset(const occupancy_map *map, uint64_t *layer, const int x, const int y) {
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) return;
+    layer[(long)y * map->words_per_row + x / 64] &= ~((uint64_t)1 << (x % 64));
+}
+
+int occupancy_add_target(occupancy_map *map, const int x, const int y, const char id) {
+    /*
+     * Put a target in a cell: sets the bit and inserts (or updates) the entry of the target table.
+     * @return 0 on success, -1 on failure.
+     */
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) {
+        return -1;
+    }
+    const int32_t cell = y * map->width + x;
+    int pos;
+    if (table_find(map, cell, &pos)) {
+        map->target_table[pos].id = id;
+        return 0;
+    }
+    if (map->num_targets == map->capacity_targets) {
+        const int capacity = map->capacity_targets ? 2 * map->capacity_targets : 16;
+        occupancy_target *table = realloc(map->target_table, capacity * sizeof(occupancy_target));
+        if (!table) {
+            return -1;
+        }
+        map->target_table = table;
+        map->capacity_targets = capacity;
+    }
+    memmove(&map->target_table[pos + 1], &map->target_table[pos],
+        (map->num_targets - pos) * sizeof(occupancy_target));
+    map->target_table[pos].cell = cell;
+    map->target_table[pos].id = id;
+    map->num_targets++;
+    occupancy_set(map, map->targets, x, y);
+    return 0;
+}
+
+int occupancy_add_targets(occupancy_map *map, occupancy_target *targets, const int count) {
+    /*
+     * Put a batch of targets on free cells: sort the batch and merge it with the target table in one pass,
+     * instead of one insertion (and one memmove) per target.
+     * @param targets Batch of (cell, id), sorted in place. The cells must not be in the target table yet.
+     * @param count Size of the batch.
+     * @return 0 on success, -1 on failure.
+     */
+    if (count <= 0) {
+        return 0;
+    }
+    if (map->num_targets + count > map->capacity_targets) {
+        int capacity = map->capacity_targets ? map->capacity_targets : 16;
+        while (capacity < map->num_targets + count) capacity *= 2;
+        occupancy_target *table = realloc(map->target_table, capacity * sizeof(occupancy_target));
+        if (!table) {
+            return -1;
+        }
+        map->target_table = table;
+        map->capacity_targets = capacity;
+    }
+    qsort(targets, count, sizeof(occupancy_target), compare_targets);
+    // * Merge from the end so that the table can be updated in place
+    int i = map->num_targets - 1, j = count - 1, k = map->num_targets + count - 1;
+    while (j >= 0) {
+        if (i >= 0 && map->target_table[i].cell > targets[j].cell) {
+            map->target_table[k--] = map->target_table[i--];
+        } else {
+            map->target_table[k--] = targets[j];
+            occupancy_set(map, map->targets, targets[j].cell % map->width, targets[j].cell / map->width);
+            j--;
+        }
+    }
+    map->num_targets += count;
+    return 0;
+}
+
+int occupancy_remove_target(occupancy_map *map, const int x, const int y) {
+    /*
+     * Remove the target of a cell.
+     * @return 1 if a target was removed, 0 otherwise.
+     */
+    if (!occupancy_test(map, map->targets, x, y)) {
+        return 0;
+    }
+    occupancy_reset(map, map->targets, x, y);
+    int pos;
+    if (table_find(map, y * map->width + x, &pos)) {
+        memmove(&map->target_table[pos], &map->target_table[pos + 1],
+            (map->num_targets - pos - 1) * sizeof(occupancy_target));
+        map->num_targets--;
+    }
+    return 1;
+}
+
+char occupancy_target_id(const occupancy_map *map, const int x, const int y) {
+    /*
+     * @return Label of the target in the cell, '\0' if there is none.
+     */
+    int pos;
+    if (!occupancy_test(map, map->targets, x, y) || !table_find(map, y * map->width + x, &pos)) {
+        return '\0';
+    }
+    return map->target_table[pos].id;
+}
+
+void occupancy_union(uint64_t *dst, const uint64_t *a, const uint64_t *b, const long words) {
+    for (long i = 0; i < words; i++) {
+        dst[i] = a[i] | b[i];
+    }
+}
+
+void occupancy_intersection(uint64_t *dst, const uint64_t *a, const uint64_t *b, const long words) {
+    for (long i = 0; i < words; i++) {
+        dst[i] = a[i] & b[i];
+    }
+}
+
+long occupancy_popcount(const uint64_t *layer, const long words) {
+    /*
+     * Number of bits set: with the popcnt instruction when the CPU has it, four independent words per step, with a
+     * SWAR count of each word otherwise (without the instruction, __builtin_popcountll is a library call).
+     */
+#ifdef OCCUPANCY_POPCNT_X86
+    if (__builtin_cpu_supports("popcnt")) {
+        return popcount_popcnt(layer, words);
+    }
+#endif
+    return popcount_swar(layer, words);
+}
+
+long occupancy_sanitize(occupancy_map *map) {
+    /*
+     * Clear the bits of both layers in the padding past `width` of every row, where no cell is.
+     * @return Number of bits cleared.
+     */
+    const uint64_t padding = padding_mask(map->width);
+    long cleared = 0;
+    if (!padding) {
+        return 0;
+    }
+    for (long w = map->words_per_row - 1; w < occupancy_words(map); w += map->words_per_row) {
+        const uint64_t stray[2] = {map->obstacles[w] & padding, map->targets[w] & padding};
+        cleared += occupancy_popcount(stray, 2);
+        map->obstacles[w] &= ~padding;
+        map->targets[w] &= ~padding;
+    }
+    return cleared;
+}
+
+int occupancy_validate(const occupancy_map *map) {
+    /*
+     * Check what a frame or a file of the right size can still get wrong: a bit in the padding past `width` of a
+     * row, or a target table whose cells are outside the map, unsorted or repeated, whose label is not '0'..'9', or
+     * whose cell is not set in the target layer. The layers are checked one word per row (the padding is in the
+     * last word), so the cost follows the height and the number of targets, not the area.
+     * @return 0 if the map is consistent, -1 otherwise (errno is EPROTO).
+     */
+    const uint64_t padding = padding_mask(map->width);
+    uint64_t stray = 0;
+    if (padding) {
+        for (long w = map->words_per_row - 1; w < occupancy_words(map); w += map->words_per_row) {
+            stray |= (map->obstacles[w] | map->targets[w]) & padding;
+        }
+    }
+    const long cells = (long)map->height * map->width;
+    long previous = -1;
+    int invalid = stray != 0;
+    for (int i = 0; i < map->num_targets && !invalid; i++) {
+        const occupancy_target *target = &map->target_table[i];
+        invalid = target->cell <= previous || target->cell >= cells || target->id < '0' || target->id > '9' ||
+            !occupancy_test(map, map->targets, target->cell % map->width, target->cell / map->width);
+        previous = target->cell;
+    }
+    if (invalid) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+long occupancy_words(const occupancy_map *map) {
+    /*
+     * @return Number of 64-bit words of one layer.
+     */
+    return (long)map->height * map->words_per_row;
+}
+
+int occupancy_window(const occupancy_map *map, const int x0, const int y0, const int height, const int width,
+    occupancy_map *window) {
+    /*
+     * Extract the layers of the rectangle [x0, x0+width) x [y0, y0+height), 64 cells at a time.
+     * Cells outside the map are empty. The target table is not copied: the window only carries the bits.
+     * @param map Source map.
+     * @param window Destination, (re)allocated if its size differs.
+     * @return 0 on success, -1 on failure.
+     */
+    if (window->height != height || window->width != width || !window->obstacles) {
+        occupancy_free(window);
+        if (occupancy_init(window, height, width) == -1) {
+            return -1;
+        }
+    }
+    window->origin_x = map->origin_x + x0;
+    window->origin_y = map->origin_y + y0;
+    window->num_targets = 0;
+    for (int row = 0; row < height; row++) {
+        uint64_t *obstacles = &window->obstacles[(long)row * window->words_per_row];
+        uint64_t *targets = &window->targets[(long)row * window->words_per_row];
+        const int y = y0 + row;
+        if (y < 0 || y >= map->height) {
+            memset(obstacles, 0, window->words_per_row * sizeof(uint64_t));
+            memset(targets, 0, window->words_per_row * sizeof(uint64_t));
+            continue;
+        }
+        const uint64_t *src_obstacles = &map->obstacles[(long)y * map->words_per_row];
+        const uint64_t *src_targets = &map->targets[(long)y * map->words_per_row];
+        for (int w = 0; w < window->words_per_row; w++) {
+            const long x = (long)x0 + 64L * w;
+            obstacles[w] = extract_bits(src_obstacles, map->words_per_row, map->width, x);
+            targets[w] = extract_bits(src_targets, map->words_per_row, map->width, x);
+        }
+    }
+    occupancy_sanitize(window);
+    return 0;
+}
+
+int occupancy_write(channel *ch, const occupancy_map *map) {
+    /*
+     * Send the map through a channel: header, obstacle layer, target layer, target table.
+     * @return 0 on success, -1 on failure.
+     */
+    const occupancy_header header = {OCCUPANCY_MAGIC, map->height, map->width, map->origin_x, map->origin_y,
+        map->num_targets};
+    const size_t layer_size = occupancy_words(map) * sizeof(uint64_t);
+    if (channel_write(ch, &header, sizeof(header)) == -1 ||
+        channel_write(ch, map->obstacles, layer_size) == -1 ||
+        channel_write(ch, map->targets, layer_size) == -1 ||
+        channel_write(ch, map->target_table, map->num_targets * sizeof(occupancy_target)) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+int occupancy_read(channel *ch, occupancy_map *map) {
+    /*
+     * Receive a map sent with occupancy_write, checked with occupancy_validate.
+     * @param map Destination, (re)allocated if the received size differs.
+     * @return 0 on success, -1 on failure (errno is EPROTO for an invalid header or map).
+     */
+    occupancy_header header;
+    if (channel_read(ch, &header, sizeof(header)) == -1) {
+        return -1;
+    }
+    // * A corrupt or stale frame must not size the allocation: every map on the wire is a whole map or a view of
+    // * MIN_GAME_SIDE..MAX_GAME_SIDE cells a side (a chunked world only travels as tiles)
+    if (header.magic != OCCUPANCY_MAGIC || header.height < MIN_GAME_SIDE || header.height > MAX_GAME_SIDE ||
+        header.width < MIN_GAME_SIDE || header.width > MAX_GAME_SIDE || header.num_targets < 0 ||
+        header.num_targets > header.height * header.width) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (map->height != header.height || map->width != header.width || !map->obstacles) {
+        occupancy_free(map);
+        if (occupancy_init(map, header.height, header.width) == -1) {
+            return -1;
+        }
+    }
+    if (header.num_targets > map->capacity_targets) {
+        occupancy_target *table = realloc(map->target_table, header.num_targets * sizeof(occupancy_target));
+        if (!table) {
+            return -1;
+        }
+        map->target_table = table;
+        map->capacity_targets = header.num_targets;
+    }
+    map->origin_x = header.origin_x;
+    map->origin_y = header.origin_y;
+    map->num_targets = header.num_targets;
+    const size_t layer_size = occupancy_words(map) * sizeof(uint64_t);
+    if (channel_read(ch, map->obstacles, layer_size) == -1 ||
+        channel_read(ch, map->targets, layer_size) == -1 ||
+        channel_read(ch, map->target_table, map->num_targets * sizeof(occupancy_target)) == -1) {
+        return -1;
+    }
+    return occupancy_validate(map);
+}
+
+static uint64_t *layer_alloc(const size_t words) {
+    // * Zeroed, cache-line aligned allocation (aligned_alloc wants a multiple of the alignment)
+    size_t size = words * sizeof(uint64_t);
+    size = (size + OCCUPANCY_ALIGN - 1) / OCCUPANCY_ALIGN * OCCUPANCY_ALIGN;
+    uint64_t *layer = aligned_alloc(OCCUPANCY_ALIGN, size);
+    if (layer) {
+        memset(layer, 0, size);
+    }
+    return layer;
+}
+
+static int table_find(const occupancy_map *map, const int32_t cell, int *pos) {
+    // * Binary search: returns 1 if found, pos is the match or the insertion point
+    int lo = 0, hi = map->num_targets;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (map->target_table[mid].cell < cell) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = lo;
+    return lo < map->num_targets && map->target_table[lo].cell == cell;
+}
+
+static uint64_t extract_bits(const uint64_t *row, const int words, const int width, const long x) {
+    // * 64 bits of a row starting at cell x (which may be negative or past the end)
+    if (x >= width || x <= -64) {
+        return 0;
+    }
+    if (x < 0) {
+        return row[0] << (-x);
+    }
+    const long w = x / 64;
+    const int shift = (int)(x % 64);
+    uint64_t bits = row[w] >> shift;
+    if (shift && w + 1 < words) {
+        bits |= row[w + 1] << (64 - shift);
+    }
+    return bits;
+}
+
+static int compare_targets(const void *a, const void *b) {
+    const int32_t ca = ((const occupancy_target *)a)->cell, cb = ((const occupancy_target *)b)->cell;
+    return (ca > cb) - (ca < cb);
+}
+
+static uint64_t padding_mask(const int width) {
+    // * Bits of the last word of a row past the last cell, 0 when the row fills its words
+    return width % 64 ? ~(uint64_t)0 << (width % 64) : 0;
+}
+
+static long popcount_swar(const uint64_t *layer, const long words) {
+    // * The bits of a word summed by pairs, nibbles and bytes, then the bytes by one multiplication
+    long count = 0;
+    for (long i = 0; i < words; i++) {
+        uint64_t x = layer[i];
+        x -= (x >> 1) & 0x5555555555555555ull;
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        count += (long)((x * 0x0101010101010101ull) >> 56);
+    }
+    return count;
+}
+
+#ifdef OCCUPANCY_POPCNT_X86
+__attribute__((target("popcnt"))) static long popcount_popcnt(const uint64_t *layer, const long words) {
+    long counts[4] = {0, 0, 0, 0};
+    long i = 0;
+    for (; i + 4 <= words; i += 4) {
+        counts[0] += __builtin_popcountll(layer[i]);
+        counts[1] += __builtin_popcountll(layer[i + 1]);
+        counts[2] += __builtin_popcountll(layer[i + 2]);
+        counts[3] += __builtin_popcountll(layer[i + 3]);
+    }
+    for (; i < words; i++) {
+        counts[0] += __builtin_popcountll(layer[i]);
+    }
+    return counts[0] + counts[1] + counts[2] + counts[3];
+}
+#endif
@@ -0,0 +1,401 @@
+//
+// Created by Gian Marco Balia
+//
+// src/path_planner.c
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "path_planner.h"
+#include "physics.h"
+
+#define SQRT2 1.41421356237309505
+
+// * The 8 steps of the drone, and their length
+static const int STEP_X[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int STEP_Y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const double STEP_LENGTH[8] = {SQRT2, 1, SQRT2, 1, 1, SQRT2, 1, SQRT2};
+
+static int blocked(const path_planner *planner, int x, int y);
+static double enter_cost(const path_planner *planner, int x, int y, int step);
+static double heuristic(const path_planner *planner, int a, int b);
+static void calc_key(const path_planner *planner, int cell, double *k1, double *k2);
+static int key_less(double a1, double a2, double b1, double b2);
+static int update_vertex(path_planner *planner, int cell);
+static int queue_fix(path_planner *planner, int cell);
+static void queue_remove(path_planner *planner, int cell);
+static void sift_up(path_planner *planner, long i);
+static void sift_down(path_planner *planner, long i);
+static void add_field(path_planner *planner, int x, int y, int sign);
+static int compute_shortest_path(path_planner *planner);
+
+int planner_init(path_planner *planner, occupancy_map *map, int start_x, int start_y) {
+    /*
+     * Prepare the search on a map: the potential field of its obstacles, and its targets as the goals.
+     * @param map Map to plan on, it must outlive the planner (its layers are updated by planner_set_cell).
+     * @param start_x, start_y Drone position.
+     * @return 0 on success, -1 on failure.
+     */
+    memset(planner, 0, sizeof(*planner));
+    planner->map = map;
+    const long cells = (long)map->height * map->width;
+    planner->g = malloc(cells * sizeof(float));
+    planner->rhs = malloc(cells * sizeof(float));
+    planner->field = calloc(cells, sizeof(int32_t));
+    planner->slot = malloc(cells * sizeof(int32_t));
+    if (!planner->g || !planner->rhs || !planner->field || !planner->slot) {
+        planner_free(planner);
+        return -1;
+    }
+    for (long i = 0; i < cells; i++) {
+        planner->g[i] = INFINITY;
+        planner->rhs[i] = INFINITY;
+    }
+    memset(planner->slot, 0xff, cells * sizeof(int32_t));
+    // * Potential of the dynamics, (1/d - 1/RHO_OBST) / d^2 with d at least MIN_RHO_OBST, normalised to its maximum
+    const double peak = (1 / MIN_RHO_OBST - 1 / RHO_OBST) / (MIN_RHO_OBST * MIN_RHO_OBST);
+    for (int dy = -PLANNER_FIELD_RADIUS; dy <= PLANNER_FIELD_RADIUS; dy++) {
+        for (int dx = -PLANNER_FIELD_RADIUS; dx <= PLANNER_FIELD_RADIUS; dx++) {
+            double d = sqrt((double)dx * dx + (double)dy * dy);
+            int32_t value = 0;
+            if (d < RHO_OBST) {
+                d = d < MIN_RHO_OBST ? MIN_RHO_OBST : d;
+                value = (int32_t)lround(PLANNER_FIELD_ONE * (1 / d - 1 / RHO_OBST) / (d * d) / peak);
+            }
+            planner->kernel[(dy + PLANNER_FIELD_RADIUS) * PLANNER_KERNEL_SIDE + dx + PLANNER_FIELD_RADIUS] = value;
+        }
+    }
+    for (int y = 0; y < map->height; y++) {
+        for (int w = 0; w < map->words_per_row; w++) {
+            uint64_t bits = map->obstacles[(long)y * map->words_per_row + w];
+            while (bits) {
+                add_field(planner, 64 * w + __builtin_ctzll(bits), y, 1);
+                bits &= bits - 1;
+            }
+        }
+    }
+    start_x = start_x < 0 ? 0 : start_x >= map->width ? map->width - 1 : start_x;
+    start_y = start_y < 0 ? 0 : start_y >= map->height ? map->height - 1 : start_y;
+    planner->start = planner->last = start_y * map->width + start_x;
+    // * Every target is a goal: the search starts from all of them
+    for (int y = 0; y < map->height; y++) {
+        for (int w = 0; w < map->words_per_row; w++) {
+            uint64_t bits = map->targets[(long)y * map->words_per_row + w];
+            while (bits) {
+                if (update_vertex(planner, y * map->width + 64 * w + __builtin_ctzll(bits)) == -1) {
+                    planner_free(planner);
+                    return -1;
+                }
+                bits &= bits - 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void planner_free(path_planner *planner) {
+    /*
+     * Release the memory of the planner (not the map).
+     */
+    free(planner->g);
+    free(planner->rhs);
+    free(planner->field);
+    free(planner->slot);
+    free(planner->queue);
+    memset(planner, 0, sizeof(*planner));
+}
+
+int planner_set_cell(path_planner *planner, const int x, const int y, const int obstacle, const int target) {
+    /*
+     * Change a cell of the map and update the cells whose costs depend on it: the cell alone for a target, every
+     * cell in reach of the potential of an obstacle (and their neighbours) for an obstacle.
+     * @param obstacle, target New content of the cell.
+     * @return 0 on success, -1 on failure.
+     */
+    occupancy_map *map = planner->map;
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) {
+        return 0;
+    }
+    const int was_obstacle = occupancy_test(map, map->obstacles, x, y);
+    if (obstacle) occupancy_set(map, map->obstacles, x, y);
+    else occupancy_reset(map, map->obstacles, x, y);
+    if (target) occupancy_set(map, map->targets, x, y);
+    else occupancy_reset(map, map->targets, x, y);
+    if (was_obstacle == !!obstacle) {
+        return update_vertex(planner, y * map->width + x);
+    }
+    add_field(planner, x, y, obstacle ? 1 : -1);
+    const int reach = PLANNER_FIELD_RADIUS + 1;
+    for (int cy = y - reach > 0 ? y - reach : 0; cy <= y + reach && cy < map->height; cy++) {
+        for (int cx = x - reach > 0 ? x - reach : 0; cx <= x + reach && cx < map->width; cx++) {
+            if (update_vertex(planner, cy * map->width + cx) == -1) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void planner_move_start(path_planner *planner, int x, int y) {
+    /*
+     * Move the drone: the keys already queued stay valid up to the offset k_m, raised by the distance moved.
+     */
+    const occupancy_map *map = planner->map;
+    x = x < 0 ? 0 : x >= map->width ? map->width - 1 : x;
+    y = y < 0 ? 0 : y >= map->height ? map->height - 1 : y;
+    const int cell = y * map->width + x;
+    if (cell != planner->start) {
+        planner->km += heuristic(planner, planner->last, cell);
+        planner->last = cell;
+        planner->start = cell;
+    }
+}
+
+int planner_next_step(path_planner *planner, int *dx, int *dy) {
+    /*
+     * Repair the plan and give the direction from the drone towards the cell PLANNER_LOOKAHEAD steps ahead on the
+     * path to the nearest target (the drone moves by more than a cell per frame, aiming a few cells ahead smooths
+     * the turns).
+     * @param dx, dy Receive the direction, each in {-1, 0, 1}.
+     * @return 1 if there is a direction, 0 if no target can be reached, -1 on failure.
+     */
+    if (compute_shortest_path(planner) == -1) {
+        return -1;
+    }
+    const int width = planner->map->width;
+    const int x0 = planner->start % width, y0 = planner->start / width;
+    int x = x0, y = y0, first = -1;
+    for (int ahead = 0; ahead < PLANNER_LOOKAHEAD && (ahead == 0 || planner->g[y * width + x] != 0); ahead++) {
+        // * Follow the path: the neighbour with the least cost to a target through it
+        double best = INFINITY;
+        int next = -1;
+        for (int step = 0; step < 8; step++) {
+            const double cost = enter_cost(planner, x + STEP_X[step], y + STEP_Y[step], step);
+            if (cost == INFINITY) continue;
+            const double total = cost + planner->g[(y + STEP_Y[step]) * width + x + STEP_X[step]];
+            if (total < best) {
+                best = total;
+                next = step;
+            }
+        }
+        if (next == -1) {
+            break;
+        }
+        first = first == -1 ? next : first;
+        x += STEP_X[next];
+        y += STEP_Y[next];
+    }
+    if (first == -1) {
+        return 0;
+    }
+    // * Beyond the drone the costs may still be stale: if the path bends back, take its first step only
+    *dx = (x > x0) - (x < x0);
+    *dy = (y > y0) - (y < y0);
+    if (*dx == 0 && *dy == 0) {
+        *dx = STEP_X[first];
+        *dy = STEP_Y[first];
+    }
+    return 1;
+}
+
+static int blocked(const path_planner *planner, const int x, const int y) {
+    // * Obstacle, or outside the band where the dynamics clamps the drone
+    const occupancy_map *map = planner->map;
+    return x < DRONE_BORDER || x > map->width - DRONE_BORDER || y < DRONE_BORDER || y > map->height - DRONE_BORDER ||
+        occupancy_test(map, map->obstacles, x, y);
+}
+
+static double enter_cost(const path_planner *planner, const int x, const int y, const int step) {
+    // * Cost of the step `step` that ends in the cell (x, y), infinite if the cell is blocked
+    if (blocked(planner, x, y)) {
+        return INFINITY;
+    }
+    return STEP_LENGTH[step] * (1 + PLANNER_FIELD_WEIGHT * planner->field[y * planner->map->width + x] /
+        PLANNER_FIELD_ONE);
+}
+
+static double heuristic(const path_planner *planner, const int a, const int b) {
+    // * Octile distance, a lower bound of the cost since every step costs at least its length
+    const int width = planner->map->width;
+    const int dx = abs(a % width - b % width), dy = abs(a / width - b / width);
+    return dx > dy ? dx + (SQRT2 - 1) * dy : dy + (SQRT2 - 1) * dx;
+}
+
+static void calc_key(const path_planner *planner, const int cell, double *k1, double *k2) {
+    const double m = planner->g[cell] < planner->rhs[cell] ? planner->g[cell] : planner->rhs[cell];
+    *k1 = m + heuristic(planner, planner->start, cell) + planner->km;
+    *k2 = m;
+}
+
+static int key_less(const double a1, const double a2, const double b1, const double b2) {
+    return a1 < b1 || (a1 == b1 && a2 < b2);
+}
+
+static int update_vertex(path_planner *planner, const int cell) {
+    // * Recompute the lookahead of a cell from its neighbours (0 on a target) and queue it if it is inconsistent
+    const int width = planner->map->width, height = planner->map->height;
+    const int x = cell % width, y = cell / width;
+    if (occupancy_test(planner->map, planner->map->targets, x, y) && !blocked(planner, x, y)) {
+        planner->rhs[cell] = 0;
+    } else {
+        double best = INFINITY;
+        for (int step = 0; step < 8; step++) {
+            const int nx = x + STEP_X[step], ny = y + STEP_Y[step];
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+            const double total = enter_cost(planner, nx, ny, step) + planner->g[ny * width + nx];
+            if (total < best) best = total;
+        }
+        planner->rhs[cell] = (float)best;
+    }
+    return queue_fix(planner, cell);
+}
+
+static int queue_fix(path_planner *planner, const int cell) {
+    // * Queue an inconsistent cell with its current key, or take a consistent one out of the queue
+    if (planner->g[cell] == planner->rhs[cell]) {
+        queue_remove(planner, cell);
+        return 0;
+    }
+    double k1, k2;
+    calc_key(planner, cell, &k1, &k2);
+    long i = planner->slot[cell];
+    if (i < 0) {
+        if (planner->queue_count == planner->queue_capacity) {
+            const long capacity = planner->queue_capacity ? 2 * planner->queue_capacity : 1024;
+            planner_entry *queue = realloc(planner->queue, capacity * sizeof(planner_entry));
+            if (!queue) {
+                return -1;
+            }
+            planner->queue = queue;
+            planner->queue_capacity = capacity;
+        }
+        i = planner->queue_count++;
+        planner->queue[i].cell = cell;
+        planner->slot[cell] = (int32_t)i;
+    }
+    planner->queue[i].k1 = k1;
+    planner->queue[i].k2 = k2;
+    sift_up(planner, i);
+    sift_down(planner, planner->slot[cell]);
+    return 0;
+}
+
+static void queue_remove(path_planner *planner, const int cell) {
+    const long i = planner->slot[cell];
+    if (i < 0) {
+        return;
+    }
+    planner->slot[cell] = -1;
+    const planner_entry last = planner->queue[--planner->queue_count];
+    if (i == planner->queue_count) {
+        return;
+    }
+    planner->queue[i] = last;
+    planner->slot[last.cell] = (int32_t)i;
+    sift_up(planner, i);
+    sift_down(planner, planner->slot[last.cell]);
+}
+
+static void sift_up(path_planner *planner, long i) {
+    const planner_entry entry = planner->queue[i];
+    while (i > 0) {
+        const long parent = (i - 1) / 2;
+        if (!key_less(entry.k1, entry.k2, planner->queue[parent].k1, planner->queue[parent].k2)) break;
+        planner->queue[i] = planner->queue[parent];
+        planner->slot[planner->queue[i].cell] = (int32_t)i;
+        i = parent;
+    }
+    planner->queue[i] = entry;
+    planner->slot[entry.cell] = (int32_t)i;
+}
+
+static void sift_down(path_planner *planner, long i) {
+    const planner_entry entry = planner->queue[i];
+    for (;;) {
+        long child = 2 * i + 1;
+        if (child >= planner->queue_count) break;
+        if (child + 1 < planner->queue_count && key_less(planner->queue[child + 1].k1, planner->queue[child + 1].k2,
+            planner->queue[child].k1, planner->queue[child].k2)) {
+            child++;
+        }
+        if (!key_less(planner->queue[child].k1, planner->queue[child].k2, entry.k1, entry.k2)) break;
+        planner->queue[i] = planner->queue[child];
+        planner->slot[planner->queue[i].cell] = (int32_t)i;
+        i = child;
+    }
+    planner->queue[i] = entry;
+    planner->slot[entry.cell] = (int32_t)i;
+}
+
+static void add_field(path_planner *planner, const int x, const int y, const int sign) {
+    // * Add (sign 1) or remove (sign -1) the potential of an obstacle in (x, y)
+    const occupancy_map *map = planner->map;
+    for (int dy = -PLANNER_FIELD_RADIUS; dy <= PLANNER_FIELD_RADIUS; dy++) {
+        if (y + dy < 0 || y + dy >= map->height) continue;
+        for (int dx = -PLANNER_FIELD_RADIUS; dx <= PLANNER_FIELD_RADIUS; dx++) {
+            if (x + dx < 0 || x + dx >= map->width) continue;
+            planner->field[(y + dy) * map->width + x + dx] += sign *
+                planner->kernel[(dy + PLANNER_FIELD_RADIUS) * PLANNER_KERNEL_SIDE + dx + PLANNER_FIELD_RADIUS];
+        }
+    }
+}
+
+static int compute_shortest_path(path_planner *planner) {
+    /*
+     * Expand the queued cells in key order until the drone's cell is consistent and no queued key is smaller
+     * than its key (D* Lite). Only the cells whose cost changed, or that are on the way to the drone, are expanded.
+     */
+    const int width = planner->map->width, height = planner->map->height;
+    while (planner->queue_count > 0) {
+        double s1, s2;
+        calc_key(planner, planner->start, &s1, &s2);
+        const planner_entry top = planner->queue[0];
+        // * Away from the obstacles the costs equal the heuristic and the keys of the path tie with the drone's:
+        // * the ties within the rounding of the costs are expanded too, else a stale path may be left behind
+        if (top.k1 > s1 + PLANNER_KEY_SLACK * (1 + s1) && planner->rhs[planner->start] <= planner->g[planner->start]) {
+            break;
+        }
+        const int cell = top.cell, x = cell % width, y = cell / width;
+        double k1, k2;
+        calc_key(planner, cell, &k1, &k2);
+        if (key_less(top.k1, top.k2, k1, k2)) {
+            // * Queued before the drone moved: requeue with the current key
+            planner->queue[0].k1 = k1;
+            planner->queue[0].k2 = k2;
+            sift_down(planner, 0);
+            continue;
+        }
+        if (planner->g[cell] > planner->rhs[cell]) {
+            // * The cost of the cell dropped: lower the lookahead of its neighbours through it
+            planner->g[cell] = planner->rhs[cell];
+            queue_remove(planner, cell);
+            const int target_blocked = blocked(planner, x, y);
+            for (int step = 0; step < 8 && !target_blocked; step++) {
+                // * The neighbour n reaches the cell with the opposite step, of the same length
+                const int nx = x - STEP_X[step], ny = y - STEP_Y[step];
+                if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+                const int neighbour = ny * width + nx;
+                const float total = (float)(enter_cost(planner, x, y, step) + planner->g[cell]);
+                if (total < planner->rhs[neighbour] && planner->rhs[neighbour] != 0) {
+                    planner->rhs[neighbour] = total;
+                    if (queue_fix(planner, neighbour) == -1) {
+                        return -1;
+                    }
+                }
+            }
+        } else {
+            // * The cost of the cell rose: recompute it and the neighbours that may have gone through it
+            planner->g[cell] = INFINITY;
+            if (update_vertex(planner, cell) == -1) {
+                return -1;
+            }
+            for (int step = 0; step < 8; step++) {
+                const int nx = x - STEP_X[step], ny = y - STEP_Y[step];
+                if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+                if (update_vertex(planner, ny * width + nx) == -1) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
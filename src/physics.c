@@ -0,0 +1,35 @@
+//
+// Created by Gian Marco Balia
+//
+// src/physics.c
+#include "physics.h"
+#include "macros.h"
+
+int drone_integrate(const double force, const int previous, const int current) {
+    /*
+     * One step of the damped equation of motion along one axis.
+     * @param force Total force along the axis.
+     * @param previous Position at the previous step.
+     * @param current Position at the current step.
+     * @return Position at the next step.
+     */
+    return (int)(
+        (TIME*TIME*force - DRONE_MASS*previous + (2*DRONE_MASS + DAMPING*TIME)*current) / (DRONE_MASS + DAMPING*TIME)
+    );
+}
+
+int drone_clamp(const int position, const int size) {
+    /*
+     * Clamp a position to the map boundaries so the drone does not jump outside.
+     * @param position Position along one axis.
+     * @param size Size of the map along that axis.
+     * @return Clamped position.
+     */
+    if (position < DRONE_BORDER) {
+        return DRONE_BORDER;
+    }
+    if (position > size - DRONE_BORDER) {
+        return size - DRONE_BORDER;
+    }
+    return position;
+}
@@ -0,0 +1,51 @@
+//
+// Created by Gian Marco Balia
+//
+// src/pipe_io.c
+#include <unistd.h>
+#include <errno.h>
+#include "pipe_io.h"
+
+ssize_t read_full(const int fd, void *buf, const size_t size) {
+    /*
+     * Read exactly size bytes.
+     * @param fd File descriptor to read from.
+     * @param buf Destination buffer.
+     * @param size Number of bytes to read.
+     * @return size on success, -1 on error or if the other end is closed before the end of the transfer.
+     */
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = read(fd, (char *)buf + done, size - done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EPIPE;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+ssize_t write_full(const int fd, const void *buf, const size_t size) {
+    /*
+     * Write exactly size bytes.
+     * @param fd File descriptor to write to.
+     * @param buf Source buffer.
+     * @param size Number of bytes to write.
+     * @return size on success, -1 on error.
+     */
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = write(fd, (const char *)buf + done, size - done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
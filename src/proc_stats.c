@@ -0,0 +1,69 @@
+//
+// Created by Gian Marco Balia
+//
+// src/proc_stats.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "proc_stats.h"
+
+static ssize_t read_proc(pid_t pid, int thread, const char *file, char *buf, size_t size);
+static uint64_t status_field(const char *status, const char *name);
+
+int proc_sample_read(const pid_t pid, const int thread, proc_sample *sample) {
+    /*
+     * Sample the CPU time, resident set, context switches and run-queue delay of a process.
+     * @param thread pid is the TID of a thread of the calling process.
+     * @param sample Filled with the cumulative values.
+     * @return 0 on success, -1 if the process is gone or procfs cannot be read.
+     */
+    char buf[4096];
+    memset(sample, 0, sizeof(*sample));
+    // * The name of the command may contain spaces and parentheses: the fields start after the last ')'
+    if (read_proc(pid, thread, "stat", buf, sizeof(buf)) <= 0) {
+        return -1;
+    }
+    const char *fields = strrchr(buf, ')');
+    unsigned long long utime, stime;
+    long rss_pages;
+    if (!fields || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d "
+        "%*d %*u %*u %ld", &utime, &stime, &rss_pages) != 3) {
+        return -1;
+    }
+    sample->cpu_ticks = utime + stime;
+    sample->rss_bytes = rss_pages > 0 ? (uint64_t)rss_pages * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+    if (read_proc(pid, thread, "status", buf, sizeof(buf)) <= 0) {
+        return -1;
+    }
+    sample->voluntary = status_field(buf, "\nvoluntary_ctxt_switches:");
+    sample->involuntary = status_field(buf, "\nnonvoluntary_ctxt_switches:");
+    unsigned long long run_ns, wait_ns;
+    if (read_proc(pid, thread, "schedstat", buf, sizeof(buf)) > 0 && sscanf(buf, "%llu %llu", &run_ns, &wait_ns) == 2) {
+        sample->run_ns = run_ns;
+        sample->wait_ns = wait_ns;
+        sample->has_schedstat = 1;
+    }
+    return 0;
+}
+
+static ssize_t read_proc(const pid_t pid, const int thread, const char *file, char *buf, const size_t size) {
+    // * Whole file in one read (procfs generates it at once), NUL-terminated
+    char path[64];
+    snprintf(path, sizeof(path), thread ? "/proc/self/task/%d/%s" : "/proc/%d/%s", pid, file);
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    const ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    buf[n > 0 ? n : 0] = '\0';
+    return n;
+}
+
+static uint64_t status_field(const char *status, const char *name) {
+    // * Value of a "\nName:\tvalue" line (the newline keeps "voluntary" from matching "nonvoluntary"), 0 if missing
+    const char *line = strstr(status, name);
+    return line ? strtoull(line + strlen(name), NULL, 10) : 0;
+}
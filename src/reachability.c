@@ -0,0 +1,279 @@
+//
+// Created by Gian Marco Balia
+//
+// src/reachability.c
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "reachability.h"
+#include "physics.h"
+
+typedef struct {
+    const occupancy_map *map;
+    const uint64_t *columns; // * Mask of the columns inside the band, one word per word of a row
+    uint64_t *reach;
+    int y0, y1; // * Rows of the band [y0, y1]
+    const uint64_t *above, *below; // * Frozen copies of the neighbour rows, NULL at the border of the band
+    int start; // * Row of the start cell if it is in the band, -1 otherwise
+    int result; // * 0 on success, -1 on failure
+} reach_band;
+
+static uint64_t fill_up(uint64_t seeds, uint64_t free);
+static uint64_t fill_down(uint64_t seeds, uint64_t free);
+static const uint64_t *row_at(const reach_band *band, int y);
+static int grow_word(const reach_band *band, int y, int w);
+static int grow_tile(const reach_band *band, int y0, int y1, int w);
+static void *fill_band(void *arg);
+
+long reachability_fill(const occupancy_map *map, const int start_x, const int start_y, uint64_t *reach,
+    long *free_count) {
+    /*
+     * Mark the cells reachable by the drone from its start.
+     * @param reach Layer with the stride of the map, overwritten with the reachable cells.
+     * @param free_count If not NULL, receives the number of free cells of the band (reachable or not).
+     * @return Number of reachable cells, -1 on failure.
+     */
+    const int wpr = map->words_per_row;
+    const long words = occupancy_words(map);
+    memset(reach, 0, words * sizeof(uint64_t));
+    const int x0 = DRONE_BORDER, x1 = map->width - DRONE_BORDER;
+    const int y0 = DRONE_BORDER, y1 = map->height - DRONE_BORDER;
+    if (free_count) {
+        *free_count = 0;
+    }
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+    uint64_t *columns = calloc(wpr, sizeof(uint64_t));
+    if (!columns) {
+        return -1;
+    }
+    for (int w = x0 / 64; w <= x1 / 64; w++) {
+        uint64_t mask = ~(uint64_t)0;
+        if (64 * w < x0) mask &= ~(uint64_t)0 << (x0 - 64 * w);
+        if (64 * w + 63 > x1) mask &= ~(uint64_t)0 >> (63 - (x1 - 64 * w));
+        columns[w] = mask;
+    }
+    if (free_count) {
+        for (int y = y0; y <= y1; y++) {
+            for (int w = 0; w < wpr; w++) {
+                *free_count += __builtin_popcountll(~map->obstacles[(long)y * wpr + w] & columns[w]);
+            }
+        }
+    }
+    if (start_x < x0 || start_x > x1 || start_y < y0 || start_y > y1 ||
+        occupancy_test(map, map->obstacles, start_x, start_y)) {
+        free(columns);
+        return 0;
+    }
+    // * Seed with the run of the start cell, so that every reachable word is closed under the fill of its runs
+    const long start_word = (long)start_y * wpr + start_x / 64;
+    const uint64_t start_free = ~map->obstacles[start_word] & columns[start_x / 64];
+    reach[start_word] = fill_down(fill_up((uint64_t)1 << (start_x % 64), start_free), start_free);
+    // * One band per thread on large maps
+    int threads = 1;
+    if ((long)map->height * map->width >= REACH_PARALLEL_CELLS) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus > REACH_MAX_THREADS ? REACH_MAX_THREADS : (int)cpus;
+    }
+    if (threads > (y1 - y0 + 1) / 2) {
+        threads = 1;
+    }
+    reach_band bands[REACH_MAX_THREADS];
+    uint64_t *halos = threads > 1 ? calloc((size_t)2 * threads * wpr, sizeof(uint64_t)) : NULL;
+    if (threads > 1 && !halos) {
+        free(columns);
+        return -1;
+    }
+    const int rows = y1 - y0 + 1;
+    for (int i = 0; i < threads; i++) {
+        bands[i] = (reach_band){map, columns, reach, y0 + (int)((long)rows * i / threads),
+            y0 + (int)((long)rows * (i + 1) / threads) - 1, NULL, NULL, -1, 0};
+        if (start_y >= bands[i].y0 && start_y <= bands[i].y1) bands[i].start = start_y;
+        if (i > 0) bands[i].above = halos + (size_t)(2 * i) * wpr;
+        if (i < threads - 1) bands[i].below = halos + (size_t)(2 * i + 1) * wpr;
+    }
+    int changed;
+    do {
+        // * Freeze the border rows of the neighbours, fill every band, then check whether a border moved
+        for (int i = 0; i < threads; i++) {
+            if (bands[i].above) memcpy((uint64_t *)bands[i].above, reach + (long)(bands[i].y0 - 1) * wpr,
+                wpr * sizeof(uint64_t));
+            if (bands[i].below) memcpy((uint64_t *)bands[i].below, reach + (long)(bands[i].y1 + 1) * wpr,
+                wpr * sizeof(uint64_t));
+        }
+        pthread_t tids[REACH_MAX_THREADS];
+        int started = 0;
+        for (int i = 1; i < threads; i++) {
+            if (pthread_create(&tids[i], NULL, fill_band, &bands[i]) != 0) break;
+            started = i;
+        }
+        for (int i = started + 1; i < threads; i++) {
+            fill_band(&bands[i]); // * Fall back to this thread if a thread cannot be started
+        }
+        fill_band(&bands[0]);
+        for (int i = 1; i <= started; i++) {
+            pthread_join(tids[i], NULL);
+        }
+        changed = 0;
+        for (int i = 0; i < threads; i++) {
+            if (bands[i].result == -1) {
+                free(halos);
+                free(columns);
+                return -1;
+            }
+            bands[i].start = -1;
+        }
+        for (int i = 0; i < threads && !changed; i++) {
+            changed = (bands[i].above && memcmp(bands[i].above, reach + (long)(bands[i].y0 - 1) * wpr,
+                wpr * sizeof(uint64_t))) || (bands[i].below && memcmp(bands[i].below,
+                reach + (long)(bands[i].y1 + 1) * wpr, wpr * sizeof(uint64_t)));
+        }
+    } while (changed);
+    free(halos);
+    free(columns);
+    return occupancy_popcount(reach, words);
+}
+
+static uint64_t fill_up(uint64_t seeds, uint64_t free) {
+    // * Propagate the seeds towards the higher bits along the runs of free bits (occluded fill in 6 steps)
+    seeds &= free;
+    seeds |= free & (seeds << 1);
+    free &= free << 1;
+    seeds |= free & (seeds << 2);
+    free &= free << 2;
+    seeds |= free & (seeds << 4);
+    free &= free << 4;
+    seeds |= free & (seeds << 8);
+    free &= free << 8;
+    seeds |= free & (seeds << 16);
+    free &= free << 16;
+    seeds |= free & (seeds << 32);
+    return seeds;
+}
+
+static uint64_t fill_down(uint64_t seeds, uint64_t free) {
+    // * Same as fill_up towards the lower bits
+    seeds &= free;
+    seeds |= free & (seeds >> 1);
+    free &= free >> 1;
+    seeds |= free & (seeds >> 2);
+    free &= free >> 2;
+    seeds |= free & (seeds >> 4);
+    free &= free >> 4;
+    seeds |= free & (seeds >> 8);
+    free &= free >> 8;
+    seeds |= free & (seeds >> 16);
+    free &= free >> 16;
+    seeds |= free & (seeds >> 32);
+    return seeds;
+}
+
+static const uint64_t *row_at(const reach_band *band, const int y) {
+    // * Reachable cells of the row y as seen from the band: its own rows, or the frozen rows around it
+    if (y >= band->y0 && y <= band->y1) return band->reach + (long)y * band->map->words_per_row;
+    if (y == band->y0 - 1) return band->above;
+    if (y == band->y1 + 1) return band->below;
+    return NULL;
+}
+
+static int grow_word(const reach_band *band, const int y, const int w) {
+    // * Add to the word w of the row y the cells next to its reachable neighbours (8-connected, across words
+    // * too), then fill its runs of free cells. Returns 1 if the word changed.
+    const int wpr = band->map->words_per_row;
+    const uint64_t free = ~band->map->obstacles[(long)y * wpr + w] & band->columns[w];
+    uint64_t *row = band->reach + (long)y * wpr;
+    const uint64_t *above = row_at(band, y - 1), *below = row_at(band, y + 1);
+    uint64_t seeds = row[w], around = 0;
+    if (above) around |= above[w];
+    if (below) around |= below[w];
+    seeds |= around | (around << 1) | (around >> 1);
+    if (w > 0) {
+        seeds |= (row[w - 1] | (above ? above[w - 1] : 0) | (below ? below[w - 1] : 0)) >> 63;
+    }
+    if (w < wpr - 1) {
+        seeds |= (row[w + 1] | (above ? above[w + 1] : 0) | (below ? below[w + 1] : 0)) << 63;
+    }
+    seeds &= free;
+    if (!(seeds & ~row[w])) {
+        return 0;
+    }
+    row[w] = fill_down(fill_up(seeds, free), free);
+    return 1;
+}
+
+static int grow_tile(const reach_band *band, const int y0, const int y1, const int w) {
+    // * Alternate downward and upward sweeps over the rows [y0, y1] of the word column w until a sweep changes
+    // * nothing. The tile stays in the L1 cache, so the paths that wind inside it cost no queueing.
+    // * Returns 1 if the tile changed.
+    int changed = 0, sweep, down = 1;
+    do {
+        sweep = 0;
+        if (down) {
+            for (int y = y0; y <= y1; y++) sweep |= grow_word(band, y, w);
+        } else {
+            for (int y = y1; y >= y0; y--) sweep |= grow_word(band, y, w);
+        }
+        changed |= sweep;
+        down = !down;
+    } while (sweep);
+    return changed;
+}
+
+static void *fill_band(void *arg) {
+    /*
+     * Breadth-first search over the tiles of the band (64 rows of one word column): a queued tile converges on its
+     * own, and when it changes its 8 neighbours are queued.
+     */
+    reach_band *band = arg;
+    const int wpr = band->map->words_per_row;
+    const int tiles_y = (band->y1 - band->y0) / REACH_TILE_ROWS + 1;
+    const long tiles = (long)tiles_y * wpr;
+    long *queue = malloc((size_t)tiles * sizeof(long));
+    char *queued = calloc(tiles, 1);
+    if (!queue || !queued) {
+        free(queue);
+        free(queued);
+        band->result = -1;
+        return NULL;
+    }
+    long head = 0, count = 0;
+    // * New cells can only come from the start or from the frozen rows around the band
+    // * (the whole row of tiles of the start, since the start cell may only extend a neighbour of its tile)
+    for (int w = 0; w < wpr; w++) {
+        const int start_tile = band->start >= 0 ? (band->start - band->y0) / REACH_TILE_ROWS : -2;
+        const long first[5] = {start_tile >= 0 ? (long)start_tile * wpr + w : -1,
+            start_tile >= 1 ? (long)(start_tile - 1) * wpr + w : -1,
+            start_tile >= 0 && start_tile + 1 < tiles_y ? (long)(start_tile + 1) * wpr + w : -1,
+            band->above ? w : -1, band->below ? (long)(tiles_y - 1) * wpr + w : -1};
+        for (int i = 0; i < 5; i++) {
+            if (first[i] >= 0 && !queued[first[i]]) {
+                queued[first[i]] = 1;
+                queue[(head + count++) % tiles] = first[i];
+            }
+        }
+    }
+    while (count > 0) {
+        const long tile = queue[head];
+        head = (head + 1) % tiles;
+        count--;
+        queued[tile] = 0;
+        const int ty = (int)(tile / wpr), w = (int)(tile % wpr);
+        const int y0 = band->y0 + ty * REACH_TILE_ROWS;
+        const int y1 = y0 + REACH_TILE_ROWS - 1 < band->y1 ? y0 + REACH_TILE_ROWS - 1 : band->y1;
+        if (!grow_tile(band, y0, y1, w)) continue;
+        for (int ny = ty - 1; ny <= ty + 1; ny++) {
+            for (int nw = w - 1; nw <= w + 1; nw++) {
+                const long next = (long)ny * wpr + nw;
+                if (ny < 0 || ny >= tiles_y || nw < 0 || nw >= wpr || queued[next]) continue;
+                queued[next] = 1;
+                queue[(head + count++) % tiles] = next;
+            }
+        }
+    }
+    free(queue);
+    free(queued);
+    band->result = 0;
+    return NULL;
+}
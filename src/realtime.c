@@ -0,0 +1,141 @@
+//
+// Created by Gian Marco Balia
+//
+// src/realtime.c
+#define _GNU_SOURCE // * CPU affinity
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include "realtime.h"
+#include "log_ring.h"
+
+#define REALTIME_PROCESSES 3 // * Frame-critical processes in REALTIME_ENV
+
+static void prefault_stack(void);
+static void prefault_heap(void);
+static int lock_memory(void);
+
+void realtime_enter(const char *process) {
+    /*
+     * Apply the low-jitter mode given by main in the environment to this process (nothing without it).
+     * Every step that fails is logged and skipped: the game runs as without the mode.
+     * @param process "blackboard", "dynamics" or "input" for a frame-critical process, any other name for a process
+     * that leaves their cores to them.
+     */
+    const char *spec = getenv(REALTIME_ENV);
+    if (!spec) {
+        return;
+    }
+    // * Parse the cores of the frame-critical processes
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    int fifo = 0, own = -2, count = 0;
+    int cpus[REALTIME_PROCESSES];
+    char *save = NULL;
+    for (char *item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(item, '=');
+        if (!value) {
+            fifo |= strcmp(item, "fifo") == 0;
+            continue;
+        }
+        *value++ = '\0';
+        if (count < REALTIME_PROCESSES) {
+            cpus[count] = atoi(value);
+            if (strcmp(item, process) == 0) {
+                own = cpus[count];
+            }
+            count++;
+        }
+    }
+    if (own == -2) {
+        // * Not frame-critical: every allowed core but theirs, unless they are all reserved
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            for (int i = 0; i < count; i++) {
+                if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+                    CPU_CLR(cpus[i], &allowed);
+                }
+            }
+            if (CPU_COUNT(&allowed) > 0) {
+                sched_setaffinity(0, sizeof(allowed), &allowed);
+            }
+        }
+        return;
+    }
+    char report[LOG_TEXT_MAX];
+    int length = snprintf(report, sizeof(report), "Realtime: %s", process);
+    if (own >= 0) {
+        cpu_set_t core;
+        CPU_ZERO(&core);
+        CPU_SET(own, &core);
+        errno = EINVAL;
+        const int pinned = own < CPU_SETSIZE && sched_setaffinity(0, sizeof(core), &core) == 0;
+        length += snprintf(report + length, sizeof(report) - (size_t)length,
+            pinned ? ", on CPU %d" : ", not pinned to CPU %d (%s)", own, strerror(errno));
+    }
+    // * Timed waits end at their deadline instead of up to 50 us later
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    prefault_stack();
+    prefault_heap();
+    const int locked = lock_memory() == 0;
+    length += snprintf(report + length, sizeof(report) - (size_t)length,
+        locked ? ", memory locked" : ", memory pre-faulted, not locked (%s)", strerror(errno));
+    if (fifo) {
+        const struct sched_param param = {.sched_priority = REALTIME_PRIORITY};
+        const int scheduled = sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+        length += snprintf(report + length, sizeof(report) - (size_t)length,
+            scheduled ? ", SCHED_FIFO %d" : ", not SCHED_FIFO %d (%s)", REALTIME_PRIORITY, strerror(errno));
+    }
+    snprintf(report + length, sizeof(report) - (size_t)length, ".");
+    log_write(report);
+}
+
+__attribute__((noinline)) static void prefault_stack(void) {
+    // * Touch the stack the process will use, so that deep calls do not fault during a frame
+    volatile char stack[REALTIME_STACK_PREFAULT];
+    const long page = sysconf(_SC_PAGESIZE);
+    for (long i = 0; i < REALTIME_STACK_PREFAULT; i += page) {
+        stack[i] = 0;
+    }
+    // * Keep the writes: the array is never read, the compiler would drop it otherwise
+    __asm__ volatile("" : : "r"(stack) : "memory");
+}
+
+static void prefault_heap(void) {
+    /*
+     * Fault a heap reserve in and keep it: glibc no longer trims the heap nor serves the large blocks with their own
+     * mappings, so the buffers allocated and freed during the game reuse faulted pages.
+     */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    char *reserve = malloc(REALTIME_HEAP_PREFAULT);
+    if (reserve) {
+        const long page = sysconf(_SC_PAGESIZE);
+        for (long i = 0; i < REALTIME_HEAP_PREFAULT; i += page) {
+            ((volatile char *)reserve)[i] = 0;
+        }
+        free(reserve);
+    }
+}
+
+static int lock_memory(void) {
+    /*
+     * Lock the pages of the process, and the future ones when the limit allows it: under a finite RLIMIT_MEMLOCK a
+     * locked process would fail the allocations beyond it, so only the current pages are locked.
+     * @return 0 on success, -1 on failure (errno set).
+     */
+    struct rlimit limit;
+    int future = geteuid() == 0;
+    if (!future && getrlimit(RLIMIT_MEMLOCK, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        future = limit.rlim_max == RLIM_INFINITY && setrlimit(RLIMIT_MEMLOCK, &limit) == 0;
+    }
+    return mlockall(MCL_CURRENT | (future ? MCL_FUTURE : 0));
+}
@@ -0,0 +1,85 @@
+//
+// Created by Gian Marco Balia
+//
+// src/rng.c
+#include <time.h>
+#include <unistd.h>
+#include "rng.h"
+
+static uint64_t splitmix64(uint64_t *x);
+static uint64_t rotl(uint64_t x, int k);
+
+void rng_seed(rng_state *rng, uint64_t seed) {
+    /*
+     * Initialise the state from a 64-bit seed.
+     * @param rng Generator state.
+     * @param seed Any value, 0 included.
+     */
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+uint64_t rng_next(rng_state *rng) {
+    /*
+     * @return Next 64 random bits.
+     */
+    const uint64_t result = rotl(rng->s[1] * 5, 7) * 9;
+    const uint64_t t = rng->s[1] << 17;
+    rng->s[2] ^= rng->s[0];
+    rng->s[3] ^= rng->s[1];
+    rng->s[1] ^= rng->s[2];
+    rng->s[0] ^= rng->s[3];
+    rng->s[2] ^= t;
+    rng->s[3] = rotl(rng->s[3], 45);
+    return result;
+}
+
+uint64_t rng_range(rng_state *rng, const uint64_t n) {
+    /*
+     * @return Uniform value in [0, n) (multiply-shift reduction, bias is negligible for map sizes).
+     */
+    return (uint64_t)(((unsigned __int128)rng_next(rng) * n) >> 64);
+}
+
+double rng_uniform(rng_state *rng) {
+    /*
+     * @return Uniform value in [0, 1).
+     */
+    return (double)(rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+uint64_t rng_hash(const uint64_t seed, const int64_t a, const int64_t b) {
+    /*
+     * Derive the seed of a sub-stream (e.g. the tile (a, b) of a world) from the world seed.
+     * @return Well mixed 64-bit value, a pure function of its arguments.
+     */
+    uint64_t x = seed ^ 0x9E3779B97F4A7C15ull;
+    uint64_t h = splitmix64(&x);
+    x = h ^ (uint64_t)a;
+    h = splitmix64(&x);
+    x = h ^ (uint64_t)b;
+    return splitmix64(&x);
+}
+
+uint64_t rng_entropy(void) {
+    /*
+     * @return Seed taken from the clock and the PID, for runs where no seed is given.
+     */
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t x = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    x ^= (uint64_t)getpid() << 32;
+    return splitmix64(&x);
+}
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(const uint64_t x, const int k) {
+    return (x << k) | (x >> (64 - k));
+}
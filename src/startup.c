@@ -0,0 +1,31 @@
+//
+// Created by Gian Marco Balia
+//
+// src/startup.c
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "startup.h"
+#include "log_ring.h"
+#include "trace.h"
+
+// * Launch of the game and last phase of this process (thread in the threaded build), 0 before the first phase
+static _Thread_local uint64_t launch = 0, last = 0;
+
+void startup_phase(const char *process, const char *phase) {
+    /*
+     * Log a phase of the bring-up of this process.
+     * @param phase Short name, also the name of its span in the trace.
+     */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t time = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    if (launch == 0) {
+        const char *env = getenv(STARTUP_ENV);
+        launch = env ? strtoull(env, NULL, 10) : time;
+        last = launch;
+    }
+    log_printf("Startup: %s %s at +%.3f ms.", process, phase, (double)(time - launch) / 1e6);
+    trace_record(phase, 0, last, time, 0);
+    last = time;
+}
@@ -9,19 +9,36 @@
 #include <time.h>
 #include <signal.h>
 #include "macros.h"
+#include "occupancy.h"
+#include "channel.h"
+#include "components.h"
+#include "rng.h"
+#include "generator.h"
+#include "map_file.h"
+#include "free_cells.h"
+#include "reachability.h"
+#include "heartbeat.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "startup.h"
 
-FILE *logfile;
 static volatile sig_atomic_t keep_running = 1;
 
-void signal_close(int signum) {
+static int generate_map(occupancy_map *map, const generator_request *request, free_cells *pool, rng_state *rng,
+    uint64_t **reach);
+static int generate_tile(occupancy_map *map, const generator_request *request, int world_height, int world_width);
+static int place_targets(occupancy_map *map, free_cells *pool, rng_state *rng, int count, occupancy_target **placed);
+static int respawn_targets(channel *out, occupancy_map *map, free_cells *pool, rng_state *rng, int count);
+static int load_map(channel *in, const generator_request *request, occupancy_map *map, free_cells *pool,
+    rng_state *rng, uint64_t **reach, int map_height, int map_width);
+static int build_reachable_pool(const occupancy_map *map, free_cells *pool, uint64_t **reach);
+
+#ifndef DRONE_THREADS
+static void signal_close(int signum) {
     keep_running = 0;
 }
-void signal_triggered(int signum) {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    fprintf(logfile, "[%02d:%02d:%02d] PID: %d - %s\n", t->tm_hour, t->tm_min, t->tm_sec, getpid(),
-        "Targets is active.");
-    fflush(logfile);
+static void signal_triggered(int signum) {
+    log_write("Targets is active.");
 }
 
 int main (int argc, char *argv[]) {
@@ -29,6 +46,7 @@ int main (int argc, char *argv[]) {
      * Targets process
      * @param argv[1]: Read file descriptors
      * @param argv[2]: Write file descriptors
+     * @param argv[3], argv[4]: Map height and width (size of the whole world in chunked mode)
     */
     // * Signal handler closure
     struct sigaction sa0;
@@ -49,8 +67,8 @@ int main (int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <read_fd> <write_fd> <logfile_fd>\n", argv[0]);
+    if (argc != 6) {
+        fprintf(stderr, "Usage: %s <read_fd> <write_fd> <height> <width> <logfile_fd>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -66,41 +84,244 @@ int main (int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    // * Parse the map size
+    int map_height, map_width;
+    if (occupancy_parse_size(argv[3], argv[4], &map_height, &map_width) == -1) {
+        return EXIT_FAILURE;
+    }
+
     // * Parse logfile file descriptors
     int logfile_fd = atoi(argv[argc - 1]);
-    logfile = fdopen(logfile_fd, "a");
-    if (!logfile) {
-        perror("fdopen logfile");
+    channel *in = channel_from_fd(read_fd), *out = channel_from_fd(write_fd);
+    if (!in || !out) {
+        perror("channel");
         return EXIT_FAILURE;
     }
+    const int status = targets_run(in, out, map_height, map_width, logfile_fd);
+    channel_close(in);
+    channel_close(out);
+    return status;
+}
+#endif
 
-    char grid[GAME_HEIGHT][GAME_WIDTH];
-    memset(grid, ' ', GAME_HEIGHT*GAME_WIDTH);
+int targets_run(channel *in, channel *out, const int map_height, const int map_width, const int logfile_fd) {
+    /*
+     * Loop of the targets generator: serve the requests of the blackboard (generator.h).
+     * @param in, out Channels from and to the blackboard, closed by the caller.
+     * @param map_height, map_width Map size (size of the whole world in chunked mode).
+     * @return EXIT_SUCCESS when it is stopped or the blackboard is gone, EXIT_FAILURE on failure.
+     */
+    if (log_open("targets", logfile_fd) == -1) {
+        perror("log");
+    }
+    if (heartbeat_open() == -1) {
+        perror("heartbeat");
+    }
+    realtime_enter("targets");
+    startup_phase("targets", "ready");
 
-    if (read(read_fd, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char)) == -1) {
-        perror("read");
-        return EXIT_FAILURE;
+    // * Serve the requests of the blackboard until it closes the channel. The whole map, its free cells, the cells the
+    // * drone can reach and its random stream are kept for the respawns.
+    generator_request request;
+    occupancy_map map, tile;
+    memset(&map, 0, sizeof(map));
+    memset(&tile, 0, sizeof(tile));
+    free_cells pool;
+    memset(&pool, 0, sizeof(pool));
+    rng_state rng;
+    rng_seed(&rng, 0);
+    uint64_t *reach = NULL;
+    while (keep_running) {
+        heartbeat_wait();
+        if (channel_read(in, &request, sizeof(request)) == -1) {
+            break;
+        }
+        heartbeat_beat();
+        if (request.type == GEN_RESPAWN) {
+            if (respawn_targets(out, &map, &pool, &rng, request.count) == -1) {
+                perror("targets respawn");
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (request.type == GEN_LOAD) {
+            const int32_t status = load_map(in, &request, &map, &pool, &rng, &reach, map_height,
+                map_width);
+            if (channel_write(out, &status, sizeof(status)) == -1) {
+                perror("targets write");
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        occupancy_map *target = request.type == GEN_TILE ? &tile : &map;
+        if (occupancy_read(in, target) == -1) {
+            perror("read");
+            return EXIT_FAILURE;
+        }
+        int result;
+        if (request.type == GEN_TILE) {
+            result = generate_tile(&tile, &request, map_height, map_width);
+        } else {
+            if (map.height != map_height || map.width != map_width) {
+                fprintf(stderr, "Received a %dx%d map, expected %dx%d.\n", map.height, map.width, map_height,
+                    map_width);
+                return EXIT_FAILURE;
+            }
+            result = generate_map(&map, &request, &pool, &rng, &reach);
+        }
+        if (result == -1) {
+            fprintf(stderr, "Failed to add a target.\n");
+            return EXIT_FAILURE;
+        }
+        if (occupancy_write(out, target) == -1) {
+            perror("obstacle write");
+            return EXIT_FAILURE;
+        }
     }
+    free_cells_free(&pool);
+    free(reach);
+    occupancy_free(&map);
+    occupancy_free(&tile);
+    heartbeat_close();
+    log_close();
+    return EXIT_SUCCESS;
+}
 
-    // * Generate targets
-    srand(time(NULL));
-    char num_target = '9';
-    while (num_target > 0) {
-        int x = (rand() % (GAME_WIDTH - 2)) + 1;
-        int y = (rand() % (GAME_HEIGHT - 2)) + 1;
+static int generate_map(occupancy_map *map, const generator_request *request, free_cells *pool, rng_state *rng,
+    uint64_t **reach) {
+    /*
+     * Place the first wave of targets on a whole map, on the cells the drone can reach but its start.
+     * @param map Map holding the obstacles, the targets are added to it.
+     * @param request Request of the blackboard, carrying the seed and the round.
+     * @param pool Rebuilt with the free cells of the map, and kept for the respawns.
+     * @param rng Reseeded from the request, and kept for the respawns.
+     * @param reach Layer of the reachable cells, (re)allocated as needed and kept for the respawns.
+     * @return 0 on success, -1 on failure.
+     */
+    // * Do not reuse the stream of the obstacles generator
+    rng_seed(rng, rng_hash(GEN_ROUND_SEED(request->seed, request->count), -1, -1));
+    if (build_reachable_pool(map, pool, reach) == -1) {
+        return -1;
+    }
+    return place_targets(map, pool, rng, TARGETS_PER_WAVE, NULL);
+}
 
-        if (grid[y][x] == ' ' && !(x == GAME_WIDTH/2 && y == GAME_HEIGHT/2)) {
-            grid[y][x] = num_target;
-            num_target --;
-        }
+static int load_map(channel *in, const generator_request *request, occupancy_map *map, free_cells *pool,
+    rng_state *rng, uint64_t **reach, const int map_height, const int map_width) {
+    /*
+     * Read the path that follows a GEN_LOAD request and map the file in place of the current map. Its targets are
+     * kept, the pool and the random stream are prepared for the respawns as after generate_map.
+     * @return 0 on success, -1 if the file cannot be loaded or does not have the size of the game.
+     */
+    char path[GEN_PATH_MAX + 1];
+    if (request->count <= 0 || request->count > GEN_PATH_MAX || channel_read(in, path, request->count) == -1) {
+        return -1;
     }
+    path[request->count] = '\0';
+    if (map_file_load(path, map) == -1) {
+        perror(path);
+        return -1;
+    }
+    if (map->height != map_height || map->width != map_width) {
+        return -1;
+    }
+    rng_seed(rng, rng_hash(request->seed, -1, -1));
+    return build_reachable_pool(map, pool, reach);
+}
 
-    if (write(write_fd, grid, GAME_HEIGHT * GAME_WIDTH * sizeof(char)) == -1) {
-        perror("obstacle write");
-        return EXIT_FAILURE;
+static int build_reachable_pool(const occupancy_map *map, free_cells *pool, uint64_t **reach) {
+    /*
+     * Rebuild the pool with the free cells of a whole map that the drone can reach from its start (the start
+     * excluded), so that no target is placed in a closed pocket or between the walls and the border.
+     * @param reach Layer of the reachable cells, allocated on the first call (the size of the map never changes).
+     * @return 0 on success, -1 on failure.
+     */
+    if (!*reach && !(*reach = malloc(occupancy_words(map) * sizeof(uint64_t)))) {
+        return -1;
     }
-    // * Close the pipes
-    close(read_fd);
-    close(write_fd);
-    return EXIT_SUCCESS;
+    const int start_x = map->width / 2, start_y = map->height / 2;
+    if (reachability_fill(map, start_x, start_y, *reach, NULL) == -1) {
+        return -1;
+    }
+    free_cells_free(pool);
+    return free_cells_build(pool, map, 1, 1, map->height - 2, map->width - 2, start_y * map->width + start_x,
+        *reach);
+}
+
+static int generate_tile(occupancy_map *map, const generator_request *request, const int world_height,
+    const int world_width) {
+    /*
+     * Place CHUNK_TARGETS targets on one tile of a chunked world. As for the obstacles, the tile only depends on
+     * the seed and on its coordinates.
+     * @param map Tile holding the obstacles (origin included), the targets are added to it.
+     * @param request Request of the blackboard, carrying the seed and the tile coordinates.
+     * @return 0 on success, -1 on failure.
+     */
+    rng_state rng;
+    rng_seed(&rng, rng_hash(~GEN_ROUND_SEED(request->seed, request->count), request->tile_x, request->tile_y));
+    // * Sample the part of the tile inside the border of the world, without the drone start
+    const int x0 = map->origin_x > 0 ? 0 : 1, y0 = map->origin_y > 0 ? 0 : 1;
+    const int x1 = map->origin_x + map->width < world_width ? map->width : world_width - 1 - map->origin_x;
+    const int y1 = map->origin_y + map->height < world_height ? map->height : world_height - 1 - map->origin_y;
+    const int start_x = world_width / 2 - map->origin_x, start_y = world_height / 2 - map->origin_y;
+    const int32_t exclude = start_x >= 0 && start_x < map->width && start_y >= 0 && start_y < map->height ?
+        start_y * map->width + start_x : -1;
+    free_cells pool;
+    if (free_cells_build(&pool, map, x0, y0, y1 - y0, x1 - x0, exclude, NULL) == -1) {
+        return -1;
+    }
+    const int result = place_targets(map, &pool, &rng, CHUNK_TARGETS, NULL);
+    free_cells_free(&pool);
+    return result;
+}
+
+static int place_targets(occupancy_map *map, free_cells *pool, rng_state *rng, const int count,
+    occupancy_target **placed) {
+    /*
+     * Draw count free cells (fewer if the map is full) and put a target on each of them in a single batch.
+     * The labels count down to '1' (only digits can be labels in the target table).
+     * @param placed If not NULL, receives the batch (to free) and the function returns its size.
+     * @return 0 (or the number of targets placed) on success, -1 on failure.
+     */
+    occupancy_target *batch = malloc((count > 0 ? count : 1) * sizeof(occupancy_target));
+    if (!batch) {
+        return -1;
+    }
+    int n = 0;
+    for (; n < count; n++) {
+        const int32_t cell = free_cells_draw(pool, rng);
+        if (cell == -1) break;
+        batch[n].cell = cell;
+        batch[n].id = (char)('1' + (count - 1 - n) % 9);
+        // * Occupy the cell right away: the pool may sample by retries on the map
+        occupancy_set(map, map->targets, cell % map->width, cell / map->width);
+    }
+    if (occupancy_add_targets(map, batch, n) == -1) {
+        free(batch);
+        return -1;
+    }
+    if (placed) {
+        *placed = batch;
+        return n;
+    }
+    free(batch);
+    return 0;
+}
+
+static int respawn_targets(channel *out, occupancy_map *map, free_cells *pool, rng_state *rng, const int count) {
+    /*
+     * Answer a GEN_RESPAWN request: draw a batch of new targets on the free cells of the last map generated and
+     * send only the batch (int32 size, then the entries).
+     * @return 0 on success, -1 on failure.
+     */
+    occupancy_target *batch = NULL;
+    const int n = map->obstacles ? place_targets(map, pool, rng, count, &batch) : 0;
+    if (n == -1) {
+        return -1;
+    }
+    const int32_t size = n;
+    const int result = channel_write(out, &size, sizeof(size)) == -1 ||
+        channel_write(out, batch, n * sizeof(occupancy_target)) == -1 ? -1 : 0;
+    free(batch);
+    return result;
 }
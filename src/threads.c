@@ -0,0 +1,197 @@
+//
+// Created by Gian Marco Balia
+//
+// src/threads.c
+#define _GNU_SOURCE // * gettid
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "macros.h"
+#include "threads.h"
+#include "channel.h"
+#include "components.h"
+#include "log_ring.h"
+#include "startup.h"
+
+// * Components in the order of the watchdog: the children of main in their slots, the blackboard last
+enum { THREAD_INPUT, THREAD_OBSTACLES, THREAD_TARGETS, THREAD_DYNAMICS, THREAD_BLACKBOARD, NUM_THREADS };
+
+typedef struct {
+    int component;
+    pthread_t thread;
+    pid_t tid; // * Published by the thread before it runs its entry
+    sem_t started;
+    int status; // * Return value of the entry
+} component_thread;
+
+// * Setup of the game, and the channels of the pipes of ./DroneGame: to_blackboard[i] is written by the child of
+// * slot i and read by the blackboard, from_blackboard[i] the other way (from_blackboard[0] only for the autopilot)
+static struct {
+    int map_height, map_width, obstacle_spacing, chunked, autopilot, logfile_fd;
+    double obstacle_density;
+    uint64_t seed;
+    const char *map_path;
+    channel *to_blackboard[NUM_CHILD_PIPES][2];
+    channel *from_blackboard[NUM_CHILD_PIPES][2];
+} game;
+
+// * Message of the component of this thread to the heartbeat of the watchdog, NULL for main and the watchdog
+static _Thread_local const char *active = NULL;
+
+static void *component_main(void *arg);
+static void *watchdog_main(void *arg);
+static int run_component(int component);
+static void signal_triggered(int signum);
+
+int threads_run(const int map_height, const int map_width, const double obstacle_density, const int obstacle_spacing,
+    const uint64_t seed, const int chunked, const char *map_path, const int autopilot, const int logfile_fd) {
+    /*
+     * Play the game with every component in a thread of this process, until the blackboard ends it.
+     * @param autopilot 1 for the autopilot in place of the keyboard manager.
+     * @return Exit status of the blackboard, EXIT_FAILURE if the components cannot be started.
+     */
+    game.map_height = map_height;
+    game.map_width = map_width;
+    game.obstacle_density = obstacle_density;
+    game.obstacle_spacing = obstacle_spacing;
+    game.seed = seed;
+    game.chunked = chunked;
+    game.map_path = map_path;
+    game.autopilot = autopilot;
+    game.logfile_fd = logfile_fd;
+    // * Heartbeat of the watchdog: every thread answers with the message of its component
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_triggered;
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &sa, NULL) == -1) {
+        perror("sigaction");
+        return EXIT_FAILURE;
+    }
+    signal(SIGUSR2, SIG_IGN);
+    for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+        if (channel_queue(game.to_blackboard[i]) == -1 ||
+            ((i > 0 || autopilot) && channel_queue(game.from_blackboard[i]) == -1)) {
+            perror("channel");
+            return EXIT_FAILURE;
+        }
+    }
+    // * Started in the order of the processes of ./DroneGame: the obstacles and the blackboard first, they build
+    // * the first map while the others start
+    static const int order[NUM_THREADS] = {THREAD_OBSTACLES, THREAD_BLACKBOARD, THREAD_TARGETS, THREAD_DYNAMICS,
+        THREAD_INPUT};
+    component_thread threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        component_thread *self = &threads[order[i]];
+        self->component = order[i];
+        sem_init(&self->started, 0, 0);
+        const int error = pthread_create(&self->thread, NULL, component_main, self);
+        if (error != 0) {
+            // * The threads already started cannot be stopped cleanly: end the game
+            errno = error;
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // * The watchdog starts once it knows every TID
+    pid_t tids[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        while (sem_wait(&threads[order[i]].started) == -1 && errno == EINTR) {
+        }
+        sem_destroy(&threads[order[i]].started);
+        tids[order[i]] = threads[order[i]].tid;
+    }
+    pthread_t watchdog;
+    const int watching = pthread_create(&watchdog, NULL, watchdog_main, tids) == 0;
+    if (!watching) {
+        perror("watchdog thread");
+    }
+    startup_phase("main", "spawned");
+    // * The blackboard ends the game and closes its channels, then every other component sees the end of its own
+    pthread_join(threads[THREAD_BLACKBOARD].thread, NULL);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        if (i != THREAD_BLACKBOARD) {
+            pthread_join(threads[i].thread, NULL);
+        }
+    }
+    if (watching) {
+        watchdog_stop();
+        pthread_join(watchdog, NULL);
+    }
+    return threads[THREAD_BLACKBOARD].status;
+}
+
+static void *component_main(void *arg) {
+    // * Body of a component thread: publish its TID, run its entry, then close its channels
+    component_thread *self = arg;
+    static const char *const messages[NUM_THREADS] = {
+        [THREAD_OBSTACLES] = "Obstacles is active.", [THREAD_TARGETS] = "Targets is active.",
+        [THREAD_DYNAMICS] = "Dynamics is active.", [THREAD_BLACKBOARD] = "Blackboard is active.",
+    };
+    active = self->component == THREAD_INPUT ?
+        (game.autopilot ? "Autopilot is active." : "Keyboard manager is active.") : messages[self->component];
+    self->tid = gettid();
+    sem_post(&self->started);
+    self->status = run_component(self->component);
+    return NULL;
+}
+
+static int run_component(const int component) {
+    /*
+     * Run the entry of a component on its channels, and close them once it returns.
+     * @return Exit status of the entry.
+     */
+    int status;
+    if (component == THREAD_BLACKBOARD) {
+        channel *in[NUM_CHILD_PIPES], *out[NUM_CHILD_PIPES - 1];
+        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+            in[i] = game.to_blackboard[i][0];
+        }
+        for (int i = 0; i < NUM_CHILD_PIPES - 1; i++) {
+            out[i] = game.from_blackboard[i + 1][1];
+        }
+        status = blackboard_run(in, out, game.from_blackboard[0][1], game.map_height, game.map_width, game.seed,
+            game.chunked, game.map_path, game.logfile_fd);
+        for (int i = 0; i < NUM_CHILD_PIPES; i++) {
+            channel_close(game.to_blackboard[i][0]);
+            channel_close(game.from_blackboard[i][1]);
+        }
+        return status;
+    }
+    channel *in = game.from_blackboard[component][0], *out = game.to_blackboard[component][1];
+    switch (component) {
+        case THREAD_INPUT:
+            status = game.autopilot ? autopilot_run(in, out, game.logfile_fd) : keyboard_run(out, game.logfile_fd);
+            break;
+        case THREAD_OBSTACLES:
+            status = obstacles_run(in, out, game.map_height, game.map_width, game.obstacle_density,
+                game.obstacle_spacing, game.logfile_fd);
+            break;
+        case THREAD_TARGETS:
+            status = targets_run(in, out, game.map_height, game.map_width, game.logfile_fd);
+            break;
+        default:
+            status = dynamics_run(in, out, game.map_height, game.map_width, game.logfile_fd);
+            break;
+    }
+    channel_close(in);
+    channel_close(out);
+    return status;
+}
+
+static void *watchdog_main(void *arg) {
+    watchdog_run(arg, 1, game.logfile_fd);
+    return NULL;
+}
+
+static void signal_triggered(int signum) {
+    // * The watchdog signals each thread with tgkill: the handler runs in the thread it checks
+    if (active) {
+        log_write(active);
+    }
+}
@@ -0,0 +1,197 @@
+//
+// Created by Gian Marco Balia
+//
+// src/timer_wheel.c
+#include <stdlib.h>
+#include <string.h>
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_SLOTS - 1)
+#define HORIZON ((uint64_t)1 << (TIMER_SLOT_BITS * TIMER_LEVELS))
+
+static void link_timer(timer_wheel *wheel, int id, uint64_t base);
+static void unlink_timer(timer_wheel *wheel, int id);
+static void cascade(timer_wheel *wheel, uint64_t tick);
+
+int timer_wheel_init(timer_wheel *wheel, const uint64_t now) {
+    /*
+     * Initialise an empty wheel.
+     * @param now Current tick: the first timers can fire at now + 1.
+     * @return 0 on success, -1 on failure.
+     */
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->current = now;
+    wheel->free_list = -1;
+    for (int i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++) {
+        wheel->heads[i] = -1;
+    }
+    return 0;
+}
+
+void timer_wheel_free(timer_wheel *wheel) {
+    free(wheel->timers);
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->free_list = -1;
+}
+
+int timer_wheel_schedule(timer_wheel *wheel, const uint64_t expires, const timer_event event) {
+    /*
+     * Schedule an event. A tick already processed fires at the next advance.
+     * @param expires Tick at which the event fires.
+     * @return Id of the timer (valid until it fires or is cancelled), -1 on failure.
+     */
+    if (wheel->free_list == -1) {
+        const int capacity = wheel->capacity ? 2 * wheel->capacity : 64;
+        timer_entry *timers = realloc(wheel->timers, capacity * sizeof(timer_entry));
+        if (!timers) {
+            return -1;
+        }
+        for (int i = capacity - 1; i >= wheel->capacity; i--) {
+            timers[i].slot = -1;
+            timers[i].next = wheel->free_list;
+            wheel->free_list = i;
+        }
+        wheel->timers = timers;
+        wheel->capacity = capacity;
+    }
+    const int id = wheel->free_list;
+    timer_entry *timer = &wheel->timers[id];
+    wheel->free_list = timer->next;
+    timer->expires = expires > wheel->current ? expires : wheel->current + 1;
+    timer->event = event;
+    link_timer(wheel, id, wheel->current);
+    wheel->active++;
+    return id;
+}
+
+void timer_wheel_cancel(timer_wheel *wheel, const int id) {
+    /*
+     * Cancel a scheduled timer in O(1). Ids of timers already fired or cancelled are ignored.
+     */
+    if (id < 0 || id >= wheel->capacity || wheel->timers[id].slot == -1) {
+        return;
+    }
+    unlink_timer(wheel, id);
+    wheel->timers[id].next = wheel->free_list;
+    wheel->free_list = id;
+    wheel->active--;
+}
+
+int timer_wheel_advance(timer_wheel *wheel, const uint64_t now, timer_event *fired, const int max_fired) {
+    /*
+     * Process the ticks up to now and collect the events due.
+     * If more than max_fired events are due, the wheel stops at the tick in progress and the next call goes on.
+     * @param now Current tick.
+     * @param fired Array receiving the events due, in order of tick.
+     * @param max_fired Size of the array.
+     * @return Number of events collected.
+     */
+    int n = 0;
+    while (wheel->current < now) {
+        if (wheel->active == 0) {
+            wheel->current = now;
+            break;
+        }
+        const uint64_t tick = wheel->current + 1;
+        if ((tick & SLOT_MASK) == 0) {
+            cascade(wheel, tick);
+        }
+        int *head = &wheel->heads[tick & SLOT_MASK];
+        while (*head != -1) {
+            if (n == max_fired) {
+                return n;
+            }
+            const int id = *head;
+            fired[n++] = wheel->timers[id].event;
+            timer_wheel_cancel(wheel, id);
+        }
+        wheel->current = tick;
+    }
+    return n;
+}
+
+uint64_t timer_wheel_next(const timer_wheel *wheel) {
+    /*
+     * @return Lower bound of the tick of the next timer, UINT64_MAX if no timer is scheduled. Useful to sleep until
+     * then: exact if the next timer is in the lowest wheel, otherwise the start of its slot, the tick at which it is
+     * cascaded down.
+     */
+    if (wheel->active == 0) {
+        return UINT64_MAX;
+    }
+    // * The first slot of a wheel is not always the earliest: a timer linked into an upper wheel long ago can be due
+    // * before the timers of the lower ones. Take the minimum over the wheels.
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        const int shift = TIMER_SLOT_BITS * level;
+        const uint64_t position = wheel->current >> shift;
+        // * No slot of this wheel or of the upper ones starts before the next slot of this one
+        if (((position + 1) << shift) >= next) {
+            break;
+        }
+        for (int j = 1; j <= TIMER_SLOTS; j++) {
+            if (wheel->heads[level * TIMER_SLOTS + ((position + j) & SLOT_MASK)] != -1) {
+                // * The slot of level 0 is the tick itself, upper slots start at a multiple of their span
+                const uint64_t start = (position + j) << shift;
+                if (start < next) {
+                    next = start;
+                }
+                break;
+            }
+        }
+    }
+    return next != UINT64_MAX && next > wheel->current ? next : wheel->current + 1;
+}
+
+static void link_timer(timer_wheel *wheel, const int id, const uint64_t base) {
+    // * Put the timer in the lowest wheel whose span contains its delay from base
+    timer_entry *timer = &wheel->timers[id];
+    if (timer->expires - base >= HORIZON) {
+        timer->expires = base + HORIZON - 1;
+    }
+    const uint64_t delta = timer->expires - base;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (uint64_t)1 << (TIMER_SLOT_BITS * (level + 1))) {
+        level++;
+    }
+    const int slot = level * TIMER_SLOTS + (int)((timer->expires >> (TIMER_SLOT_BITS * level)) & SLOT_MASK);
+    timer->slot = slot;
+    timer->prev = -1;
+    timer->next = wheel->heads[slot];
+    if (timer->next != -1) {
+        wheel->timers[timer->next].prev = id;
+    }
+    wheel->heads[slot] = id;
+}
+
+static void unlink_timer(timer_wheel *wheel, const int id) {
+    timer_entry *timer = &wheel->timers[id];
+    if (timer->prev != -1) {
+        wheel->timers[timer->prev].next = timer->next;
+    } else {
+        wheel->heads[timer->slot] = timer->next;
+    }
+    if (timer->next != -1) {
+        wheel->timers[timer->next].prev = timer->prev;
+    }
+    timer->slot = -1;
+}
+
+static void cascade(timer_wheel *wheel, const uint64_t tick) {
+    // * The lowest wheel wrapped at tick: move the timers of the current slot of each upper wheel down,
+    // * starting from the highest wheel that wrapped too
+    int top = 1;
+    while (top < TIMER_LEVELS - 1 && ((tick >> (TIMER_SLOT_BITS * top)) & SLOT_MASK) == 0) {
+        top++;
+    }
+    for (int level = top; level >= 1; level--) {
+        const int slot = level * TIMER_SLOTS + (int)((tick >> (TIMER_SLOT_BITS * level)) & SLOT_MASK);
+        int id = wheel->heads[slot];
+        wheel->heads[slot] = -1;
+        while (id != -1) {
+            const int next = wheel->timers[id].next;
+            link_timer(wheel, id, tick);
+            id = next;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+//
+// Created by Gian Marco Balia
+//
+// src/trace.c
+#define _GNU_SOURCE // * gettid
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+// * Ring of this process (of this thread in the threaded build, threads.h), NULL when tracing is off
+static _Thread_local trace_ring *ring = NULL;
+
+static void write_ring(FILE *out, const trace_ring *source, int *first);
+
+int trace_open(const char *process) {
+    /*
+     * Create the ring of this process if the game is traced (TRACE_ENV set), nothing otherwise.
+     * @param process Name of the process in the trace.
+     * @return 0 on success or when tracing is off, -1 on failure.
+     */
+    const char *dir = getenv(TRACE_ENV);
+    if (!dir || dir[0] == '\0') {
+        return 0;
+    }
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.%d.ring", dir, process, gettid());
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    const size_t size = sizeof(trace_ring) + (size_t)TRACE_CAPACITY * sizeof(trace_span);
+    if (ftruncate(fd, (off_t)size) == -1) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    ring = map;
+    ring->magic = TRACE_MAGIC;
+    ring->capacity = TRACE_CAPACITY;
+    ring->pid = gettid();
+    strncpy(ring->process, process, sizeof(ring->process) - 1);
+    atomic_init(&ring->head, 0);
+    return 0;
+}
+
+void trace_close(void) {
+    if (ring) {
+        munmap(ring, sizeof(trace_ring) + (size_t)ring->capacity * sizeof(trace_span));
+        ring = NULL;
+    }
+}
+
+void trace_record(const char *name, const uint32_t id, const uint64_t start, const uint64_t end, const char flow) {
+    /*
+     * Append a span to the ring of this process (no-op when tracing is off).
+     * @param id Sequence number of the key the span belongs to, 0 for none.
+     * @param start, end Monotonic clock in ns (latency_now).
+     * @param flow Hop of the key ('s', 't', 'f'), 0 if the span is not a hop.
+     */
+    if (!ring) {
+        return;
+    }
+    // * Single writer: fill the slot, then publish it
+    const uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_span *span = &ring->spans[head % ring->capacity];
+    span->start = start;
+    span->duration = end > start ? end - start : 0;
+    span->id = id;
+    span->flow = flow;
+    strncpy(span->name, name, TRACE_NAME_MAX - 1);
+    span->name[TRACE_NAME_MAX - 1] = '\0';
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+int trace_merge(const char *dir, const char *output) {
+    /*
+     * Merge the rings of every process into a Chrome/Perfetto JSON trace, then remove the rings and their directory.
+     * @return 0 on success, -1 on failure.
+     */
+    DIR *rings = opendir(dir);
+    if (!rings) {
+        return -1;
+    }
+    FILE *out = fopen(output, "w");
+    if (!out) {
+        closedir(rings);
+        return -1;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    int first = 1;
+    const struct dirent *entry;
+    while ((entry = readdir(rings)) != NULL) {
+        const size_t length = strlen(entry->d_name);
+        if (length < 5 || strcmp(entry->d_name + length - 5, ".ring") != 0) {
+            continue;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        const int fd = open(path, O_RDONLY);
+        struct stat info;
+        if (fd != -1 && fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(trace_ring)) {
+            void *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                const trace_ring *source = map;
+                if (source->magic == TRACE_MAGIC && (size_t)info.st_size >= sizeof(trace_ring) +
+                    (size_t)source->capacity * sizeof(trace_span)) {
+                    write_ring(out, source, &first);
+                }
+                munmap(map, (size_t)info.st_size);
+            }
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+        unlink(path);
+    }
+    fprintf(out, "\n]}\n");
+    closedir(rings);
+    rmdir(dir);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static void write_ring(FILE *out, const trace_ring *source, int *first) {
+    // * The process name, then the spans still in the ring from the oldest: a complete event each, and the flow
+    // * event of the key when the span is a hop (bound to the span that encloses it)
+    char process[sizeof(source->process) + 1];
+    memcpy(process, source->process, sizeof(source->process));
+    process[sizeof(source->process)] = '\0';
+    fprintf(out, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+        *first ? "" : ",", source->pid, source->pid, process);
+    *first = 0;
+    const uint64_t head = atomic_load_explicit((_Atomic uint64_t *)&source->head, memory_order_acquire);
+    for (uint64_t i = head > source->capacity ? head - source->capacity : 0; i < head; i++) {
+        const trace_span *span = &source->spans[i % source->capacity];
+        char name[TRACE_NAME_MAX + 1];
+        memcpy(name, span->name, TRACE_NAME_MAX);
+        name[TRACE_NAME_MAX] = '\0';
+        fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"key\":%u}}", name, (double)span->start / 1e3, (double)span->duration / 1e3,
+            source->pid, source->pid, span->id);
+        if (span->flow == 's' || span->flow == 't' || span->flow == 'f') {
+            fprintf(out, ",\n{\"name\":\"key\",\"cat\":\"input\",\"ph\":\"%c\",\"id\":%u,\"ts\":%.3f,\"pid\":%d,"
+                "\"tid\":%d%s}", span->flow, span->id, (double)span->start / 1e3, source->pid, source->pid,
+                span->flow == 's' ? "" : ",\"bp\":\"e\"");
+        }
+    }
+}
@@ -9,8 +9,80 @@
 #include <time.h>
 #include <sys/stat.h>
 #include <errno.h>
-#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
 #include "macros.h"
+#include "metrics.h"
+#include "proc_stats.h"
+#include "heartbeat.h"
+#include "supervisor.h"
+#include "log_ring.h"
+#include "realtime.h"
+#include "components.h"
+
+#define HEARTBEAT_PERIOD_MS 3000
+#define SCRAPE_TIMEOUT_MS 200 // * Longest wait for the request of a scraper, and for it to take the answer
+// * Alert thresholds on the usage of a component over a period: the processes of the game sleep on their pipes
+// * between frames, a busy loop shows up as a whole CPU
+#define CPU_ALERT_PERCENT 80.0 // * Of one CPU
+#define RSS_ALERT_BYTES (512ull << 20)
+#define RUNQUEUE_ALERT_RATIO 0.05 // * Share of the period spent runnable but waiting for a CPU
+
+enum { ALERT_CPU = 1, ALERT_RSS = 2, ALERT_RUNQUEUE = 4 };
+#define SCRAPE_EVENT UINT32_MAX // * epoll data of the metrics socket, the pidfds carry the index of their component
+#define SUPERVISOR_EVENT (UINT32_MAX - 1) // * epoll data of the link with the supervisor
+#ifndef PIDFD_THREAD
+#define PIDFD_THREAD O_EXCL // * pidfd of a thread (Linux 6.9), missing from older headers
+#endif
+
+// * Liveness of a component: its pidfd and the beats of its main loop
+typedef struct {
+    const char *name;
+    int pidfd; // * -1 once the component has exited, or if pidfd_open is not available
+    int alive;
+    heartbeat_page *page; // * NULL until the component has created it
+    uint64_t beats;
+    long changed_ms; // * Last time the beats moved (or the component was waiting)
+    int stalled;
+    int killed; // * Killed for the supervisor to restart it
+    int beats_slot, stalls_slot, stalled_slot, restarts_slot;
+} component_liveness;
+
+// * Resource accounting of a component: its last sample, its metrics slots and the alerts raised
+typedef struct {
+    const char *name;
+    proc_sample last;
+    long last_ms; // * Time of the last sample, 0 before the first one
+    uint64_t max_rss;
+    int cpu_slot, cpu_percent_slot, rss_slot, voluntary_slot, involuntary_slot, runqueue_slot, alerts_slot;
+    int alerting; // * Alerts above their threshold at the last sample (ALERT_*)
+} component_usage;
+
+static volatile sig_atomic_t keep_running = 1;
+// * The components are threads of this process (threaded build, threads.h): signalled with tgkill, watched with
+// * thread pidfds and sampled from /proc/self/task
+static int threaded = 0;
+
+static void register_usage(metrics_page *page, component_usage *usage);
+static void account_usage(metrics_page *page, pid_t pid, component_usage *usage);
+static void report_usage(const component_usage *usage);
+static void check_heartbeat(metrics_page *page, pid_t pid, component_liveness *live, long now);
+static void follow_restart(int epoll_fd, int component, pid_t pid, pid_t *pids, component_liveness *live,
+    component_usage *usage, metrics_page **page);
+static int open_metrics_socket(void);
+static void serve_metrics(int server, metrics_page *const *pages, int count);
+static int send_all(int fd, const char *buf, size_t size);
+static long monotonic_ms(void);
+static int signal_component(pid_t pid, int signum);
+static int open_pidfd(pid_t pid);
+
+#ifndef DRONE_THREADS
+static void signal_close(int signum);
 
 int main(int argc, char *argv[]) {
     // * Check if the number of argument correspond
@@ -35,13 +107,122 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Invalid blackboard PID: %s\n", argv[num_child_pids + 1]);
         exit(EXIT_FAILURE);
     }
-    // * Parse del file descriptor del logfile e apertura del file stream
-    int logfile_fd = atoi(argv[num_child_pids + 2]);
-    FILE *logfile = fdopen(logfile_fd, "r");
-    if (!logfile) {
-        perror("fdopen logfile");
+    // * Closure by main: without SA_RESTART, so that the wait of the period ends at once
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_close;
+    if (sigaction(SIGTERM, &sa, NULL) == -1) {
+        perror("sigaction");
         exit(EXIT_FAILURE);
     }
+    pid_t pids[NUM_CHILD_PROCESSES - 1];
+    for (int i = 0; i < num_child_pids; i++) {
+        pids[i] = child_pids[i];
+    }
+    pids[num_child_pids] = blackboard_pid;
+    return watchdog_run(pids, 0, atoi(argv[num_child_pids + 2]));
+}
+
+static void signal_close(int signum) {
+    keep_running = 0;
+}
+#endif
+
+void watchdog_stop(void) {
+    // * End the loop of the watchdog within HEARTBEAT_CHECK_MS (threaded build, where it gets no SIGTERM)
+    keep_running = 0;
+}
+
+int watchdog_run(const pid_t ids[NUM_CHILD_PROCESSES - 1], const int threads, const int logfile_fd) {
+    /*
+     * Loop of the watchdog: liveness, resource usage and metrics endpoint of the components, and collector of the
+     * rings of the game, until it is stopped.
+     * @param ids PIDs of the components in the order of main (input, obstacles, targets, dynamics), the blackboard
+     * last.
+     * @param threads 1 if they are TIDs of threads of this process (threaded build).
+     * @return EXIT_SUCCESS once stopped, EXIT_FAILURE on failure.
+     */
+    threaded = threads;
+    const int num_child_pids = NUM_CHILD_PROCESSES - 2;
+    pid_t child_pids[num_child_pids];
+    pid_t pids[NUM_CHILD_PROCESSES - 1];
+    for (int i = 0; i < num_child_pids + 1; i++) {
+        pids[i] = ids[i];
+        if (i < num_child_pids) {
+            child_pids[i] = ids[i];
+        }
+    }
+    pid_t blackboard_pid = ids[num_child_pids];
+    // * The watchdog is also the collector of the rings of the game
+    if (log_open("watchdog", logfile_fd) == -1) {
+        perror("log");
+    }
+    const char *log_dir = getenv(LOG_ENV);
+    realtime_enter("watchdog");
+    // * Metrics endpoint: the pages of the components (in the order of their PIDs, the blackboard last) and the
+    // * page of the watchdog with their heartbeats; the game runs without it if the socket cannot be opened
+    const char *components[NUM_CHILD_PROCESSES - 1] = {"input", "obstacles", "targets", "dynamics", "blackboard"};
+    metrics_page *pages[NUM_CHILD_PROCESSES] = {NULL};
+    metrics_page *own = metrics_open("watchdog");
+    pages[0] = own;
+    int up_slots[NUM_CHILD_PROCESSES - 1], heartbeat_slots[NUM_CHILD_PROCESSES - 1];
+    for (int i = 0; i < num_child_pids + 1; i++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "component=\"%s\"", components[i]);
+        up_slots[i] = metrics_register(own, "dronegame_component_up", labels,
+            "Whether the component answered the last heartbeat.", METRICS_GAUGE, 1);
+        heartbeat_slots[i] = metrics_register(own, "dronegame_heartbeats_total", labels,
+            "Heartbeat signals delivered to the component.", METRICS_COUNTER, 1);
+    }
+    // * Liveness of every component: the beats of its main loop, checked every HEARTBEAT_CHECK_MS, and its pidfd,
+    // * readable as soon as it exits
+    const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        perror("epoll_create1");
+        return EXIT_FAILURE;
+    }
+    component_liveness live[NUM_CHILD_PROCESSES - 1];
+    memset(live, 0, sizeof(live));
+    for (int i = 0; i < num_child_pids + 1; i++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "component=\"%s\"", components[i]);
+        live[i].name = components[i];
+        live[i].alive = 1;
+        live[i].changed_ms = monotonic_ms();
+        live[i].beats_slot = metrics_register(own, "dronegame_component_beats_total", labels,
+            "Iterations of the main loop of the component.", METRICS_COUNTER, 1);
+        live[i].stalls_slot = metrics_register(own, "dronegame_component_stalls_total", labels,
+            "Times the component was busy without a beat for longer than the stall timeout.", METRICS_COUNTER, 1);
+        live[i].stalled_slot = metrics_register(own, "dronegame_component_stalled", labels,
+            "Whether the component is stalled.", METRICS_GAUGE, 1);
+        live[i].restarts_slot = metrics_register(own, "dronegame_component_restarts_total", labels,
+            "Times the supervisor restarted the component.", METRICS_COUNTER, 1);
+        live[i].pidfd = open_pidfd(pids[i]);
+        struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)i}};
+        if (live[i].pidfd == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, live[i].pidfd, &event) == -1) {
+            // * Without a pidfd the exit is noticed by the heartbeat signals only
+            perror("pidfd");
+        }
+    }
+    // * CPU, memory and scheduling of every component, sampled from procfs after each heartbeat
+    component_usage usage[NUM_CHILD_PROCESSES - 1];
+    memset(usage, 0, sizeof(usage));
+    for (int i = 0; i < num_child_pids + 1; i++) {
+        usage[i].name = components[i];
+        register_usage(own, &usage[i]);
+    }
+    const int server = open_metrics_socket();
+    struct epoll_event scrape = {EPOLLIN, {.u32 = SCRAPE_EVENT}};
+    if (server == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server, &scrape) == -1) {
+        perror("metrics socket");
+    }
+    // * Supervisor mode (supervisor.h): main sends the new PID of every component it restarts
+    const char *supervisor_link = getenv(SUPERVISOR_ENV);
+    const int supervisor_fd = supervisor_link ? atoi(supervisor_link) : -1;
+    struct epoll_event supervisor = {EPOLLIN, {.u32 = SUPERVISOR_EVENT}};
+    if (supervisor_fd != -1 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, supervisor_fd, &supervisor) == -1) {
+        perror("supervisor link");
+    }
     // * Initialise the timestamp for each process
     time_t last_active_time_p[num_child_pids];
     for (int i = 0; i < num_child_pids; i++) {
@@ -49,38 +230,400 @@ int main(int argc, char *argv[]) {
     }
     time_t last_active_time_balckboard = time(NULL);
     int dt = 10;
-    while (1) {
-        // * Sleep before to repeat the cycle
-        sleep(3);
-        // * Send the signals
+    long period_end = monotonic_ms() + HEARTBEAT_PERIOD_MS;
+    long drain_time = monotonic_ms();
+    while (keep_running) {
+        // * Wait for the next heartbeat check, answering the scrapes and noting the exits meanwhile
+        struct epoll_event events[NUM_CHILD_PROCESSES + 1];
+        const int n = epoll_wait(epoll_fd, events, NUM_CHILD_PROCESSES + 1, HEARTBEAT_CHECK_MS);
+        int restarted = 0;
+        for (int e = 0; e < n; e++) {
+            if (events[e].data.u32 == SUPERVISOR_EVENT) {
+                // * Read after the exits of the batch, which belong to the processes being replaced
+                restarted = 1;
+                continue;
+            }
+            if (events[e].data.u32 == SCRAPE_EVENT) {
+                // * The pages are mapped once their process has created them
+                for (int i = 0; i < num_child_pids + 1; i++) {
+                    if (!pages[i + 1]) {
+                        pages[i + 1] = metrics_attach(pids[i]);
+                    }
+                }
+                serve_metrics(server, pages, NUM_CHILD_PROCESSES);
+                continue;
+            }
+            component_liveness *exited = &live[events[e].data.u32];
+            char message[128];
+            snprintf(message, sizeof(message), "Watchdog: %s (PID %d) exited.", exited->name,
+                pids[events[e].data.u32]);
+            log_write(message);
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, exited->pidfd, NULL);
+            close(exited->pidfd);
+            exited->pidfd = -1;
+            exited->alive = 0;
+            metrics_set(own, up_slots[events[e].data.u32], 0);
+            metrics_set(own, exited->stalled_slot, 0);
+        }
+        supervisor_restart restart;
+        ssize_t received = 0;
+        while (restarted && (received = recv(supervisor_fd, &restart, sizeof(restart), MSG_DONTWAIT)) ==
+            sizeof(restart)) {
+            if (restart.component < 0 || restart.component > num_child_pids) {
+                continue;
+            }
+            const int c = restart.component;
+            follow_restart(epoll_fd, c, restart.pid, pids, &live[c], &usage[c], &pages[c + 1]);
+            if (c < num_child_pids) {
+                child_pids[c] = restart.pid;
+            } else {
+                blackboard_pid = restart.pid;
+            }
+            metrics_add(own, live[c].restarts_slot, 1);
+        }
+        if (restarted && received == 0) {
+            // * main closed the link: the game is ending
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, supervisor_fd, NULL);
+        }
+        const long check_time = monotonic_ms();
+        for (int i = 0; i < num_child_pids + 1; i++) {
+            check_heartbeat(own, pids[i], &live[i], check_time);
+            // * Supervisor: a hung dynamics or blackboard is killed, main restarts it
+            if (supervisor_fd != -1 && (i == 3 || i == num_child_pids) && live[i].alive && live[i].stalled &&
+                !live[i].killed && check_time - live[i].changed_ms >= SUPERVISOR_HANG_MS) {
+                char message[128];
+                snprintf(message, sizeof(message), "Watchdog: %s (PID %d) hung for %ld ms, killed for the supervisor.",
+                    live[i].name, pids[i], check_time - live[i].changed_ms);
+                log_write(message);
+                signal_component(pids[i], SIGKILL);
+                live[i].killed = 1;
+            }
+        }
+        // * Drain the rings of the components into the logfile, off their frame
+        if (log_dir && check_time - drain_time >= LOG_DRAIN_MS) {
+            log_collect(log_dir, logfile_fd);
+            drain_time = check_time;
+        }
+        if (!keep_running || check_time < period_end) {
+            continue;
+        }
+        period_end += HEARTBEAT_PERIOD_MS;
+        // * Send the signals (an exited component is a zombie until main reaps it: the signal would be delivered)
         for (int i = 0; i < num_child_pids; i++) {
-            if (kill(child_pids[i], SIGUSR1) == 0) {
+            const int up = live[i].alive && signal_component(child_pids[i], SIGUSR1) == 0;
+            if (up) {
                 last_active_time_p[i] = time(NULL);
             }
+            metrics_set(own, up_slots[i], up);
+            metrics_add(own, heartbeat_slots[i], up);
         }
-        if (kill(blackboard_pid, SIGUSR1) == 0) {
+        const int up = live[num_child_pids].alive && signal_component(blackboard_pid, SIGUSR1) == 0;
+        if (up) {
             last_active_time_balckboard = time(NULL);
         }
-        // * Verify the processes' time inactivity
+        metrics_set(own, up_slots[num_child_pids], up);
+        metrics_add(own, heartbeat_slots[num_child_pids], up);
+        for (int i = 0; i < num_child_pids + 1; i++) {
+            account_usage(own, pids[i], &usage[i]);
+        }
+        // * Verify the processes' time inactivity (the supervisor restarts the components instead)
+        if (supervisor_fd != -1) {
+            continue;
+        }
         for (int i = 0; i < num_child_pids; i++) {
             time_t now = time(NULL);
             if (difftime(now, last_active_time_p[i]) > dt) {
                 for (int j = 0; j < num_child_pids; j++) {
-                    kill(child_pids[j], SIGTERM);
+                    signal_component(child_pids[j], SIGTERM);
                 }
-                kill(blackboard_pid, SIGTERM);
+                signal_component(blackboard_pid, SIGTERM);
                 exit(EXIT_FAILURE);
             }
         }
         time_t now = time(NULL);
         if (difftime(now, last_active_time_balckboard) > dt) {
             for (int j = 0; j < num_child_pids; j++) {
-                kill(child_pids[j], SIGTERM);
+                signal_component(child_pids[j], SIGTERM);
             }
-            kill(blackboard_pid, SIGTERM);
+            signal_component(blackboard_pid, SIGTERM);
             exit(EXIT_FAILURE);
         }
     }
 
+    for (int i = 0; i < num_child_pids + 1; i++) {
+        report_usage(&usage[i]);
+    }
+    if (server != -1) {
+        close(server);
+        unlink(METRICS_SOCKET);
+    }
+    for (int i = 1; i < NUM_CHILD_PROCESSES; i++) {
+        metrics_detach(pages[i]);
+    }
+    metrics_close(own);
+    // * The components have exited by now: remove the pages of those that were killed
+    for (int i = 0; i < num_child_pids + 1; i++) {
+        metrics_remove(pids[i]);
+        heartbeat_detach(live[i].page);
+        heartbeat_remove(pids[i]);
+        if (live[i].pidfd != -1) {
+            close(live[i].pidfd);
+        }
+    }
+    close(epoll_fd);
+    log_close();
+    if (log_dir) {
+        log_collect(log_dir, logfile_fd);
+    }
+
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+static void register_usage(metrics_page *page, component_usage *usage) {
+    /*
+     * Describe the resource metrics of a component in the page of the watchdog.
+     * @param usage Component, its slots are filled.
+     */
+    char labels[64];
+    snprintf(labels, sizeof(labels), "component=\"%s\"", usage->name);
+    usage->cpu_slot = metrics_register(page, "dronegame_process_cpu_seconds_total", labels,
+        "CPU time of the component (user and system).", METRICS_COUNTER, 1.0 / (double)sysconf(_SC_CLK_TCK));
+    usage->cpu_percent_slot = metrics_register(page, "dronegame_process_cpu_percent", labels,
+        "CPU of the component over the last period, in percent of one CPU.", METRICS_GAUGE, 0.01);
+    usage->rss_slot = metrics_register(page, "dronegame_process_resident_bytes", labels,
+        "Resident set of the component.", METRICS_GAUGE, 1);
+    usage->runqueue_slot = metrics_register(page, "dronegame_process_runqueue_seconds_total", labels,
+        "Time the component was runnable but waiting for a CPU.", METRICS_COUNTER, 1e-9);
+    usage->alerts_slot = metrics_register(page, "dronegame_process_alerts_total", labels,
+        "Usage thresholds crossed by the component.", METRICS_COUNTER, 1);
+    snprintf(labels, sizeof(labels), "component=\"%s\",kind=\"voluntary\"", usage->name);
+    usage->voluntary_slot = metrics_register(page, "dronegame_process_context_switches_total", labels,
+        "Context switches of the component.", METRICS_COUNTER, 1);
+    snprintf(labels, sizeof(labels), "component=\"%s\",kind=\"involuntary\"", usage->name);
+    usage->involuntary_slot = metrics_register(page, "dronegame_process_context_switches_total", labels,
+        "Context switches of the component.", METRICS_COUNTER, 1);
+}
+
+static void account_usage(metrics_page *page, const pid_t pid, component_usage *usage) {
+    /*
+     * Sample a component, publish its usage and log the thresholds it crosses over the period since the last sample
+     * (once when the usage goes above a threshold, once when it comes back).
+     * @param pid PID of the component, nothing is done if it is gone.
+     */
+    proc_sample sample;
+    const long now = monotonic_ms();
+    if (proc_sample_read(pid, threaded, &sample) == -1) {
+        return;
+    }
+    metrics_set(page, usage->cpu_slot, (int64_t)sample.cpu_ticks);
+    metrics_set(page, usage->rss_slot, (int64_t)sample.rss_bytes);
+    metrics_set(page, usage->voluntary_slot, (int64_t)sample.voluntary);
+    metrics_set(page, usage->involuntary_slot, (int64_t)sample.involuntary);
+    metrics_set(page, usage->runqueue_slot, (int64_t)sample.wait_ns);
+    if (sample.rss_bytes > usage->max_rss) {
+        usage->max_rss = sample.rss_bytes;
+    }
+    if (usage->last_ms && now > usage->last_ms) {
+        const double period = (double)(now - usage->last_ms) / 1e3;
+        const double cpu = (double)(sample.cpu_ticks - usage->last.cpu_ticks) / (double)sysconf(_SC_CLK_TCK) /
+            period * 100;
+        const double runqueue = sample.has_schedstat ?
+            (double)(sample.wait_ns - usage->last.wait_ns) / 1e9 / period : 0;
+        metrics_set(page, usage->cpu_percent_slot, (int64_t)(cpu * 100));
+        const int alerting = (cpu > CPU_ALERT_PERCENT ? ALERT_CPU : 0) |
+            (sample.rss_bytes > RSS_ALERT_BYTES ? ALERT_RSS : 0) | (runqueue > RUNQUEUE_ALERT_RATIO ? ALERT_RUNQUEUE : 0);
+        const int raised = alerting & ~usage->alerting, cleared = usage->alerting & ~alerting;
+        char message[192];
+        if (raised || cleared) {
+            snprintf(message, sizeof(message), "Watchdog %s: %s (PID %d) CPU %.1f%%, RSS %.1f MB, run queue %.1f%% "
+                "of the period, %llu voluntary and %llu involuntary context switches.", raised ? "alert" : "recovery",
+                usage->name, pid, cpu, (double)sample.rss_bytes / (1 << 20), runqueue * 100,
+                (unsigned long long)(sample.voluntary - usage->last.voluntary),
+                (unsigned long long)(sample.involuntary - usage->last.involuntary));
+            log_write(message);
+        }
+        metrics_add(page, usage->alerts_slot, __builtin_popcount((unsigned)raised));
+        usage->alerting = alerting;
+    }
+    usage->last = sample;
+    usage->last_ms = now;
+}
+
+static void check_heartbeat(metrics_page *page, const pid_t pid, component_liveness *live, const long now) {
+    /*
+     * Check the beats of a component: it is stalled when it has been busy without a beat for HEARTBEAT_STALL_MS.
+     * The stall and the end of it are logged once.
+     * @param now Time of the check (monotonic_ms).
+     */
+    if (!live->alive) {
+        return;
+    }
+    if (!live->page) {
+        live->page = heartbeat_attach(pid);
+        live->changed_ms = now;
+        return;
+    }
+    const uint64_t beats = atomic_load_explicit(&live->page->beats, memory_order_relaxed);
+    const int waiting = (int)atomic_load_explicit(&live->page->waiting, memory_order_relaxed);
+    metrics_set(page, live->beats_slot, (int64_t)beats);
+    char message[160];
+    if (beats != live->beats || waiting) {
+        if (live->stalled) {
+            snprintf(message, sizeof(message), "Watchdog: %s (PID %d) resumed after %ld ms without a beat.",
+                live->name, pid, now - live->changed_ms);
+            log_write(message);
+            metrics_set(page, live->stalled_slot, 0);
+        }
+        live->beats = beats;
+        live->changed_ms = now;
+        live->stalled = 0;
+        return;
+    }
+    if (!live->stalled && now - live->changed_ms >= HEARTBEAT_STALL_MS) {
+        live->stalled = 1;
+        snprintf(message, sizeof(message), "Watchdog: %s (PID %d) stalled, busy without a beat for %ld ms.",
+            live->name, pid, now - live->changed_ms);
+        log_write(message);
+        metrics_add(page, live->stalls_slot, 1);
+        metrics_set(page, live->stalled_slot, 1);
+    }
+}
+
+static void follow_restart(const int epoll_fd, const int component, const pid_t pid, pid_t *pids,
+    component_liveness *live, component_usage *usage, metrics_page **page) {
+    /*
+     * Follow a component restarted by the supervisor: drop what belonged to the old process (its pages and its
+     * pidfd) and watch the new one from the start.
+     * @param page Metrics page of the component, mapped again on the next scrape.
+     */
+    char message[128];
+    snprintf(message, sizeof(message), "Watchdog: %s restarted by the supervisor, PID %d replaces PID %d.",
+        live->name, pid, pids[component]);
+    log_write(message);
+    metrics_detach(*page);
+    *page = NULL;
+    metrics_remove(pids[component]);
+    heartbeat_detach(live->page);
+    live->page = NULL;
+    heartbeat_remove(pids[component]);
+    if (live->pidfd != -1) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, live->pidfd, NULL);
+        close(live->pidfd);
+    }
+    pids[component] = pid;
+    live->alive = 1;
+    live->beats = 0;
+    live->stalled = 0;
+    live->killed = 0;
+    live->changed_ms = monotonic_ms();
+    live->pidfd = open_pidfd(pid);
+    struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)component}};
+    if (live->pidfd == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, live->pidfd, &event) == -1) {
+        perror("pidfd");
+    }
+    // * The CPU time starts again from zero
+    usage->last_ms = 0;
+}
+
+static void report_usage(const component_usage *usage) {
+    // * Totals of a component at its last sample, written to the logfile on exit
+    if (!usage->last_ms) {
+        return;
+    }
+    char message[192];
+    snprintf(message, sizeof(message), "Watchdog usage: %s CPU %.2f s, max RSS %.1f MB, run queue %.3f s, "
+        "%llu voluntary and %llu involuntary context switches.", usage->name,
+        (double)usage->last.cpu_ticks / (double)sysconf(_SC_CLK_TCK), (double)usage->max_rss / (1 << 20),
+        (double)usage->last.wait_ns / 1e9, (unsigned long long)usage->last.voluntary,
+        (unsigned long long)usage->last.involuntary);
+    log_write(message);
+}
+
+static int open_metrics_socket(void) {
+    /*
+     * Listen on METRICS_SOCKET (a socket left by a previous game is replaced).
+     * @return The listening socket, non-blocking, -1 on failure.
+     */
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, METRICS_SOCKET, sizeof(address.sun_path) - 1);
+    unlink(METRICS_SOCKET);
+    const int server = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server == -1) {
+        return -1;
+    }
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(server, 8) == -1) {
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+static void serve_metrics(const int server, metrics_page *const *pages, const int count) {
+    /*
+     * Answer one scrape: the pages rendered in Prometheus text format, behind an HTTP header if the scraper sent an
+     * HTTP request (curl, Prometheus), as plain text otherwise (nc -U).
+     * @param pages Pages to render, NULL for a process without one.
+     */
+    const int client = accept(server, NULL, NULL);
+    if (client == -1) {
+        return;
+    }
+    // * A scraper that does not send its request or does not read the answer cannot delay the heartbeats
+    const struct timeval timeout = {0, SCRAPE_TIMEOUT_MS * 1000};
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char request[256];
+    struct pollfd pfd = {client, POLLIN, 0};
+    const ssize_t n = poll(&pfd, 1, SCRAPE_TIMEOUT_MS) > 0 ? recv(client, request, sizeof(request), 0) : 0;
+    const int http = n >= 3 && strncmp(request, "GET", 3) == 0;
+    char *body = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&body, &size);
+    if (!out) {
+        close(client);
+        return;
+    }
+    metrics_render(out, pages, count);
+    fclose(out);
+    char header[160];
+    const int length = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; "
+        "version=0.0.4\r\nContent-Length: %zu\r\n\r\n", size);
+    if (!http || send_all(client, header, (size_t)length) == 0) {
+        send_all(client, body, size);
+    }
+    free(body);
+    close(client);
+}
+
+static int send_all(const int fd, const char *buf, const size_t size) {
+    /*
+     * Send a whole buffer on a socket, without SIGPIPE if the scraper went away.
+     * @return 0 on success, -1 on failure.
+     */
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = send(fd, buf + done, size - done, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+static long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+static int signal_component(const pid_t pid, const int signum) {
+    // * kill() for a process, tgkill() for a thread of this process
+    return threaded ? (int)syscall(SYS_tgkill, getpid(), pid, signum) : kill(pid, signum);
+}
+
+static int open_pidfd(const pid_t pid) {
+    // * pidfd of a component, readable once it has exited: -1 if it cannot be opened (the kernel has no thread pidfds)
+    return (int)syscall(SYS_pidfd_open, pid, threaded ? PIDFD_THREAD : 0);
+}